@@ -1,9 +1,12 @@
 TCS_NAME :=
 
 TCS_SRC :=
+TCS_GENERATED_SRC_HOST_ONLY :=
 TCS_INCS :=
+TCS_INCS_HOST_ONLY :=
 TCS_REQUIRED_MODULES :=
 TCS_CFLAGS :=
+TCS_CFLAGS_HOST_ONLY :=
 
 TCS_SHARED_LIBS_ANDROID_ONLY :=
 TCS_SHARED_LIBS_HOST_ONLY :=
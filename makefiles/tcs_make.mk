@@ -59,9 +59,10 @@ LOCAL_MODULE := $(TCS_NAME)
 LOCAL_MODULE_OWNER := intel
 
 LOCAL_SRC_FILES := $(TCS_SRC)
-LOCAL_C_INCLUDES := $(TCS_DEFAULT_INCS) $(TCS_INCS)
+LOCAL_GENERATED_SOURCES := $(TCS_GENERATED_SRC_HOST_ONLY)
+LOCAL_C_INCLUDES := $(TCS_DEFAULT_INCS) $(TCS_INCS) $(TCS_INCS_HOST_ONLY)
 
-LOCAL_CFLAGS := $(TCS_DEFAULT_CFLAGS) $(TCS_HOST_CFLAGS) $(TCS_CFLAGS)
+LOCAL_CFLAGS := $(TCS_DEFAULT_CFLAGS) $(TCS_HOST_CFLAGS) $(TCS_CFLAGS) $(TCS_CFLAGS_HOST_ONLY)
 LOCAL_LDFLAGS := $(TCS_HOST_LDFLAGS)
 
 LOCAL_SHARED_LIBRARIES := $(TCS_SHARED_LIBS) $(TCS_SHARED_LIBS_HOST_ONLY)
@@ -1,5 +1,10 @@
 LOCAL_PATH := $(call my-dir)
 
+# configurations are flattened by a host tool
+ifeq ($(tcs_flat), true)
+tcs_host := true
+endif
+
 ##############################################################
 #      LIBRARY
 ##############################################################
@@ -12,14 +17,35 @@ TCS_INCS := $(LOCAL_PATH)/inc \
     external/webkit/Source/WebCore/ic \
     external/icu/icu4c/source/common
 
-TCS_SHARED_LIBS_ANDROID_ONLY := libc libcutils liblog libxml2 libicuuc
+TCS_SHARED_LIBS_ANDROID_ONLY := libc libcutils liblog libxml2 libicuuc libz
 TCS_STATIC_LIBS_HOST_ONLY := libxml2
 TCS_SHARED_LIBS_HOST_ONLY := libicuuc-host
 
-TCS_COPY_HEADERS := inc/tcs.h
+TCS_COPY_HEADERS := inc/tcs.h inc/tcs.hpp
 TCS_COPY_HEADERS_TO := telephony/libtcs2
 
 TCS_REQUIRED_MODULES := tcs2_hw_xml
+ifeq ($(tcs_flat), true)
+TCS_REQUIRED_MODULES += tcs2_flat_xml
+endif
+
+ifeq ($(tcs_stats), true)
+TCS_CFLAGS += -DTCS_ENABLE_STATS
+endif
+
+ifeq ($(tcs_log_level), debug)
+TCS_CFLAGS += -DTCS_LOG_LEVEL=TCS_LOG_LEVEL_DEBUG
+else ifeq ($(tcs_log_level), error)
+TCS_CFLAGS += -DTCS_LOG_LEVEL=TCS_LOG_LEVEL_ERROR
+endif
+
+ifeq ($(tcs_log_sync), true)
+TCS_CFLAGS += -DTCS_LOG_SYNC
+endif
+
+ifeq ($(tcs_xml_parser), builtin)
+TCS_CFLAGS += -DTCS_BUILTIN_XML_PARSER
+endif
 
 TCS_TARGET := $(BUILD_SHARED_LIBRARY)
 include $(LOCAL_PATH)/../makefiles/tcs_make.mk
@@ -32,9 +58,159 @@ TCS_NAME := tcs2_test
 
 TCS_SRC := $(call all-c-files-under, test)
 
-TCS_SHARED_LIBS_ANDROID_ONLY := libc libcutils
+TCS_SHARED_LIBS_ANDROID_ONLY := libc libcutils libz
+TCS_SHARED_LIBS := libtcs2
+
+# schema loaders are generated by tcs2_codegen, a host tool: host test only. A schema file is
+# named after its schema (test/schema/<name>.xml gives <name>_config.[ch])
+ifeq ($(tcs_host), true)
+TCS_TEST_GEN := $(call intermediates-dir-for,EXECUTABLES,tcs2_test,HOST)/gen
+TCS_TEST_SCHEMAS := $(wildcard $(LOCAL_PATH)/test/schema/*.xml)
+TCS_CODEGEN_TOOL := $(HOST_OUT_EXECUTABLES)/tcs2_codegen$(HOST_EXECUTABLE_SUFFIX)
+
+TCS_GENERATED_SRC_HOST_ONLY := $(patsubst $(LOCAL_PATH)/test/schema/%.xml, \
+    $(TCS_TEST_GEN)/%_config.c, $(TCS_TEST_SCHEMAS))
+TCS_INCS_HOST_ONLY := $(TCS_TEST_GEN)
+TCS_CFLAGS_HOST_ONLY := -DTCS_TEST_CODEGEN
+
+# the header is generated with the source
+$(TCS_GENERATED_SRC_HOST_ONLY): PRIVATE_TOOL := $(TCS_CODEGEN_TOOL)
+$(TCS_GENERATED_SRC_HOST_ONLY): $(TCS_TEST_GEN)/%_config.c: $(LOCAL_PATH)/test/schema/%.xml \
+    $(TCS_CODEGEN_TOOL)
+	@echo "Generate TCS schema loader: $@"
+	$(hide) mkdir -p $(dir $@)
+	$(hide) $(PRIVATE_TOOL) $< $(dir $@)
+endif
+
+TCS_TARGET := $(BUILD_EXECUTABLE)
+include $(LOCAL_PATH)/../makefiles/tcs_make.mk
+
+##############################################################
+#      C++ HEADER TESTU (host only)
+##############################################################
+# tcs.hpp is built with the oldest and the newest supported standards: _key literals are
+# consteval with C++20 only
+include $(LOCAL_PATH)/../makefiles/tcs_clear.mk
+TCS_NAME := tcs2_test_hpp17
+TCS_LANG := CPP
+
+TCS_SRC := test/test_hpp.cpp
+TCS_CFLAGS := -std=c++17
+
 TCS_SHARED_LIBS := libtcs2
 
+TCS_DISABLE_ANDROID_TARGET := true
 TCS_TARGET := $(BUILD_EXECUTABLE)
 include $(LOCAL_PATH)/../makefiles/tcs_make.mk
 
+include $(LOCAL_PATH)/../makefiles/tcs_clear.mk
+TCS_NAME := tcs2_test_hpp20
+TCS_LANG := CPP
+
+TCS_SRC := test/test_hpp.cpp
+TCS_CFLAGS := -std=c++20
+
+TCS_SHARED_LIBS := libtcs2
+
+TCS_DISABLE_ANDROID_TARGET := true
+TCS_TARGET := $(BUILD_EXECUTABLE)
+include $(LOCAL_PATH)/../makefiles/tcs_make.mk
+
+
+##############################################################
+#      BENCHMARK (host only)
+##############################################################
+include $(LOCAL_PATH)/../makefiles/tcs_clear.mk
+TCS_NAME := tcs2_bench
+
+TCS_SRC := $(call all-c-files-under, bench)
+
+TCS_SHARED_LIBS := libtcs2
+
+TCS_DISABLE_ANDROID_TARGET := true
+TCS_TARGET := $(BUILD_EXECUTABLE)
+include $(LOCAL_PATH)/../makefiles/tcs_make.mk
+
+##############################################################
+#      OVERLAY MANIFEST GENERATOR (host only)
+##############################################################
+include $(LOCAL_PATH)/../makefiles/tcs_clear.mk
+TCS_NAME := tcs2_manifest
+
+TCS_SRC := tools/manifest.c
+TCS_INCS := $(LOCAL_PATH)/src \
+    external/libxml2/include \
+    external/icu/icu4c/source/common
+
+TCS_SHARED_LIBS := libtcs2
+
+TCS_DISABLE_ANDROID_TARGET := true
+TCS_TARGET := $(BUILD_EXECUTABLE)
+include $(LOCAL_PATH)/../makefiles/tcs_make.mk
+
+##############################################################
+#      CONFIGURATION FLATTENING TOOL (host only)
+##############################################################
+include $(LOCAL_PATH)/../makefiles/tcs_clear.mk
+TCS_NAME := tcs2_flatten
+
+TCS_SRC := tools/flatten.c
+TCS_INCS := $(LOCAL_PATH)/src \
+    external/libxml2/include \
+    external/icu/icu4c/source/common
+
+TCS_SHARED_LIBS := libtcs2
+
+TCS_DISABLE_ANDROID_TARGET := true
+TCS_TARGET := $(BUILD_EXECUTABLE)
+include $(LOCAL_PATH)/../makefiles/tcs_make.mk
+
+##############################################################
+#      FLATTENED CONFIGURATIONS
+##############################################################
+# TCS_FLAT_HW_FOLDER and TCS_FLAT_CATALOG_FOLDER are set by the device: source folders of the hw
+# XML files and of the sw folders, laid out as on target. TCS_FLAT_FLAGS selects the output
+# format (@see tools/flatten.c)
+ifeq ($(tcs_flat), true)
+ifeq ($(TCS_FLAT_HW_FOLDER),)
+$(error tcs_flat is set but TCS_FLAT_HW_FOLDER is not)
+endif
+include $(CLEAR_VARS)
+LOCAL_MODULE := tcs2_flat_xml
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_CLASS := FAKE
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_SYSTEM)/base_rules.mk
+
+TCS_FLAT_OUT := $(TARGET_OUT_VENDOR)/etc/telephony/tcs/flat
+TCS_FLAT_TOOL := $(HOST_OUT_EXECUTABLES)/tcs2_flatten$(HOST_EXECUTABLE_SUFFIX)
+TCS_FLAT_INPUTS := $(shell find $(TCS_FLAT_HW_FOLDER) $(TCS_FLAT_CATALOG_FOLDER) -type f)
+
+# an overlay error fails the tool, and the build
+$(LOCAL_BUILT_MODULE): PRIVATE_TOOL := $(TCS_FLAT_TOOL)
+$(LOCAL_BUILT_MODULE): PRIVATE_ARGS := $(TCS_FLAT_FLAGS) $(TCS_FLAT_HW_FOLDER) $(TCS_FLAT_OUT) \
+    $(TCS_FLAT_CATALOG_FOLDER)
+$(LOCAL_BUILT_MODULE): PRIVATE_OUT := $(TCS_FLAT_OUT)
+$(LOCAL_BUILT_MODULE): $(TCS_FLAT_TOOL) $(TCS_FLAT_INPUTS)
+	@echo "Flatten TCS configurations: $(PRIVATE_OUT)"
+	$(hide) rm -rf $(PRIVATE_OUT) && mkdir -p $(dir $(PRIVATE_OUT)) $(dir $@)
+	$(hide) $(PRIVATE_TOOL) $(PRIVATE_ARGS)
+	$(hide) touch $@
+endif
+
+##############################################################
+#      SCHEMA CODE GENERATOR (host only)
+##############################################################
+include $(LOCAL_PATH)/../makefiles/tcs_clear.mk
+TCS_NAME := tcs2_codegen
+
+TCS_SRC := tools/codegen.c
+TCS_INCS := $(LOCAL_PATH)/src \
+    external/libxml2/include \
+    external/icu/icu4c/source/common
+
+TCS_SHARED_LIBS := libtcs2
+
+TCS_DISABLE_ANDROID_TARGET := true
+TCS_TARGET := $(BUILD_EXECUTABLE)
+include $(LOCAL_PATH)/../makefiles/tcs_make.mk
@@ -0,0 +1,480 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TCS benchmark (host only)
+ *
+ * Generates a synthetic configuration (modules x instances x keys x list size x overlay files)
+ * and measures latency percentiles and allocations of each API. Lookups of absent keys (misses)
+ * are measured separately. Results are written as JSON.
+ *
+ * Usage: tcs2_bench [-p small|realistic|extreme] [-m modules] [-i instances] [-k keys]
+ *                   [-l list_size] [-o overlay_files] [-n iterations] [-f output_file]
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libtcs2/tcs.h"
+
+#define xstr(s) str(s)
+#define str(s) #s
+
+#ifdef __GNUC__
+#define likely(x)   __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#else
+#define likely(x)   (x)
+#define unlikely(x) (x)
+#endif
+
+#define DASSERT(exp, format, ...) do { \
+        if (unlikely(!(exp))) { \
+            if (unlikely(format[0] != '\0')) \
+                fprintf(stderr, "AssertionLog " format, ## __VA_ARGS__); \
+            fprintf(stderr, "%s:%d Assertion '" xstr(exp) "'", __FILE__, __LINE__); \
+            abort(); \
+        } \
+} while (0)
+
+#define ASSERT(exp) DASSERT(exp, "")
+
+#define BENCH_ROOT_FOLDER "/tmp/tcs_bench"
+#define BENCH_HW_FOLDER BENCH_ROOT_FOLDER "/hw"
+#define BENCH_OVERLAY_FOLDER BENCH_ROOT_FOLDER "/overlay"
+#define BENCH_PLATFORM "bench"
+
+#define NB_SUB_GROUPS 4
+
+typedef struct bench_cfg {
+    const char *preset;
+    int modules;
+    int instances;
+    int keys;           // number of keys per instance
+    int list_size;      // number of elements of each list
+    int overlays;       // number of overlay files per instance
+    int iterations;
+} bench_cfg_t;
+
+static const bench_cfg_t presets[] = {
+    { "small", 2, 1, 12, 4, 1, 200 },
+    { "realistic", 8, 2, 60, 16, 2, 50 },
+    { "extreme", 16, 4, 400, 200, 4, 5 },
+};
+
+/* Allocation counters. Allocator is interposed on glibc hosts only */
+static unsigned long nb_allocs;
+static unsigned long nb_bytes;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    __atomic_fetch_add(&nb_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_bytes, size, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    __atomic_fetch_add(&nb_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_bytes, nmemb * size, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&nb_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_bytes, size, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+typedef struct measure {
+    const char *name;
+    int nb;
+    int max;
+    long long *samples;  // in ns
+    unsigned long allocs;
+    unsigned long bytes;
+    unsigned long start_allocs;
+    unsigned long start_bytes;
+    struct timespec start;
+} measure_t;
+
+static void measure_init(measure_t *m, const char *name, int max)
+{
+    memset(m, 0, sizeof(*m));
+    m->name = name;
+    m->max = max;
+    m->samples = calloc(max, sizeof(long long));
+    ASSERT(m->samples);
+}
+
+static inline void measure_start(measure_t *m)
+{
+    m->start_allocs = nb_allocs;
+    m->start_bytes = nb_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &m->start);
+}
+
+static inline void measure_stop(measure_t *m)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    m->allocs += nb_allocs - m->start_allocs;
+    m->bytes += nb_bytes - m->start_bytes;
+    ASSERT(m->nb < m->max);
+    m->samples[m->nb++] = (end.tv_sec - m->start.tv_sec) * 1000000000LL +
+                          (end.tv_nsec - m->start.tv_nsec);
+}
+
+static int cmp_samples(const void *a, const void *b)
+{
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+static long long percentile(const measure_t *m, int pct)
+{
+    int idx = (m->nb * pct + 99) / 100 - 1;
+
+    return m->samples[idx < 0 ? 0 : idx];
+}
+
+static void measure_print(FILE *fp, measure_t *m, bool last)
+{
+    long long total = 0;
+
+    ASSERT(m->nb > 0);
+    qsort(m->samples, m->nb, sizeof(long long), cmp_samples);
+    for (int i = 0; i < m->nb; i++)
+        total += m->samples[i];
+
+    fprintf(fp, "    { \"name\": \"%s\", \"samples\": %d, \"mean_ns\": %lld, \"p50_ns\": %lld, "
+            "\"p90_ns\": %lld, \"p99_ns\": %lld, \"max_ns\": %lld, \"allocs_per_call\": %.2f, "
+            "\"bytes_per_call\": %.2f }%s\n", m->name, m->nb, total / m->nb, percentile(m, 50),
+            percentile(m, 90), percentile(m, 99), m->samples[m->nb - 1],
+            (double)m->allocs / m->nb, (double)m->bytes / m->nb, last ? "" : ",");
+    free(m->samples);
+}
+
+/* Synthetic configuration generator */
+static void module_name(int module, char *name, size_t len)
+{
+    /* module names must not contain digits: digits identify instances */
+    snprintf(name, len, "mod%c%c", 'a' + module / 26, 'a' + module % 26);
+}
+
+static FILE *open_xml(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+
+    DASSERT(fp, "failed to create %s", path);
+    return fp;
+}
+
+static void write_key(FILE *fp, int key, int variant)
+{
+    switch (key % 3) {
+    case 0: fprintf(fp, "<int key=\"int%d\">%d</int>\n", key, key + variant); break;
+    case 1: fprintf(fp, "<bool key=\"bool%d\">%s</bool>\n", key, (key + variant) % 2 ? "true" :
+                    "false"); break;
+    default: fprintf(fp, "<string key=\"string%d\">value %d-%d</string>\n", key, key, variant);
+    }
+}
+
+static void generate_config(const bench_cfg_t *cfg)
+{
+    char path[256];
+    char name[16];
+
+    system("rm -fr " BENCH_ROOT_FOLDER);
+    system("mkdir -p " BENCH_HW_FOLDER "/config " BENCH_OVERLAY_FOLDER "/config");
+
+    FILE *fp = open_xml(BENCH_HW_FOLDER "/config/TCS2_" BENCH_PLATFORM ".xml");
+    fprintf(fp, "<config>\n<group name=\"common\">\n<int key=\"test\">1</int>\n</group>\n"
+            "<group name=\"modules\">\n");
+    for (int m = 0; m < cfg->modules; m++) {
+        module_name(m, name, sizeof(name));
+        for (int i = 0; i < cfg->instances; i++)
+            fprintf(fp, "<string key=\"%s%d\">%s%d.xml</string>\n", name, i, name, i);
+    }
+    fprintf(fp, "</group>\n</config>\n");
+    fclose(fp);
+
+    fp = open_xml(BENCH_OVERLAY_FOLDER "/config/config.xml");
+    fprintf(fp, "<config>\n<group name=\"common\">\n<int key=\"test\">2</int>\n</group>\n"
+            "</config>\n");
+    fclose(fp);
+
+    for (int m = 0; m < cfg->modules; m++) {
+        module_name(m, name, sizeof(name));
+        snprintf(path, sizeof(path), "mkdir -p %s/%s %s/%s", BENCH_HW_FOLDER, name,
+                 BENCH_OVERLAY_FOLDER, name);
+        system(path);
+
+        for (int i = 0; i < cfg->instances; i++) {
+            snprintf(path, sizeof(path), "%s/%s/%s%d.xml", BENCH_HW_FOLDER, name, name, i);
+            fp = open_xml(path);
+            fprintf(fp, "<group name=\"%s%d\">\n", name, i);
+            for (int g = 0; g < NB_SUB_GROUPS; g++) {
+                fprintf(fp, "<group name=\"sub%d\">\n", g);
+                for (int k = g; k < cfg->keys; k += NB_SUB_GROUPS)
+                    write_key(fp, k, 0);
+                fprintf(fp, "<list name=\"list\">\n");
+                for (int l = 0; l < cfg->list_size; l++)
+                    fprintf(fp, "<string>element %d</string>\n", l);
+                fprintf(fp, "</list>\n</group>\n");
+            }
+            fprintf(fp, "</group>\n");
+            fclose(fp);
+
+            /* each overlay file overwrites some keys and appends elements to one list */
+            for (int o = 0; o < cfg->overlays; o++) {
+                snprintf(path, sizeof(path), "%s/%s/%s%d_%d.xml", BENCH_OVERLAY_FOLDER, name,
+                         name, i, o);
+                fp = open_xml(path);
+                fprintf(fp, "<group name=\"%s%d\">\n<group name=\"sub%d\">\n", name, i,
+                        o % NB_SUB_GROUPS);
+                for (int k = o % NB_SUB_GROUPS; k < cfg->keys; k += 4 * NB_SUB_GROUPS)
+                    write_key(fp, k, o + 1);
+                fprintf(fp, "<list name=\"list\" overlay=\"append\">\n<string>overlay %d</string>\n"
+                        "</list>\n</group>\n</group>\n", o);
+                fclose(fp);
+            }
+        }
+    }
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+
+    ASSERT(getrusage(RUSAGE_SELF, &usage) == 0);
+    return usage.ru_maxrss;
+}
+
+static void run(const bench_cfg_t *cfg, FILE *out)
+{
+    enum { INIT, ADD_GROUP, SELECT_GROUP, GET_INT, GET_BOOL, GET_STRING, GET_STRING_ARRAY,
+           GET_STRING_ARRAY_PACKED, GET_INT_MISS, GET_STRING_MISS, DISPOSE, NB_MEASURES };
+    measure_t m[NB_MEASURES];
+    int nb_groups = cfg->modules * cfg->instances;
+    int nb_lookups = cfg->iterations * nb_groups * NB_SUB_GROUPS;
+    int nb_keys = (cfg->keys + 2) / 3;
+
+    measure_init(&m[INIT], "tcs2_init", cfg->iterations);
+    measure_init(&m[ADD_GROUP], "add_group", cfg->iterations * nb_groups);
+    measure_init(&m[SELECT_GROUP], "select_group", nb_lookups);
+    measure_init(&m[GET_INT], "get_int", nb_lookups * nb_keys);
+    measure_init(&m[GET_BOOL], "get_bool", nb_lookups * nb_keys);
+    measure_init(&m[GET_STRING], "get_string", nb_lookups * nb_keys);
+    measure_init(&m[GET_STRING_ARRAY], "get_string_array", nb_lookups);
+    measure_init(&m[GET_STRING_ARRAY_PACKED], "get_string_array_packed", nb_lookups);
+    measure_init(&m[GET_INT_MISS], "get_int_miss", nb_lookups * nb_keys);
+    measure_init(&m[GET_STRING_MISS], "get_string_miss", nb_lookups * nb_keys);
+    measure_init(&m[DISPOSE], "dispose", cfg->iterations);
+
+    for (int it = 0; it < cfg->iterations; it++) {
+        measure_start(&m[INIT]);
+        tcs_ctx_t *tcs = tcs2_init(NULL);
+        measure_stop(&m[INIT]);
+        ASSERT(tcs);
+
+        for (int mod = 0; mod < cfg->modules; mod++) {
+            char name[16];
+            char group[32];
+            module_name(mod, name, sizeof(name));
+
+            for (int i = 0; i < cfg->instances; i++) {
+                snprintf(group, sizeof(group), "%s%d", name, i);
+                measure_start(&m[ADD_GROUP]);
+                tcs->add_group(tcs, group, false);
+                measure_stop(&m[ADD_GROUP]);
+            }
+
+            for (int i = 0; i < cfg->instances; i++) {
+                for (int g = 0; g < NB_SUB_GROUPS; g++) {
+                    snprintf(group, sizeof(group), "%s%d.sub%d", name, i, g);
+                    measure_start(&m[SELECT_GROUP]);
+                    ASSERT(tcs->select_group(tcs, group) == 0);
+                    measure_stop(&m[SELECT_GROUP]);
+
+                    for (int k = g; k < cfg->keys; k += NB_SUB_GROUPS) {
+                        char key[32];
+                        switch (k % 3) {
+                        case 0: {
+                            int value;
+                            snprintf(key, sizeof(key), "int%d", k);
+                            measure_start(&m[GET_INT]);
+                            ASSERT(tcs->get_int(tcs, key, &value) == 0);
+                            measure_stop(&m[GET_INT]);
+                            break;
+                        }
+                        case 1: {
+                            bool value;
+                            snprintf(key, sizeof(key), "bool%d", k);
+                            measure_start(&m[GET_BOOL]);
+                            ASSERT(tcs->get_bool(tcs, key, &value) == 0);
+                            measure_stop(&m[GET_BOOL]);
+                            break;
+                        }
+                        default: {
+                            snprintf(key, sizeof(key), "string%d", k);
+                            measure_start(&m[GET_STRING]);
+                            char *value = tcs->get_string(tcs, key);
+                            measure_stop(&m[GET_STRING]);
+                            ASSERT(value);
+                            free(value);
+                        }
+                        }
+                    }
+
+                    int nb = 0;
+                    measure_start(&m[GET_STRING_ARRAY]);
+                    char **array = tcs->get_string_array(tcs, "list", &nb);
+                    measure_stop(&m[GET_STRING_ARRAY]);
+                    ASSERT(array);
+                    for (int l = 0; l < nb; l++)
+                        free(array[l]);
+                    free(array);
+
+                    measure_start(&m[GET_STRING_ARRAY_PACKED]);
+                    array = tcs->get_string_array_packed(tcs, "list", &nb);
+                    measure_stop(&m[GET_STRING_ARRAY_PACKED]);
+                    ASSERT(array);
+                    free(array);
+
+                    /* optional keys, usually absent */
+                    for (int k = 0; k < nb_keys; k++) {
+                        char key[32];
+                        int value;
+                        snprintf(key, sizeof(key), "new_value%d", k);
+                        measure_start(&m[GET_INT_MISS]);
+                        ASSERT(tcs->get_int(tcs, key, &value) == -1);
+                        measure_stop(&m[GET_INT_MISS]);
+
+                        measure_start(&m[GET_STRING_MISS]);
+                        char *str = tcs->get_string(tcs, key);
+                        measure_stop(&m[GET_STRING_MISS]);
+                        ASSERT(!str);
+                    }
+                }
+            }
+        }
+
+        measure_start(&m[DISPOSE]);
+        tcs->dispose(tcs);
+        measure_stop(&m[DISPOSE]);
+    }
+
+    fprintf(out, "{\n  \"commit\": \"%s\",\n", GIT_COMMIT_ID);
+    fprintf(out, "  \"config\": { \"preset\": \"%s\", \"modules\": %d, \"instances\": %d, "
+            "\"keys\": %d, \"list_size\": %d, \"overlays\": %d, \"iterations\": %d },\n",
+            cfg->preset, cfg->modules, cfg->instances, cfg->keys, cfg->list_size, cfg->overlays,
+            cfg->iterations);
+    fprintf(out, "  \"peak_rss_kb\": %ld,\n  \"results\": [\n", peak_rss_kb());
+    for (int i = 0; i < NB_MEASURES; i++)
+        measure_print(out, &m[i], i == NB_MEASURES - 1);
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bench_cfg_t cfg = presets[1];
+    const char *output = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:m:i:k:l:o:n:f:")) != -1) {
+        switch (opt) {
+        case 'p': {
+            size_t i;
+            for (i = 0; i < sizeof(presets) / sizeof(presets[0]); i++)
+                if (!strcmp(optarg, presets[i].preset))
+                    break;
+            DASSERT(i < sizeof(presets) / sizeof(presets[0]), "unknown preset %s\n", optarg);
+            cfg = presets[i];
+            break;
+        }
+        case 'm': cfg.modules = atoi(optarg); cfg.preset = "custom"; break;
+        case 'i': cfg.instances = atoi(optarg); cfg.preset = "custom"; break;
+        case 'k': cfg.keys = atoi(optarg); cfg.preset = "custom"; break;
+        case 'l': cfg.list_size = atoi(optarg); cfg.preset = "custom"; break;
+        case 'o': cfg.overlays = atoi(optarg); cfg.preset = "custom"; break;
+        case 'n': cfg.iterations = atoi(optarg); break;
+        case 'f': output = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-p small|realistic|extreme] [-m modules] [-i instances] "
+                    "[-k keys] [-l list_size] [-o overlay_files] [-n iterations] "
+                    "[-f output_file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    DASSERT((cfg.modules > 0) && (cfg.modules <= 26 * 26) && (cfg.instances > 0) &&
+            (cfg.keys >= 3 * NB_SUB_GROUPS) && (cfg.list_size > 0) && (cfg.overlays >= 0) &&
+            (cfg.iterations > 0), "invalid configuration\n");
+
+    generate_config(&cfg);
+
+    setenv("tcs.dbg.host.hw_folder", BENCH_HW_FOLDER, 1);
+    setenv("tcs.dbg.host.overlay_folder", BENCH_OVERLAY_FOLDER, 1);
+    setenv("ro.telephony.tcs.hw_name", BENCH_PLATFORM, 1);
+
+    /* TCS logs go to stdout on host: keep JSON in a separate stream */
+    FILE *out = stderr;
+    if (output) {
+        out = fopen(output, "w");
+        DASSERT(out, "failed to create %s\n", output);
+    }
+    /* Logs are not part of the measure */
+    int null_fd = open("/dev/null", O_WRONLY);
+    ASSERT(null_fd >= 0);
+    fflush(stdout);
+    int stdout_fd = dup(STDOUT_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+
+    run(&cfg, out);
+
+    fflush(stdout);
+    dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+    close(null_fd);
+    if (output)
+        fclose(out);
+
+    return EXIT_SUCCESS;
+}
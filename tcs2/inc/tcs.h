@@ -30,8 +30,91 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct tcs_ctx tcs_ctx_t;
+typedef struct tcs_group tcs_group_t;
+
+/* API statistics. Only available if libtcs2 is built with TCS_ENABLE_STATS */
+typedef enum tcs_api {
+    TCS_API_ADD_GROUP,
+    TCS_API_SELECT_GROUP,
+    TCS_API_GET_BOOL,
+    TCS_API_GET_INT,
+    TCS_API_GET_STRING,
+    TCS_API_GET_STRING_ARRAY,
+    TCS_API_OPEN_GROUP,
+    TCS_API_QUERY,
+    TCS_API_NB
+} tcs_api_t;
+
+#define TCS_STATS_HISTOGRAM_SIZE 32
+
+typedef struct tcs_api_stats {
+    unsigned long calls;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long long total_ns;
+    /* log2 latency histogram: bucket i counts calls lasting [2^i, 2^(i+1)[ ns */
+    unsigned long histogram[TCS_STATS_HISTOGRAM_SIZE];
+} tcs_api_stats_t;
+
+typedef struct tcs_stats {
+    tcs_api_stats_t api[TCS_API_NB];
+} tcs_stats_t;
+
+/* Timing report of tcs2_init and add_group */
+typedef enum tcs_phase {
+    TCS_PHASE_PLATFORM,      // platform detection: properties, sysfs
+    TCS_PHASE_CONFIG_READ,   // configuration file parsing (raw or flattened)
+    TCS_PHASE_MODULE_READ,   // module files parsing
+    TCS_PHASE_OVERLAY_SCAN,  // overlay folders scan (manifest or scandir)
+    TCS_PHASE_OVERLAY_READ,  // overlay files parsing
+    TCS_PHASE_OVERLAY_MERGE, // overlay files merging
+    TCS_PHASE_NB
+} tcs_phase_t;
+
+typedef struct tcs_file_timing {
+    const char *path;
+    tcs_phase_t phase;
+    unsigned long long duration_ns;
+    long long bytes;                 // size of the file. -1 if unknown
+} tcs_file_timing_t;
+
+typedef struct tcs_timing_report {
+    unsigned long long phase_ns[TCS_PHASE_NB];
+    long long phase_bytes[TCS_PHASE_NB];
+    int nb_files;
+    const tcs_file_timing_t *files;  // one entry per file and per phase, in processing order
+} tcs_timing_report_t;
+
+/* Results of the wildcard queries: one entry per matching group, in document order */
+typedef struct tcs_int_match {
+    const char *group;               // full path of the group, e.g. "crm1.hal"
+    int value;
+} tcs_int_match_t;
+
+typedef struct tcs_string_match {
+    const char *group;               // full path of the group, e.g. "crm1.hal"
+    const char *value;
+} tcs_string_match_t;
+
+/**
+ * Hashes a key for the hashed getters (32-bit FNV-1a). The C++ API computes the same hash at
+ * compile time (@see tcs.hpp)
+ *
+ * @param [in] key Name of the key
+ *
+ * @return hash of the key
+ */
+static inline unsigned int tcs_hash(const char *key)
+{
+    unsigned int hash = 2166136261u;
+
+    for (; *key; key++)
+        hash = (hash ^ (unsigned char)*key) * 16777619u;
+    return hash;
+}
 
 /******************************************************************************
 *                               IMPORTANT NOTE                               *
@@ -43,7 +126,8 @@ typedef struct tcs_ctx tcs_ctx_t;
 * Getter functions may fail as selected group may have changed.              *
 *                                                                            *
 * You should use one instance per thread or get all your parameters first    *
-* before starting your threads.                                              *
+* before starting your threads. Clones (@see tcs2_clone) are cheap instances *
+* sharing the same configuration.                                            *
 *                                                                            *
 ******************************************************************************/
 
@@ -60,6 +144,139 @@ typedef struct tcs_ctx tcs_ctx_t;
  */
 tcs_ctx_t *tcs2_init(const char *optional_group);
 
+/**
+ * Clones a context. The configuration must have been frozen (@see freeze) by the caller: it is
+ * shared with the clone and cloning costs one small allocation and no parsing. The clone has its
+ * own selected group, initially the one of the context, and can be used by another thread. The
+ * shared configuration is released by the last dispose of the context and of its clones.
+ *
+ * @param [in] ctx Module context
+ *
+ * @return a valid handle or NULL if the configuration is not frozen. Must be freed by calling the
+ *         dispose function
+ */
+tcs_ctx_t *tcs2_clone(tcs_ctx_t *ctx);
+
+typedef struct tcs_async tcs_async_t;
+
+/**
+ * Initializes TCS asynchronously
+ *
+ * Platform detection and XML parsing (@see tcs2_init) are done by a background thread. The
+ * function returns immediately. Use tcs2_async_wait() or the file descriptor provided by
+ * tcs2_async_get_fd() to know when the context is ready.
+ *
+ * @param [in] optional_group Name of the group to load (@see tcs2_init)
+ *
+ * @return a valid handle. Must be freed by calling tcs2_async_dispose
+ */
+tcs_async_t *tcs2_init_async(const char *optional_group);
+
+/**
+ * Gets the file descriptor of an asynchronous init. It becomes readable (POLLIN) once the init
+ * is over and stays readable. It can be added to a poll/epoll loop but must not be read nor closed
+ * by the caller.
+ *
+ * @param [in] handle Asynchronous init handle
+ *
+ * @return file descriptor
+ */
+int tcs2_async_get_fd(tcs_async_t *handle);
+
+/**
+ * Waits for the end of an asynchronous init
+ *
+ * @param [in] handle     Asynchronous init handle
+ * @param [in] timeout_ms Timeout in milliseconds. -1 to wait forever, 0 to poll
+ *
+ * @return 0 if init is over
+ * @return -1 in case of timeout
+ */
+int tcs2_async_wait(tcs_async_t *handle, int timeout_ms);
+
+/**
+ * Gets the result of an asynchronous init. This function blocks until the init is over.
+ * Ownership of the context is given to the caller: it must be freed by calling the dispose
+ * function. The context can be retrieved only once.
+ *
+ * @param [in]  handle Asynchronous init handle
+ * @param [out] ctx    Initialized context. NULL in case of error
+ *
+ * @return 0 if successful
+ * @return -1 if the init failed or if the context has already been retrieved
+ */
+int tcs2_async_get_result(tcs_async_t *handle, tcs_ctx_t **ctx);
+
+/**
+ * Disposes an asynchronous init handle. Waits for the end of the init if needed. The context is
+ * disposed as well if it has not been retrieved.
+ *
+ * @param [in] handle Asynchronous init handle
+ */
+void tcs2_async_dispose(tcs_async_t *handle);
+
+/* Schema of a module configuration. Generated by tcs2_codegen */
+typedef enum tcs_field_type {
+    TCS_FIELD_INT,           // int
+    TCS_FIELD_BOOL,          // bool
+    TCS_FIELD_STRING,        // char *, freed by tcs2_unload
+    TCS_FIELD_STRING_ARRAY,  // char **, freed by tcs2_unload. Number of strings stored as int
+} tcs_field_type_t;
+
+typedef struct tcs_field {
+    const char *key;
+    unsigned int hash;             // tcs_hash() of the key
+    tcs_field_type_t type;
+    size_t offset;                 // Offset of the value in the destination struct
+    size_t nb_offset;              // String arrays only: offset of the number of strings
+    bool required;                 // Load fails if the key is not found
+    bool has_default;              // Value used if the key is not found. 0 or NULL otherwise
+    int default_int;               // int and bool
+    const char *default_string;    // string
+} tcs_field_t;
+
+typedef struct tcs_path_element {
+    const char *name;
+    unsigned int hash;             // tcs_hash() of the name
+} tcs_path_element_t;
+
+typedef struct tcs_schema_group {
+    const char *path;              // Path relative to the root group. "" for the root group
+    const tcs_path_element_t *elements; // Elements of the path. NULL for the root group
+    int nb_elements;
+    const tcs_field_t *fields;
+    int nb_fields;
+} tcs_schema_group_t;
+
+typedef struct tcs_schema {
+    const tcs_schema_group_t *groups;
+    int nb_groups;
+} tcs_schema_t;
+
+/**
+ * Fills a struct described by a schema in one pass. Only the root group is looked up by path:
+ * groups and keys are then looked up with their precomputed hashes. The selected group of the
+ * context is changed.
+ *
+ * @param [in]  ctx    Module context
+ * @param [in]  root   Path of the root group (@see select_group), e.g. "crm0" or "."
+ * @param [in]  schema Schema of the struct
+ * @param [out] data   Struct to fill, zeroed by the caller. Must be freed by tcs2_unload, even
+ *                     in case of error
+ *
+ * @return 0 if successful
+ * @return -1 if a required key is not found
+ */
+int tcs2_load(tcs_ctx_t *ctx, const char *root, const tcs_schema_t *schema, void *data);
+
+/**
+ * Frees the strings and string arrays of a struct filled by tcs2_load
+ *
+ * @param [in] schema Schema of the struct
+ * @param [in] data   Struct filled by tcs2_load
+ */
+void tcs2_unload(const tcs_schema_t *schema, void *data);
+
 struct tcs_ctx {
     /**
      * Disposes the module
@@ -98,6 +315,7 @@ struct tcs_ctx {
      *                         If path doesn't start with ., full group path must be provided.
      *                         Example: If "crm0" has been provided as optional group, writing
      *                         "crm0.hal" is the same than ".hal".
+     *                         "." is the optional group itself.
      *
      * @return 0 if successful
      */
@@ -166,6 +384,218 @@ struct tcs_ctx {
      * @return valid pointers of a string array or NULL. Pointers must be freed by caller
      */
     char ** (*get_string_array)(tcs_ctx_t *ctx, const char *key, int *nb);
+
+    /**
+     * Gets the generation number of a top-level group or of the whole context
+     *
+     * Generation numbers increase monotonically. They are bumped each time a group is added,
+     * merged with an overlay or reloaded. A client can compare the value with the one read
+     * during its last update to know if its copy of the parameters is stale. In budget mode
+     * (@see remove_group), an evicted group keeps the generation it had when evicted.
+     *
+     * @param [in] ctx         Module context
+     * @param [in] group_name  Name of the top-level group. Use "." for the optional group given
+     *                         during init. If NULL, the context generation is returned
+     *
+     * @return generation number. 0 if the group is not found
+     */
+    unsigned int (*get_generation)(tcs_ctx_t *ctx, const char *group_name);
+
+    /**
+     * Gets API statistics: number of calls, hits, misses and latency histogram of each API.
+     * Statistics are dumped at dispose if the persist.tcs.stats_dump property is set to true.
+     *
+     * @param [in]  ctx   Module context
+     * @param [out] stats Snapshot of the statistics. Can be NULL if only reset is needed
+     * @param [in]  reset Resets statistics if true
+     *
+     * @return 0 if successful
+     * @return -1 if libtcs2 is built without TCS_ENABLE_STATS
+     */
+    int (*get_stats)(tcs_ctx_t *ctx, tcs_stats_t *stats, bool reset);
+
+    /**
+     * Gets the timing report of the context: time spent in each phase of tcs2_init and of all
+     * add_group calls, and time spent on each file with its size. The report is logged at the end
+     * of init if the persist.tcs.timing_log property is set to true.
+     *
+     * @param [in] ctx Module context
+     *
+     * @return valid pointer, owned by the context. It is valid until the next call to add_group
+     *         or dispose
+     */
+    const tcs_timing_report_t * (*get_timing_report)(tcs_ctx_t *ctx);
+
+    /**
+     * Hashed getters: same as get_int/get_bool, the hash of the key being provided by the caller
+     *
+     * @param [in]  ctx  Module context
+     * @param [in]  hash tcs_hash() of the key
+     * @param [in]  key  Name of the key
+     *
+     * @return 0 if successful
+     */
+    int (*get_int_hashed)(tcs_ctx_t *ctx, unsigned int hash, const char *key, int *value);
+    int (*get_bool_hashed)(tcs_ctx_t *ctx, unsigned int hash, const char *key, bool *value);
+
+    /**
+     * Gets string value of current section without copying it
+     *
+     * @param [in]  ctx  Module context
+     * @param [in]  hash tcs_hash() of the key
+     * @param [in]  key  Name of the key
+     *
+     * @return valid pointer or NULL. Pointer is owned by the context and is valid until the next
+     *         call to add_group, remove_group, freeze or dispose (@see remove_group for the
+     *         budget mode)
+     */
+    const char * (*peek_string)(tcs_ctx_t *ctx, unsigned int hash, const char *key);
+
+    /**
+     * Gets the strings of a list of current section without copying them
+     *
+     * @param [in]  ctx  Module context
+     * @param [in]  hash tcs_hash() of the list name
+     * @param [in]  key  Name of the list
+     * @param [out] nb   Number of strings
+     *
+     * @return valid array or NULL. Array and strings are owned by the context and are valid until
+     *         the next call to add_group, remove_group, freeze or dispose (@see remove_group for
+     *         the budget mode)
+     */
+    const char * const * (*peek_string_array)(tcs_ctx_t *ctx, unsigned int hash, const char *key,
+                                              int *nb);
+
+    /**
+     * Opens a group handle. Unlike select_group, the selected group of the context is not
+     * changed: any number of handles can be used at the same time, and group getters do not walk
+     * the group path again. Opening the same group twice returns the same handle. Each open
+     * must be balanced by a close_group once the handle is not used anymore.
+     *
+     * @param [in] ctx        Module context
+     * @param [in] group_path Path of the group (@see select_group for details)
+     *
+     * @return valid handle or NULL if the group is not found or is empty. The handle is owned by
+     *         the context and is valid until close_group, freeze, dispose or the removal of its
+     *         top-level group (@see remove_group). It must not be freed by the caller
+     */
+    tcs_group_t * (*open_group)(tcs_ctx_t *ctx, const char *group_path);
+
+    /**
+     * Group getters: same as get_bool, get_int, get_string and get_string_array, on the group of
+     * a handle given by open_group
+     *
+     * @param [in]  ctx   Module context
+     * @param [in]  group Group handle
+     * @param [in]  key   Name of the key
+     */
+    int (*group_get_bool)(tcs_ctx_t *ctx, tcs_group_t *group, const char *key, bool *value);
+    int (*group_get_int)(tcs_ctx_t *ctx, tcs_group_t *group, const char *key, int *value);
+    char * (*group_get_string)(tcs_ctx_t *ctx, tcs_group_t *group, const char *key);
+    char ** (*group_get_string_array)(tcs_ctx_t *ctx, tcs_group_t *group, const char *key,
+                                      int *nb);
+
+    /**
+     * Gets the value of a key in all the groups matching a pattern, in a single call.
+     * Each element of the pattern is a shell wildcard pattern (@see fnmatch), e.g. "crm*.hal"
+     * matches "crm0.hal", "crm1.hal", ... Groups where the key is not found or cannot be
+     * converted are skipped.
+     *
+     * @param [in]  ctx     Module context
+     * @param [in]  pattern Path pattern of the groups (@see select_group for path details)
+     * @param [in]  key     Name of the key
+     * @param [out] matches Array of matches. Array and strings are allocated in a single block
+     *                      which must be freed by the caller with free(). NULL if no group
+     *                      matches
+     *
+     * @return number of matches
+     */
+    int (*query_int)(tcs_ctx_t *ctx, const char *pattern, const char *key,
+                     tcs_int_match_t **matches);
+    int (*query_string)(tcs_ctx_t *ctx, const char *pattern, const char *key,
+                        tcs_string_match_t **matches);
+
+    /**
+     * Freezes the configuration: it is compacted in page-aligned read-only memory and the parsed
+     * XML trees are released. Getters, group handles and queries only read this memory
+     * afterwards: it stays shared with the processes forked after the freeze. Only the cursor of
+     * the context (selected group, statistics) is written.
+     * add_group is refused once the configuration is frozen. Group handles, strings and arrays
+     * obtained before the freeze are invalidated. Calling freeze twice has no effect.
+     * If the persist.tcs.profile property is set to true, the groups listed in the access profile
+     * of the process are laid out first, in first access order.
+     *
+     * @param [in] ctx Module context
+     *
+     * @return 0 if successful
+     */
+    int (*freeze)(tcs_ctx_t *ctx);
+
+    /**
+     * Same as get_string_array, the array and the strings being allocated in a single block
+     *
+     * @param [in]  ctx  Module context
+     * @param [in]  key  Name of the list
+     * @param [out] nb   Number of strings
+     *
+     * @return valid string array or NULL. Array and strings must be freed by the caller with a
+     *         single call to free() on the array
+     */
+    char ** (*get_string_array_packed)(tcs_ctx_t *ctx, const char *key, int *nb);
+
+    /**
+     * Removes a group added by add_group and releases its memory. The group can be added again
+     * afterwards. The group provided at init cannot be removed. If the selected group belongs to
+     * the removed group, a group must be selected again before using the getters. Group handles,
+     * strings and arrays of the removed group are invalidated.
+     *
+     * Budget mode (persist.tcs.group_budget set to N): at most N groups added by add_group are
+     * loaded at once. Once the budget is exceeded, the least recently selected group is evicted
+     * and is transparently reloaded by the next select_group or open_group on it, or by a query
+     * matching it. freeze reloads all the evicted groups. The selected group and groups with open
+     * handles (not closed by close_group) are never evicted. select_group, open_group and queries can then invalidate the
+     * strings and arrays returned by peek functions.
+     *
+     * @param [in] ctx        Module context
+     * @param [in] group_name Name of the group
+     *
+     * @return 0 if successful, -1 if the group is not added or the configuration is frozen
+     */
+    int (*remove_group)(tcs_ctx_t *ctx, const char *group_name);
+
+    /**
+     * Same as open_group for a direct child of a group handle, the hash of its name being
+     * provided by the caller: the group is found with a single index lookup
+     *
+     * @param [in] ctx    Module context
+     * @param [in] parent Group handle of the parent
+     * @param [in] hash   tcs_hash() of the group name
+     * @param [in] name   Name of the group
+     *
+     * @return valid handle or NULL if the group is not found or is empty (@see open_group)
+     */
+    tcs_group_t * (*open_group_hashed)(tcs_ctx_t *ctx, tcs_group_t *parent, unsigned int hash,
+                                       const char *name);
+
+    /**
+     * Selects the group of a handle given by open_group, without walking its path again
+     *
+     * @param [in] ctx   Module context
+     * @param [in] group Group handle
+     *
+     * @return 0 if successful
+     */
+    int (*select_group_handle)(tcs_ctx_t *ctx, tcs_group_t *group);
+
+    /**
+     * Closes a handle given by open_group or open_group_hashed. In budget mode, the group can be
+     * evicted once all its handles are closed (@see remove_group). Nothing is done once the
+     * configuration is frozen: frozen groups are never evicted
+     *
+     * @param [in] ctx   Module context
+     * @param [in] group Group handle. Can be NULL
+     */
+    void (*close_group)(tcs_ctx_t *ctx, tcs_group_t *group);
 };
 
 #ifdef __cplusplus
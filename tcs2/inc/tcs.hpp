@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCS_2_CPP_HEADER__
+#define __TCS_2_CPP_HEADER__
+
+/*
+ * Header-only C++ API (C++17) on top of tcs.h
+ *
+ * Example:
+ *     using namespace tcs::literals;
+ *
+ *     tcs::context ctx("crm0");
+ *     if (ctx && ctx.select_group(".hal")) {
+ *         int timeout = ctx.get<int>("ping_timeout"_key).value_or(1000);
+ *         std::string_view text = ctx.get<std::string_view>("hello_text"_key).value_or("");
+ *         if (auto tlvs = ctx.get<tcs::string_list>("tlvs"_key))
+ *             for (std::string_view tlv : *tlvs)
+ *                 ...
+ *     }
+ *
+ * Keys are hashed at compile time when they are constant expressions: _key literals (forced with
+ * C++20), static constexpr tcs::key objects or string literals the compiler folds.
+ * string_view and string_list results point to memory owned by the context: they are valid until
+ * the next call to add_group, remove_group or freeze, or the destruction of the context. In budget
+ * mode (persist.tcs.group_budget), select_group, and open_group or queries on the C context, can
+ * evict a group and invalidate them as well: copy them, e.g. in a std::string, before selecting
+ * another group.
+ */
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include "tcs.h"
+
+#if defined(__cpp_consteval)
+#define TCS_CONSTEVAL consteval
+#else
+#define TCS_CONSTEVAL constexpr
+#endif
+
+namespace tcs {
+
+/**
+ * Compile-time version of tcs_hash()
+ */
+constexpr unsigned int hash(std::string_view key)
+{
+    unsigned int value = 2166136261u;
+
+    for (char c : key)
+        value = (value ^ static_cast<unsigned char>(c)) * 16777619u;
+    return value;
+}
+
+/**
+ * Name of a key or of a list, with its hash
+ */
+class key {
+public:
+    constexpr key(const char *name) : m_name(name), m_hash(tcs::hash(name)) {}
+
+    constexpr const char *name() const noexcept { return m_name; }
+    constexpr unsigned int hash() const noexcept { return m_hash; }
+
+private:
+    const char *m_name;
+    unsigned int m_hash;
+};
+
+inline namespace literals {
+TCS_CONSTEVAL key operator""_key(const char *name, std::size_t)
+{
+    return key(name);
+}
+}
+
+/**
+ * Strings of a list, without copy
+ */
+class string_list {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        constexpr iterator() noexcept = default;
+        constexpr explicit iterator(const char *const *cur) noexcept : m_cur(cur) {}
+
+        std::string_view operator*() const { return *m_cur; }
+        std::string_view operator[](difference_type n) const { return m_cur[n]; }
+        iterator &operator++() noexcept { ++m_cur; return *this; }
+        iterator operator++(int) noexcept { return iterator(m_cur++); }
+        iterator &operator--() noexcept { --m_cur; return *this; }
+        iterator operator--(int) noexcept { return iterator(m_cur--); }
+        iterator &operator+=(difference_type n) noexcept { m_cur += n; return *this; }
+        iterator &operator-=(difference_type n) noexcept { m_cur -= n; return *this; }
+        iterator operator+(difference_type n) const noexcept { return iterator(m_cur + n); }
+        iterator operator-(difference_type n) const noexcept { return iterator(m_cur - n); }
+        difference_type operator-(iterator o) const noexcept { return m_cur - o.m_cur; }
+        bool operator==(iterator o) const noexcept { return m_cur == o.m_cur; }
+        bool operator!=(iterator o) const noexcept { return m_cur != o.m_cur; }
+        bool operator<(iterator o) const noexcept { return m_cur < o.m_cur; }
+        bool operator>(iterator o) const noexcept { return m_cur > o.m_cur; }
+        bool operator<=(iterator o) const noexcept { return m_cur <= o.m_cur; }
+        bool operator>=(iterator o) const noexcept { return m_cur >= o.m_cur; }
+
+    private:
+        const char *const *m_cur = nullptr;
+    };
+
+    constexpr string_list() noexcept = default;
+    constexpr string_list(const char *const *data, std::size_t size) noexcept
+        : m_data(data), m_size(size) {}
+
+    iterator begin() const noexcept { return iterator(m_data); }
+    iterator end() const noexcept { return iterator(m_data + m_size); }
+    std::size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    std::string_view operator[](std::size_t i) const { return m_data[i]; }
+    const char *const *data() const noexcept { return m_data; }
+
+private:
+    const char *const *m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+/**
+ * Owns a TCS context. Getters act on the group selected with select_group(). They return
+ * std::nullopt if the key is not found or cannot be converted. Supported types are int, bool,
+ * std::string_view and string_list (nullopt for an empty list, as get_string_array)
+ */
+class context {
+public:
+    explicit context(const char *optional_group = nullptr) : m_ctx(tcs2_init(optional_group)) {}
+
+    /* takes ownership of a context, e.g. the result of tcs2_async_get_result() */
+    explicit context(tcs_ctx_t *ctx) noexcept : m_ctx(ctx) {}
+
+    context(context &&other) noexcept : m_ctx(std::exchange(other.m_ctx, nullptr)) {}
+    context &operator=(context &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            m_ctx = std::exchange(other.m_ctx, nullptr);
+        }
+        return *this;
+    }
+
+    context(const context &) = delete;
+    context &operator=(const context &) = delete;
+
+    ~context() { reset(); }
+
+    explicit operator bool() const noexcept { return m_ctx != nullptr; }
+    tcs_ctx_t *get() const noexcept { return m_ctx; }
+
+    void add_group(const char *group_name, bool print_group = false)
+    {
+        m_ctx->add_group(m_ctx, group_name, print_group);
+    }
+
+    bool remove_group(const char *group_name)
+    {
+        return m_ctx->remove_group(m_ctx, group_name) == 0;
+    }
+
+    bool select_group(const char *group_path)
+    {
+        return m_ctx->select_group(m_ctx, group_path) == 0;
+    }
+
+    bool freeze() { return m_ctx->freeze(m_ctx) == 0; }
+
+    /* the frozen configuration is shared with the clone (@see tcs2_clone) */
+    context clone() const { return context(tcs2_clone(m_ctx)); }
+
+    void print() const { m_ctx->print(m_ctx); }
+
+    unsigned int generation(const char *group_name = nullptr) const
+    {
+        return m_ctx->get_generation(m_ctx, group_name);
+    }
+
+    template <typename T>
+    std::optional<T> get(key k) const;
+
+private:
+    void reset() noexcept
+    {
+        if (m_ctx)
+            m_ctx->dispose(m_ctx);
+        m_ctx = nullptr;
+    }
+
+    tcs_ctx_t *m_ctx;
+};
+
+template <>
+inline std::optional<int> context::get<int>(key k) const
+{
+    int value;
+
+    if (m_ctx->get_int_hashed(m_ctx, k.hash(), k.name(), &value))
+        return std::nullopt;
+    return value;
+}
+
+template <>
+inline std::optional<bool> context::get<bool>(key k) const
+{
+    bool value;
+
+    if (m_ctx->get_bool_hashed(m_ctx, k.hash(), k.name(), &value))
+        return std::nullopt;
+    return value;
+}
+
+template <>
+inline std::optional<std::string_view> context::get<std::string_view>(key k) const
+{
+    const char *value = m_ctx->peek_string(m_ctx, k.hash(), k.name());
+
+    if (!value)
+        return std::nullopt;
+    return std::string_view(value);
+}
+
+template <>
+inline std::optional<string_list> context::get<string_list>(key k) const
+{
+    int nb = 0;
+    const char *const *list = m_ctx->peek_string_array(m_ctx, k.hash(), k.name(), &nb);
+
+    if (!list)
+        return std::nullopt;
+    return string_list(list, static_cast<std::size_t>(nb));
+}
+
+} // namespace tcs
+
+#undef TCS_CONSTEVAL
+
+#endif  /* __TCS_2_CPP_HEADER__ */
@@ -23,54 +23,21 @@
  */
 
 
-#ifndef HOST_BUILD
-#include <cutils/properties.h>
-#endif
-
-#include <libxml/tree.h>
-#include <libxml/parser.h>
+#include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <pthread.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "tcs.h"
-
-/* ASSERT macro */
-#define xstr(s) str(s)
-#define str(s) #s
-
-#ifdef __GNUC__
-#define likely(x)   __builtin_expect(!!(x), 1)
-#define unlikely(x) __builtin_expect(!!(x), 0)
-#else
-#define likely(x)   (x)
-#define unlikely(x) (x)
-#endif
-
-#define DASSERT(exp, format, ...) do { \
-        if (unlikely(!(exp))) { \
-            if (unlikely(format[0] != '\0')) \
-                LOGE("AssertionLog " format, ## __VA_ARGS__); \
-            LOGE("%s:%d Assertion '" xstr(exp) "'", __FILE__, __LINE__); \
-            abort(); \
-        } \
-} while (0)
-
-#define ASSERT(exp) DASSERT(exp, "")
-
-/* XML tags */
-#define ATTR_KEY ((const xmlChar *)"key")
-#define ATTR_NAME ((const xmlChar *)"name")
-#define ATTR_OVERLAY_MODE ((const xmlChar *)"overlay")
-
-#define TAG_GROUP ((const xmlChar *)"group")
-#define TAG_CONFIG ((const xmlChar *)"config")
-#define TAG_LIST ((const xmlChar *)"list")
-#define TAG_STRING ((const xmlChar *)"string")
-#define TAG_INT ((const xmlChar *)"int")
-#define TAG_BOOL ((const xmlChar *)"bool")
+#include "tcs_internal.h"
 
 #define GROUP_SEPARATOR '.'
 
@@ -78,6 +45,8 @@
 #define TCS_XML_FOLDER "/system/vendor/etc/telephony/tcs"
 #define TCS_SYSFS_CONFIG_NAME "/sys/kernel/telephony/config_name"
 #define TCS_OVERLAY_FOLDER "/system/vendor/etc/telephony/catalog"
+#define TCS_PROFILE_FOLDER "profile"
+#define TCS_PROFILE_EXTENSION ".profile"
 
 /* PROPERTIES */
 #define TCS_KEY_ANDROID_BUILD "ro.build.type"
@@ -89,37 +58,33 @@
 #define TCS_KEY_DBG_HW_FILENAME "persist.tcs.hw_filename"
 // set by user (in debug mode) to force overlay folder
 #define TCS_KEY_DBG_SW_FOLDER "persist.tcs.sw_folder"
+// set by user (in debug mode) to ignore flattened configuration files
+#define TCS_KEY_DBG_DISABLE_FLAT "persist.tcs.disable_flat"
+// set by user to lay out the frozen configuration with the access profile of the process
+#define TCS_KEY_PROFILE "persist.tcs.profile"
+// set by user (in debug mode) to record access profiles in the given folder
+#define TCS_KEY_DBG_PROFILE_RECORD "persist.tcs.profile_record"
+// set by user to dump API statistics at dispose (libtcs2 built with TCS_ENABLE_STATS)
+#define TCS_KEY_STATS_DUMP "persist.tcs.stats_dump"
+// set by user to log the timing report at the end of init
+#define TCS_KEY_TIMING_LOG "persist.tcs.timing_log"
+// set by user to keep overlay files as layers instead of merging them in the configuration tree
+#define TCS_KEY_LAYERED_OVERLAYS "persist.tcs.layered_overlays"
+// set by user to bound the number of groups added by add_group loaded at once
+#define TCS_KEY_GROUP_BUDGET "persist.tcs.group_budget"
+// set by user to choose the XML parser: libxml2, builtin or check (builtin checked against libxml2)
+#define TCS_KEY_XML_PARSER "persist.tcs.xml_parser"
 // set by HOST test apps
 #define TCS_KEY_DBG_HOST_HW_FOLDER "tcs.dbg.host.hw_folder"
 #define TCS_KEY_DBG_HOST_OVERLAY_FOLDER "tcs.dbg.host.overlay_folder"
 
-/* Log functions: */
-#ifndef HOST_BUILD
-
-#include <utils/Log.h>
-
-#define VERBOSE ANDROID_LOG_VERBOSE
-#define DEBUG ANDROID_LOG_DEBUG
-#define ERROR ANDROID_LOG_ERROR
-
-#define TCS_LOG(level, format, ...) \
-    do { __android_log_buf_print(LOG_ID_RADIO, level, "TCS2", format, ## __VA_ARGS__); } while (0)
-
+/* parser used if TCS_KEY_XML_PARSER is not set */
+#ifdef TCS_BUILTIN_XML_PARSER
+#define TCS_DEFAULT_XML_PARSER TCS_XML_PARSER_BUILTIN
 #else
-
-#define DEBUG 'D'
-#define VERBOSE 'V'
-#define ERROR 'E'
-
-#define TCS_LOG(level, format, ...) do { tcs_host_log("%c: " format, level,  ## __VA_ARGS__); \
-} while (0)
-
+#define TCS_DEFAULT_XML_PARSER TCS_XML_PARSER_LIBXML2
 #endif
 
-#define LOGD(format, ...) TCS_LOG(DEBUG, "%-30s: " format "\n", __FUNCTION__, ## __VA_ARGS__)
-#define LOGE(format, ...) TCS_LOG(ERROR, "%-30s: " format "\n", __FUNCTION__, ## __VA_ARGS__)
-#define LOGV(format, ...) TCS_LOG(VERBOSE, format "\n", ## __VA_ARGS__)
-
 typedef struct tcs_internal_ctx {
     tcs_ctx_t ctx; // Must be first
 
@@ -127,16 +92,76 @@ typedef struct tcs_internal_ctx {
     xmlNodePtr root_node;          // Node pointing to root tree
     xmlNodePtr select_group_node;  // Node pointing to selected group
     xmlNodePtr default_group_node; // Node pointing to the group provided at init
+    bool flat;                     // True if a flattened configuration file is used
+    tcs_bundle_t *bundle;          // Flattened configuration bundle. Can be NULL
+    tcs_xml_parser_t xml_parser;   // Parser of the XML files and bundle entries
 
     char *select_group_name;       // Only for logging purpose
 
+    tcs_index_t index;             // Group infos and indexes. Its generation is bumped each
+                                   // time a top-level group changes
+    int nb_layer_docs;
+    xmlDocPtr *layer_docs;         // Layered mode: overlay files
+
+    tcs_frozen_t *frozen;          // Frozen configuration. Once set, the tree is gone
+    struct shared_config *shared;  // Owner of the frozen configuration, shared with clones
+    tcs_group_t *select_group;     // Frozen configuration: selected group
+    tcs_group_t *default_group;    // Frozen configuration: group provided at init
+
+    tcs_doc_cache_t *module_docs;  // Module files shared by several instances. Can be NULL
+    int nb_overlay_folders;
+    struct overlay_folder *overlay_folders; // Module overlay folders already scanned
+
+    int group_budget;              // Max number of added groups loaded at once. 0 if unbounded
+    int nb_module_groups;
+    struct module_group *module_groups; // Budget mode: groups added by add_group
+    unsigned long long use_count;  // Budget mode: incremented each time a group is used
+
+    tcs_profile_t *profile;        // Access profile used to lay out groups. Can be NULL
+    tcs_profile_t *record;         // Access profile being recorded. Can be NULL
+    char *record_path;
+
     char *hw_xml_folder;
     char *overlay_xml_folder;
+
+    tcs_timing_report_t timing;
+    tcs_file_timing_t *timing_files; // Owned by the context. Exposed by timing.files
+    int timing_size;
+
+#ifdef TCS_ENABLE_STATS
+    tcs_stats_t stats;
+    bool stats_dump;
+#endif
 } tcs_internal_ctx_t;
 
-#ifdef HOST_BUILD
+/* Frozen configuration shared by a context and its clones */
+typedef struct shared_config {
+    int refs;                      // Number of contexts using the configuration
+    tcs_frozen_t *frozen;
+} shared_config_t;
+
+/* Budget mode: group added by add_group */
+typedef struct module_group {
+    char *name;
+    unsigned long long last_use;   // Use count when the group was last selected
+    bool evicted;                  // Removed to stay within the budget. Reloaded when selected
+    unsigned int generation;       // Evicted groups only: generation of the group when evicted
+} module_group_t;
+
+/* libxml2 global state is released with the last context */
+static pthread_mutex_t g_libxml_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_libxml_users;
+
+struct tcs_async {
+    pthread_t thread;
+    int fd;                        // eventfd signaled once init is over
+    bool joined;
+
+    char *optional_group;
+    tcs_ctx_t *ctx;                // Result of the init. NULL in case of error
+};
 
-#define PROPERTY_VALUE_MAX 92
+#ifdef HOST_BUILD
 
 int property_get(const char *key, char *value, const char *default_value)
 {
@@ -151,25 +176,91 @@ int property_get(const char *key, char *value, const char *default_value)
 
     return strlen(value);
 }
+#endif
 
-void tcs_host_log(const char *format, ...)
+static void libxml_ref(void)
 {
-    va_list args;
+    ASSERT(pthread_mutex_lock(&g_libxml_lock) == 0);
+    g_libxml_users++;
+    ASSERT(pthread_mutex_unlock(&g_libxml_lock) == 0);
+}
 
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
+static void libxml_unref(void)
+{
+    ASSERT(pthread_mutex_lock(&g_libxml_lock) == 0);
+    ASSERT(g_libxml_users > 0);
+    if (!--g_libxml_users)
+        xmlCleanupParser();
+    ASSERT(pthread_mutex_unlock(&g_libxml_lock) == 0);
 }
-#endif
 
-static inline xmlNodePtr next_node(xmlNodePtr cur)
+static inline unsigned long long now_ns(void)
 {
-    do
-        cur = cur->next;
-    while ((cur != NULL) && (cur->type != XML_ELEMENT_NODE));
-    return cur;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static long long file_size(const char *path)
+{
+    struct stat st;
+
+    return stat(path, &st) ? -1 : (long long)st.st_size;
+}
+
+/**
+ * Accounts the time elapsed since start to the phase. If path is not NULL, an entry is added to
+ * the list of files of the report
+ */
+static void timing_add(tcs_internal_ctx_t *i_ctx, tcs_phase_t phase, unsigned long long start,
+                       const char *path, long long bytes)
+{
+    ASSERT(i_ctx);
+    ASSERT(phase < TCS_PHASE_NB);
+
+    unsigned long long duration = now_ns() - start;
+    i_ctx->timing.phase_ns[phase] += duration;
+    if (!path)
+        return;
+
+    if (bytes > 0)
+        i_ctx->timing.phase_bytes[phase] += bytes;
+
+    if (i_ctx->timing.nb_files == i_ctx->timing_size) {
+        i_ctx->timing_size = i_ctx->timing_size ? 2 * i_ctx->timing_size : 16;
+        i_ctx->timing_files = realloc(i_ctx->timing_files,
+                                      i_ctx->timing_size * sizeof(tcs_file_timing_t));
+        ASSERT(i_ctx->timing_files);
+        i_ctx->timing.files = i_ctx->timing_files;
+    }
+
+    tcs_file_timing_t *file = &i_ctx->timing_files[i_ctx->timing.nb_files++];
+    file->path = strdup(path);
+    ASSERT(file->path);
+    file->phase = phase;
+    file->duration_ns = duration;
+    file->bytes = bytes;
+}
+
+static void print_timing(tcs_internal_ctx_t *i_ctx)
+{
+    static const char *const phases[TCS_PHASE_NB] = {
+        "platform", "config read", "module read", "overlay scan", "overlay read", "overlay merge"
+    };
+
+    ASSERT(i_ctx);
+
+    const tcs_timing_report_t *timing = &i_ctx->timing;
+    for (int i = 0; i < TCS_PHASE_NB; i++)
+        LOGD("timing: %-13s %8llu us %8lld bytes", phases[i], timing->phase_ns[i] / 1000,
+             timing->phase_bytes[i]);
+    for (int i = 0; i < timing->nb_files; i++)
+        LOGD("timing: %-13s %8llu us %8lld bytes %s", phases[timing->files[i].phase],
+             timing->files[i].duration_ns / 1000, timing->files[i].bytes, timing->files[i].path);
 }
 
+#if TCS_LOG_LEVEL <= TCS_LOG_LEVEL_VERBOSE
 static void print_node(xmlNodePtr node, int level)
 {
     if (!node)
@@ -177,28 +268,65 @@ static void print_node(xmlNodePtr node, int level)
 
     for (; node; node = next_node(node)) {
         if (!xmlStrcmp(node->name, TAG_GROUP)) {
-            xmlChar *name = xmlGetProp(node, ATTR_NAME);
-            LOGV("%*s====== Group: %s ======", level, " ", name);
-            xmlFree(name);
+            LOGV("%*s====== Group: %s ======", level, " ", tcs_peek_prop(node, ATTR_NAME));
             print_node(next_node(node->children), level + 4);
         } else if (!xmlStrcmp(node->name, TAG_LIST)) {
-            xmlChar *name = xmlGetProp(node, ATTR_NAME);
-            LOGV("%*s====== List: %s ======", level, " ", name);
-            xmlFree(name);
+            LOGV("%*s====== List: %s ======", level, " ", tcs_peek_prop(node, ATTR_NAME));
             print_node(next_node(node->children), level + 4);
         } else {
-            xmlChar *content = xmlNodeGetContent(node);
-            xmlChar *key = xmlGetProp(node, ATTR_KEY);
             /* sanity test */
             ASSERT(!xmlStrcmp(node->name, TAG_STRING) ||
                    !xmlStrcmp(node->name, TAG_INT) ||
                    !xmlStrcmp(node->name, TAG_BOOL));
-            LOGV("%*s<%-6s> {%-35s} (%s)", level, " ", node->name, key, content);
-            xmlFree(content);
-            xmlFree(key);
+            const xmlChar *key = tcs_peek_prop(node, ATTR_KEY);
+            const xmlChar *content = tcs_peek_content(node);
+            if (content) {
+                LOGV("%*s<%-6s> {%-35s} (%s)", level, " ", node->name, key, content);
+            } else {
+                /* content split in several nodes (entities, comments...) */
+                xmlChar *tmp = xmlNodeGetContent(node);
+                LOGV("%*s<%-6s> {%-35s} (%s)", level, " ", node->name, key, tmp);
+                xmlFree(tmp);
+            }
+        }
+    }
+}
+#else
+static void print_node(xmlNodePtr node, int level)
+{
+    (void)node;
+    (void)level;
+}
+#endif
+
+#if TCS_LOG_LEVEL <= TCS_LOG_LEVEL_VERBOSE
+static void print_frozen(const tcs_group_t *group, int level)
+{
+    for (unsigned int i = 0; i <= group->mask; i++) {
+        const tcs_index_entry_t *entry = &group->entries[i];
+        if (!entry->key)
+            continue;
+
+        if (entry->tag == TCS_TAG_GROUP) {
+            LOGV("%*s====== Group: %s ======", level, " ", entry->key);
+            print_frozen(entry->group, level + 4);
+        } else if (entry->tag == TCS_TAG_LIST) {
+            LOGV("%*s====== List: %s ======", level, " ", entry->key);
+            for (int j = 0; j < entry->nb; j++)
+                LOGV("%*s<%-6s> (%s)", level + 4, " ", TAG_STRING, entry->list[j]);
+        } else {
+            LOGV("%*s<%-6s> {%-35s} (%s)", level, " ", tcs_tag_name(entry->tag), entry->key,
+                 entry->value);
         }
     }
 }
+#else
+static void print_frozen(const tcs_group_t *group, int level)
+{
+    (void)group;
+    (void)level;
+}
+#endif
 
 /**
  * @see tcs.h
@@ -209,7 +337,17 @@ static void print(tcs_ctx_t *ctx)
 
     ASSERT(i_ctx);
 
+    if (i_ctx->frozen) {
+        print_frozen(i_ctx->frozen->root, 0);
+        return;
+    }
+
     print_node(next_node(i_ctx->root_node->children), 0);
+    for (int i = 0; i < i_ctx->nb_layer_docs; i++) {
+        xmlNodePtr node = xmlDocGetRootElement(i_ctx->layer_docs[i]);
+        LOGV("====== Overlay layer: %s ======", i_ctx->layer_docs[i]->URL);
+        print_node(xmlStrcmp(node->name, TAG_CONFIG) ? node : next_node(node->children), 4);
+    }
 }
 
 static xmlNodePtr search_node(xmlNodePtr node, const xmlChar *tag, const xmlChar *prop,
@@ -250,6 +388,19 @@ static inline xmlNodePtr search_property(xmlNodePtr node, const xmlChar *tag, co
     return search_node(node, tag, ATTR_KEY, key);
 }
 
+/**
+ * Bumps the context generation and stamps it on the given top-level group.
+ * Group generation is stored in the group info (@see tcs_index.c). Indexes built before are
+ * rebuilt at next lookup
+ */
+static void bump_generation(tcs_internal_ctx_t *i_ctx, xmlNodePtr group_node)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_node);
+
+    tcs_group_info_get(&i_ctx->index, group_node)->generation = ++i_ctx->index.generation;
+}
+
 static void parse_overlay_group(xmlNodePtr overlay_node, xmlNodePtr root_node)
 {
     ASSERT(overlay_node);
@@ -349,434 +500,2251 @@ static void parse_overlay_group(xmlNodePtr overlay_node, xmlNodePtr root_node)
     }
 }
 
+static void get_default_group_name(tcs_internal_ctx_t *i_ctx, char *name, size_t len)
+{
+    if (i_ctx->frozen) {
+        ASSERT(i_ctx->default_group);
+        snprintf(name, len, "%s", i_ctx->default_group->path);
+        return;
+    }
+
+    ASSERT(i_ctx->default_group_node);
+    xmlChar *tmp = xmlGetProp(i_ctx->default_group_node, ATTR_NAME);
+    ASSERT(tmp);
+    snprintf(name, len, "%s", tmp);
+    xmlFree(tmp);
+}
+
 /**
- * @see tcs.h
+ * Gives the path of a group from the root
+ *
+ * @param [in]  i_ctx      Module context
+ * @param [in]  group_name Path of the group (@see select_group)
+ * @param [out] path       Path of the group from the root
+ * @param [in]  len        Size of path
  */
-static int select_group(tcs_ctx_t *ctx, const char *group_name)
+static void get_full_path(tcs_internal_ctx_t *i_ctx, const char *group_name, char *path,
+                          size_t len)
 {
-    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+    if (*group_name == GROUP_SEPARATOR) {
+        char name[128];
+        get_default_group_name(i_ctx, name, sizeof(name));
+        snprintf(path, len, "%s%s", name, group_name);
+    } else {
+        snprintf(path, len, "%s", group_name);
+    }
+}
+
+/**
+ * Records the selection of a group in the access profile. Group path is stored from the root
+ */
+static void record_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
+{
+    ASSERT(i_ctx);
+    ASSERT(i_ctx->record);
+    ASSERT(group_name);
+
+    char path[256];
+    get_full_path(i_ctx, group_name, path, sizeof(path));
+    tcs_profile_record_group(i_ctx->record, path);
+}
+
+/**
+ * Copies the element of a group path starting at cur
+ *
+ * @return the separator following the element or NULL if it is the last one
+ */
+static const char *get_path_element(const char *cur, char *element, size_t len)
+{
+    const char *tmp = strchr(cur, GROUP_SEPARATOR);
+    size_t element_len = tmp ? (size_t)(tmp - cur) : strlen(cur);
+
+    ASSERT(element_len < len);
+    memcpy(element, cur, element_len);
+    element[element_len] = '\0';
+
+    return tmp;
+}
+
+/**
+ * Finds a group from its path, using the group indexes: groups only found in overlay layers are
+ * found too
+ *
+ * @param [in] i_ctx Module context
+ * @param [in] node  Parent group node
+ * @param [in] path  Path of the group, relative to the parent. Use a . as separator
+ *
+ * @return the group node or NULL if not found
+ */
+static xmlNodePtr lookup_group(tcs_internal_ctx_t *i_ctx, xmlNodePtr node, const char *path)
+{
+    ASSERT(node);
+    ASSERT(path);
+
+    for (const char *cur = path; node;) {
+        char group_name[40];
+        const char *tmp = get_path_element(cur, group_name, sizeof(group_name));
+
+        const tcs_index_entry_t *entry = tcs_index_lookup(&i_ctx->index, node, TCS_TAG_GROUP,
+                                                          tcs_hash(group_name), group_name);
+        node = entry ? entry->node : NULL;
+        if (!tmp)
+            break;
+        cur = tmp + 1;
+    }
 
+    return node;
+}
+
+static void use_module_group(tcs_internal_ctx_t *i_ctx, const char *group_path);
+static bool reload_module_groups(tcs_internal_ctx_t *i_ctx, const char *pattern);
+static void evict_module_groups(tcs_internal_ctx_t *i_ctx, const char *keep);
+
+/**
+ * Finds a group from a path given by the client
+ *
+ * @param [in] i_ctx      Module context
+ * @param [in] group_name Path of the group (@see select_group)
+ *
+ * @return the group node or NULL if not found or empty
+ */
+static xmlNodePtr resolve_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
+{
     ASSERT(i_ctx);
     ASSERT(group_name);
 
+    if (i_ctx->group_budget)
+        use_module_group(i_ctx, group_name);
+
+    xmlNodePtr node = i_ctx->root_node;
     const char *cur = group_name;
     if (*cur == GROUP_SEPARATOR) {
         if (!i_ctx->default_group_node) {
-            LOGE("Group (%s) not found. No default group provided", group_name);
-            return -1;
+            LOGE_RL("Group (%s) not found. No default group provided", group_name);
+            return NULL;
         }
-        i_ctx->select_group_node = i_ctx->default_group_node;
-        cur = (char *)group_name + 1;
-    } else {
-        i_ctx->select_group_node = i_ctx->root_node;
+        node = i_ctx->default_group_node;
+        cur = group_name + 1;
     }
 
-    free(i_ctx->select_group_name);
-    i_ctx->select_group_name = strdup(group_name);
+    if (*cur != '\0')
+        node = lookup_group(i_ctx, node, cur);
+    if (!node)
+        return NULL;
 
-    for (;; ) {
-        char group_name[40];
-        char *tmp = strchr(cur, GROUP_SEPARATOR);
-        size_t len;
-        if (tmp)
-            len = (size_t)(tmp - cur + 1);
-        else
-            len = strlen(cur) + 1;
-        ASSERT((len > 0) && (len <= sizeof(group_name)));
-        snprintf(group_name, len, "%s", cur);
+    if (i_ctx->record)
+        record_group(i_ctx, group_name);
+
+    if (!next_node(node->children)) {
+        LOGD_RL("Group (%s) is empty", group_name);
+        return NULL;
+    }
+
+    return node;
+}
+
+static bool is_empty(const tcs_group_t *group)
+{
+    for (unsigned int i = 0; i <= group->mask; i++)
+        if (group->entries[i].key)
+            return false;
+    return true;
+}
+
+/**
+ * Finds a group of the frozen configuration from a path given by the client
+ *
+ * @param [in] i_ctx      Module context
+ * @param [in] group_name Path of the group (@see select_group)
+ *
+ * @return the group or NULL if not found or empty
+ */
+static tcs_group_t *resolve_frozen_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_name);
 
-        i_ctx->select_group_node = search_group(next_node(i_ctx->select_group_node->children),
-                                                (xmlChar *)group_name);
-        if (!i_ctx->select_group_node)
-            return -1;
+    tcs_group_t *group = i_ctx->frozen->root;
+    const char *cur = group_name;
+    if (*cur == GROUP_SEPARATOR) {
+        if (!i_ctx->default_group) {
+            LOGE_RL("Group (%s) not found. No default group provided", group_name);
+            return NULL;
+        }
+        group = i_ctx->default_group;
+        cur = group_name + 1;
+    }
 
+    while (group && (*cur != '\0')) {
+        char name[40];
+        const char *tmp = get_path_element(cur, name, sizeof(name));
+        const tcs_index_entry_t *entry = tcs_index_find(group, TCS_TAG_GROUP, tcs_hash(name),
+                                                        name);
+        group = entry ? entry->group : NULL;
         if (!tmp)
             break;
-        else
-            cur = tmp + 1;
+        cur = tmp + 1;
     }
+    if (!group)
+        return NULL;
 
-    i_ctx->select_group_node = next_node(i_ctx->select_group_node->children);
-    if (!i_ctx->select_group_node) {
-        LOGD("Group (%s) is empty", group_name);
-        return -1;
+    if (i_ctx->record)
+        record_group(i_ctx, group_name);
+
+    if (is_empty(group)) {
+        LOGD_RL("Group (%s) is empty", group_name);
+        return NULL;
     }
 
-    return 0;
+    return group;
+}
+
+static int priv_select_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_name);
+
+    if (i_ctx->frozen) {
+        /* only the cursor is written: the group path is the one of the frozen group */
+        i_ctx->select_group = resolve_frozen_group(i_ctx, group_name);
+        return i_ctx->select_group ? 0 : -1;
+    }
+
+    free(i_ctx->select_group_name);
+    i_ctx->select_group_name = strdup(group_name);
+
+    xmlNodePtr node = resolve_group(i_ctx, group_name);
+    i_ctx->select_group_node = node ? next_node(node->children) : NULL;
+
+    return node ? 0 : -1;
 }
 
 /**
  * @see tcs.h
  */
-static int get_bool(tcs_ctx_t *ctx, const char *key, bool *value)
+static int select_group(tcs_ctx_t *ctx, const char *group_name)
 {
     tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
-    int ret = -1;
 
-    ASSERT(i_ctx);
-    ASSERT(i_ctx->select_group_node);
-    ASSERT(key);
-    ASSERT(value);
+    STATS_START(start);
+    int ret = priv_select_group(i_ctx, group_name);
+    STATS_STOP(&i_ctx->stats, TCS_API_SELECT_GROUP, start, ret == 0);
 
-    xmlNodePtr node = search_property(i_ctx->select_group_node, TAG_BOOL, (const xmlChar *)key);
-    if (node) {
-        xmlChar *str = xmlNodeGetContent(node);
-        if (str) {
-            if (!strcmp((char *)str, "true")) {
-                *value = true;
-                ret = 0;
-            } else if (!strcmp((char *)str, "false")) {
-                *value = false;
-                ret = 0;
-            } else {
-                LOGE("Conversion failure for key (%s) group (%s)", key, i_ctx->select_group_name);
+    return ret;
+}
+
+/**
+ * @see tcs.h
+ */
+static tcs_group_t *open_group(tcs_ctx_t *ctx, const char *group_name)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+    tcs_group_t *group = NULL;
+
+    STATS_START(start);
+
+    if (i_ctx->frozen) {
+        group = resolve_frozen_group(i_ctx, group_name);
+    } else {
+        xmlNodePtr node = resolve_group(i_ctx, group_name);
+        if (node) {
+            group = tcs_group_info_get(&i_ctx->index, node);
+            if (!group->path) {
+                char path[256];
+                get_full_path(i_ctx, group_name, path, sizeof(path));
+                group->path = strdup(path);
+                ASSERT(group->path);
             }
-            xmlFree(str);
+            group->refs++;
         }
     }
 
-    return ret;
+    STATS_STOP(&i_ctx->stats, TCS_API_OPEN_GROUP, start, group != NULL);
+
+    return group;
 }
 
 /**
  * @see tcs.h
  */
-static int get_int(tcs_ctx_t *ctx, const char *key, int *value)
+static tcs_group_t *open_group_hashed(tcs_ctx_t *ctx, tcs_group_t *parent, unsigned int hash,
+                                      const char *name)
 {
     tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
-    int ret = -1;
+    tcs_group_t *group = NULL;
 
-    ASSERT(i_ctx);
-    ASSERT(i_ctx->select_group_node);
-    ASSERT(key);
-    ASSERT(value);
+    STATS_START(start);
 
-    xmlNodePtr node = search_property(i_ctx->select_group_node, TAG_INT, (const xmlChar *)key);
-    if (node) {
-        xmlChar *str = xmlNodeGetContent(node);
-        if (str) {
-            errno = 0;
-            char *end_ptr = NULL;
-            *value = strtol((char *)str, &end_ptr, 0);
-            if ((errno != 0) || (end_ptr == (char *)str) || (*end_ptr != '\0'))
-                LOGE("Conversion failure for key (%s) group (%s)", key, i_ctx->select_group_name);
-            else
-                ret = 0;
+    ASSERT(parent);
+    ASSERT(name);
 
-            xmlFree(str);
+    if (i_ctx->frozen) {
+        const tcs_index_entry_t *entry = tcs_index_find(parent, TCS_TAG_GROUP, hash, name);
+        if (entry && !is_empty(entry->group))
+            group = entry->group;
+    } else {
+        const tcs_index_entry_t *entry = tcs_index_lookup(&i_ctx->index, parent->node,
+                                                          TCS_TAG_GROUP, hash, name);
+        if (entry && next_node(entry->node->children)) {
+            group = tcs_group_info_get(&i_ctx->index, entry->node);
+            if (!group->path) {
+                char path[256];
+                snprintf(path, sizeof(path), "%s%c%s", parent->path, GROUP_SEPARATOR, name);
+                group->path = strdup(path);
+                ASSERT(group->path);
+            }
+            group->refs++;
         }
     }
+    if (group && i_ctx->record)
+        tcs_profile_record_group(i_ctx->record, group->path);
 
-    return ret;
+    STATS_STOP(&i_ctx->stats, TCS_API_OPEN_GROUP, start, group != NULL);
+
+    return group;
 }
 
 /**
  * @see tcs.h
  */
-static char *get_string(tcs_ctx_t *ctx, const char *key)
+static int select_group_handle(tcs_ctx_t *ctx, tcs_group_t *group)
 {
     tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
-    char *value = NULL;
+    int ret = 0;
 
-    ASSERT(i_ctx);
-    ASSERT(i_ctx->select_group_node);
-    ASSERT(key);
+    STATS_START(start);
 
-    xmlNodePtr node = search_property(i_ctx->select_group_node, TAG_STRING, (const xmlChar *)key);
-    if (node) {
-        xmlChar *data = xmlNodeGetContent(node);
-        ASSERT(data);
-        value = strdup((char *)data);
-        ASSERT(value);
-        xmlFree(data);
+    ASSERT(group);
+
+    if (i_ctx->frozen) {
+        i_ctx->select_group = group;
+    } else {
+        free(i_ctx->select_group_name);
+        i_ctx->select_group_name = strdup(group->path);
+        ASSERT(i_ctx->select_group_name);
+        i_ctx->select_group_node = next_node(group->node->children);
+        ret = i_ctx->select_group_node ? 0 : -1;
     }
+    if (i_ctx->record)
+        tcs_profile_record_group(i_ctx->record, group->path);
 
-    return value;
+    STATS_STOP(&i_ctx->stats, TCS_API_SELECT_GROUP, start, ret == 0);
+
+    return ret;
 }
 
 /**
  * @see tcs.h
  */
-static char **get_string_array(tcs_ctx_t *ctx, const char *list_name, int *nb)
+static void close_group(tcs_ctx_t *ctx, tcs_group_t *group)
 {
     tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
-    char **array = NULL;
 
     ASSERT(i_ctx);
-    ASSERT(i_ctx->select_group_node);
-    ASSERT(list_name);
-    ASSERT(nb);
 
-    *nb = 0;
-    xmlNodePtr node = search_list(i_ctx->select_group_node, (xmlChar *)list_name);
-    if (node) {
-        node = next_node(node->children);
-        if (!node) {
-            LOGD("List (%s) is empty", list_name);
-            return NULL;
-        }
+    /* frozen groups are read-only */
+    if (!group || i_ctx->frozen)
+        return;
 
-        xmlNodePtr tmp = node;
-        do
-            (*nb)++;
-        while ((tmp = next_node(tmp)) != NULL);
-        array = malloc(*nb * sizeof(char *));
-        ASSERT(array);
-        for (int i = 0; i < *nb; i++) {
-            xmlChar *data = xmlNodeGetContent(node);
-            ASSERT(data);
-            array[i] = strdup((char *)data);
-            ASSERT(array[i]);
-            xmlFree(data);
-            node = next_node(node);
+    ASSERT(group->refs > 0);
+    group->refs--;
+}
+
+/**
+ * Looks up a property or a list in a group handle or, if group is NULL, in the selected group
+ */
+static const tcs_index_entry_t *lookup(tcs_internal_ctx_t *i_ctx, tcs_group_t *group,
+                                       tcs_tag_t tag, const xmlChar *xml_tag, unsigned int hash,
+                                       const char *key)
+{
+    ASSERT(i_ctx);
+    ASSERT(key);
+
+    xmlNodePtr node = NULL;
+    if (group) {
+        node = group->node;
+        if (i_ctx->record)
+            tcs_profile_record_group_key(i_ctx->record, group->path, xml_tag, key);
+    } else {
+        if (i_ctx->frozen) {
+            ASSERT(i_ctx->select_group);
+            group = i_ctx->select_group;
+        } else {
+            ASSERT(i_ctx->select_group_node);
+            node = i_ctx->select_group_node->parent;
         }
+        if (i_ctx->record)
+            tcs_profile_record_key(i_ctx->record, xml_tag, key);
     }
 
-    return array;
+    if (i_ctx->frozen)
+        return tcs_index_find(group, tag, hash, key);
+    return tcs_index_lookup(&i_ctx->index, node, tag, hash, key);
 }
 
-static bool is_user_build(void)
+static inline const char *group_name(tcs_internal_ctx_t *i_ctx, tcs_group_t *group)
 {
-    char build[PROPERTY_VALUE_MAX] = { "\0" };
+    if (!group && i_ctx->frozen)
+        group = i_ctx->select_group;
+    return group ? group->path : i_ctx->select_group_name;
+}
+
+static int priv_get_bool(tcs_internal_ctx_t *i_ctx, tcs_group_t *group, unsigned int hash,
+                         const char *key, bool *value)
+{
+    int ret = -1;
+
+    STATS_START(start);
+
+    ASSERT(value);
+
+    const tcs_index_entry_t *entry = lookup(i_ctx, group, TCS_TAG_BOOL, TAG_BOOL, hash, key);
+    if (entry) {
+        if (!strcmp(entry->value, "true")) {
+            *value = true;
+            ret = 0;
+        } else if (!strcmp(entry->value, "false")) {
+            *value = false;
+            ret = 0;
+        } else {
+            LOGE_RL("Conversion failure for key (%s) group (%s)", key, group_name(i_ctx, group));
+        }
+    }
+
+    STATS_STOP(&i_ctx->stats, TCS_API_GET_BOOL, start, ret == 0);
+
+    return ret;
+}
+
+/**
+ * @see tcs.h
+ */
+static int get_bool(tcs_ctx_t *ctx, const char *key, bool *value)
+{
+    ASSERT(key);
+    return priv_get_bool((tcs_internal_ctx_t *)ctx, NULL, tcs_hash(key), key, value);
+}
+
+/**
+ * @see tcs.h
+ */
+static int get_bool_hashed(tcs_ctx_t *ctx, unsigned int hash, const char *key, bool *value)
+{
+    return priv_get_bool((tcs_internal_ctx_t *)ctx, NULL, hash, key, value);
+}
+
+/**
+ * @see tcs.h
+ */
+static int group_get_bool(tcs_ctx_t *ctx, tcs_group_t *group, const char *key, bool *value)
+{
+    ASSERT(group);
+    ASSERT(key);
+    return priv_get_bool((tcs_internal_ctx_t *)ctx, group, tcs_hash(key), key, value);
+}
+
+static int to_int(const char *str, int *value)
+{
+    errno = 0;
+    char *end_ptr = NULL;
+    *value = strtol(str, &end_ptr, 0);
+
+    return ((errno != 0) || (end_ptr == str) || (*end_ptr != '\0')) ? -1 : 0;
+}
+
+static int priv_get_int(tcs_internal_ctx_t *i_ctx, tcs_group_t *group, unsigned int hash,
+                        const char *key, int *value)
+{
+    int ret = -1;
+
+    STATS_START(start);
+
+    ASSERT(value);
+
+    const tcs_index_entry_t *entry = lookup(i_ctx, group, TCS_TAG_INT, TAG_INT, hash, key);
+    if (entry) {
+        if (to_int(entry->value, value))
+            LOGE_RL("Conversion failure for key (%s) group (%s)", key, group_name(i_ctx, group));
+        else
+            ret = 0;
+    }
+
+    STATS_STOP(&i_ctx->stats, TCS_API_GET_INT, start, ret == 0);
+
+    return ret;
+}
+
+/**
+ * @see tcs.h
+ */
+static int get_int(tcs_ctx_t *ctx, const char *key, int *value)
+{
+    ASSERT(key);
+    return priv_get_int((tcs_internal_ctx_t *)ctx, NULL, tcs_hash(key), key, value);
+}
+
+/**
+ * @see tcs.h
+ */
+static int get_int_hashed(tcs_ctx_t *ctx, unsigned int hash, const char *key, int *value)
+{
+    return priv_get_int((tcs_internal_ctx_t *)ctx, NULL, hash, key, value);
+}
+
+/**
+ * @see tcs.h
+ */
+static int group_get_int(tcs_ctx_t *ctx, tcs_group_t *group, const char *key, int *value)
+{
+    ASSERT(group);
+    ASSERT(key);
+    return priv_get_int((tcs_internal_ctx_t *)ctx, group, tcs_hash(key), key, value);
+}
+
+static char *priv_get_string(tcs_internal_ctx_t *i_ctx, tcs_group_t *group, const char *key)
+{
+    char *value = NULL;
+
+    STATS_START(start);
+
+    ASSERT(key);
+
+    const tcs_index_entry_t *entry = lookup(i_ctx, group, TCS_TAG_STRING, TAG_STRING,
+                                            tcs_hash(key), key);
+    if (entry) {
+        value = strdup(entry->value);
+        ASSERT(value);
+    }
+
+    STATS_STOP(&i_ctx->stats, TCS_API_GET_STRING, start, value != NULL);
+
+    return value;
+}
+
+/**
+ * @see tcs.h
+ */
+static char *get_string(tcs_ctx_t *ctx, const char *key)
+{
+    return priv_get_string((tcs_internal_ctx_t *)ctx, NULL, key);
+}
+
+/**
+ * @see tcs.h
+ */
+static char *group_get_string(tcs_ctx_t *ctx, tcs_group_t *group, const char *key)
+{
+    ASSERT(group);
+    return priv_get_string((tcs_internal_ctx_t *)ctx, group, key);
+}
+
+/**
+ * @see tcs.h
+ */
+static const char *peek_string(tcs_ctx_t *ctx, unsigned int hash, const char *key)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+
+    STATS_START(start);
+    const tcs_index_entry_t *entry = lookup(i_ctx, NULL, TCS_TAG_STRING, TAG_STRING, hash, key);
+    STATS_STOP(&i_ctx->stats, TCS_API_GET_STRING, start, entry != NULL);
+
+    return entry ? entry->value : NULL;
+}
+
+static const tcs_index_entry_t *lookup_list(tcs_internal_ctx_t *i_ctx, tcs_group_t *group,
+                                            unsigned int hash, const char *list_name, int *nb)
+{
+    ASSERT(nb);
+
+    const tcs_index_entry_t *entry = lookup(i_ctx, group, TCS_TAG_LIST, TAG_LIST, hash,
+                                            list_name);
+    *nb = entry ? entry->nb : 0;
+    if (entry && !entry->nb)
+        LOGD_RL("List (%s) is empty", list_name);
+
+    return entry;
+}
+
+static char **priv_get_string_array(tcs_internal_ctx_t *i_ctx, tcs_group_t *group,
+                                    const char *list_name, int *nb)
+{
+    char **array = NULL;
+
+    STATS_START(start);
+
+    ASSERT(list_name);
+
+    const tcs_index_entry_t *entry = lookup_list(i_ctx, group, tcs_hash(list_name), list_name,
+                                                 nb);
+    if (entry && entry->nb) {
+        array = malloc(*nb * sizeof(char *));
+        ASSERT(array);
+        for (int i = 0; i < *nb; i++) {
+            array[i] = strdup(entry->list[i]);
+            ASSERT(array[i]);
+        }
+    }
+
+    STATS_STOP(&i_ctx->stats, TCS_API_GET_STRING_ARRAY, start, entry != NULL);
+
+    return array;
+}
+
+/**
+ * @see tcs.h
+ */
+static char **get_string_array(tcs_ctx_t *ctx, const char *list_name, int *nb)
+{
+    return priv_get_string_array((tcs_internal_ctx_t *)ctx, NULL, list_name, nb);
+}
+
+/**
+ * @see tcs.h
+ */
+static char **group_get_string_array(tcs_ctx_t *ctx, tcs_group_t *group, const char *list_name,
+                                     int *nb)
+{
+    ASSERT(group);
+    return priv_get_string_array((tcs_internal_ctx_t *)ctx, group, list_name, nb);
+}
+
+/**
+ * @see tcs.h
+ */
+static char **get_string_array_packed(tcs_ctx_t *ctx, const char *list_name, int *nb)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+    char **array = NULL;
+
+    STATS_START(start);
+
+    ASSERT(list_name);
+
+    const tcs_index_entry_t *entry = lookup_list(i_ctx, NULL, tcs_hash(list_name), list_name,
+                                                 nb);
+    if (entry && entry->nb) {
+        size_t size = *nb * sizeof(char *);
+        for (int i = 0; i < *nb; i++)
+            size += strlen(entry->list[i]) + 1;
+
+        array = malloc(size);
+        ASSERT(array);
+        char *strings = (char *)(array + *nb);
+        for (int i = 0; i < *nb; i++) {
+            array[i] = strings;
+            strings = stpcpy(strings, entry->list[i]) + 1;
+        }
+    }
+
+    STATS_STOP(&i_ctx->stats, TCS_API_GET_STRING_ARRAY, start, entry != NULL);
+
+    return array;
+}
+
+/**
+ * @see tcs.h
+ */
+static const char *const *peek_string_array(tcs_ctx_t *ctx, unsigned int hash,
+                                            const char *list_name, int *nb)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+
+    STATS_START(start);
+    const tcs_index_entry_t *entry = lookup_list(i_ctx, NULL, hash, list_name, nb);
+    STATS_STOP(&i_ctx->stats, TCS_API_GET_STRING_ARRAY, start, entry != NULL);
+
+    return entry ? entry->list : NULL;
+}
+
+typedef struct query_match {
+    char *group;
+    const char *value;
+} query_match_t;
+
+typedef struct query {
+    tcs_internal_ctx_t *i_ctx;
+    tcs_tag_t tag;
+    const xmlChar *xml_tag;
+    unsigned int hash;
+    const char *key;
+    int nb;
+    int size;
+    query_match_t *matches;
+    size_t strings_size;           // Size of the strings of the matches, with terminators
+    bool reloaded;                 // Budget mode: evicted groups reloaded for the query
+} query_t;
+
+static void query_add_match(query_t *q, const tcs_group_t *group, const char *path)
+{
+    tcs_internal_ctx_t *i_ctx = q->i_ctx;
+
+    if (i_ctx->record)
+        tcs_profile_record_group_key(i_ctx->record, path, q->xml_tag, q->key);
+
+    const tcs_index_entry_t *entry = tcs_index_find(group, q->tag, q->hash, q->key);
+    if (!entry)
+        return;
+
+    if (q->nb == q->size) {
+        q->size = q->size ? 2 * q->size : 8;
+        q->matches = realloc(q->matches, q->size * sizeof(query_match_t));
+        ASSERT(q->matches);
+    }
+    query_match_t *match = &q->matches[q->nb++];
+    match->group = strdup(path);
+    ASSERT(match->group);
+    match->value = entry->value;
+    q->strings_size += strlen(path) + 1;
+    if (q->tag == TCS_TAG_STRING)
+        q->strings_size += strlen(entry->value) + 1;
+}
+
+static void query_walk(query_t *q, xmlNodePtr node, const char *pattern, const char *path);
+
+static void query_group(query_t *q, xmlNodePtr group, const char *name, const char *next,
+                        const char *path)
+{
+    char group_path[256];
+
+    snprintf(group_path, sizeof(group_path), "%s%s%s", path, *path ? "." : "", name);
+    if (next)
+        query_walk(q, group, next + 1, group_path);
+    else
+        query_add_match(q, tcs_index_refresh(&q->i_ctx->index, group), group_path);
+}
+
+/**
+ * Walks the groups matching the pattern, one path element at a time. Elements without wildcard
+ * are looked up in the group index
+ *
+ * @param [in] q       Query
+ * @param [in] node    Parent group node
+ * @param [in] pattern Remaining part of the pattern
+ * @param [in] path    Path of the parent group. Empty for the root
+ */
+static void query_walk(query_t *q, xmlNodePtr node, const char *pattern, const char *path)
+{
+    char element[64];
+    const char *next = strchr(pattern, GROUP_SEPARATOR);
+    size_t len = next ? (size_t)(next - pattern) : strlen(pattern);
+
+    if (len >= sizeof(element)) {
+        LOGE_RL("Pattern element too long (%s)", pattern);
+        return;
+    }
+    memcpy(element, pattern, len);
+    element[len] = '\0';
+
+    if (!strpbrk(element, "*?[")) {
+        const tcs_index_entry_t *entry = tcs_index_lookup(&q->i_ctx->index, node, TCS_TAG_GROUP,
+                                                          tcs_hash(element), element);
+        if (entry)
+            query_group(q, entry->node, element, next, path);
+        return;
+    }
+
+    /* in layered mode, groups added by the layers are matched too */
+    tcs_index_t *index = &q->i_ctx->index;
+    tcs_group_info_t *info = index->layered ? tcs_index_refresh(index, node) : NULL;
+    for (int i = -1; i < (info ? info->nb_layers : 0); i++) {
+        xmlNodePtr cur = next_node(((i < 0) ? node : info->layers[i])->children);
+        for (; cur; cur = next_node(cur)) {
+            if (xmlStrcmp(cur->name, TAG_GROUP))
+                continue;
+            const char *name = (const char *)tcs_peek_prop(cur, ATTR_NAME);
+            if (!name || fnmatch(element, name, 0))
+                continue;
+            if (i >= 0) {
+                /* group of the tree or of a previous layer */
+                const tcs_index_entry_t *entry = tcs_index_lookup(index, node, TCS_TAG_GROUP,
+                                                                  tcs_hash(name), name);
+                if (!entry || (entry->node != cur))
+                    continue;
+            }
+            query_group(q, cur, name, next, path);
+        }
+    }
+}
+
+/**
+ * Same as query_walk, in the frozen configuration
+ */
+static void query_walk_frozen(query_t *q, const tcs_group_t *group, const char *pattern,
+                              const char *path)
+{
+    char element[64];
+    const char *next = strchr(pattern, GROUP_SEPARATOR);
+    size_t len = next ? (size_t)(next - pattern) : strlen(pattern);
+
+    if (len >= sizeof(element)) {
+        LOGE_RL("Pattern element too long (%s)", pattern);
+        return;
+    }
+    memcpy(element, pattern, len);
+    element[len] = '\0';
+
+    bool wildcard = strpbrk(element, "*?[") != NULL;
+    for (unsigned int i = 0; i <= group->mask; i++) {
+        const tcs_index_entry_t *entry = &group->entries[i];
+        if (!entry->key || (entry->tag != TCS_TAG_GROUP) ||
+            (wildcard ? fnmatch(element, entry->key, 0) : strcmp(element, entry->key)))
+            continue;
+
+        char group_path[256];
+        snprintf(group_path, sizeof(group_path), "%s%s%s", path, *path ? "." : "", entry->key);
+        if (next)
+            query_walk_frozen(q, entry->group, next + 1, group_path);
+        else
+            query_add_match(q, entry->group, group_path);
+    }
+}
+
+/**
+ * Collects the groups matching a pattern where the key is found
+ */
+static void query_run(query_t *q, const char *pattern)
+{
+    tcs_internal_ctx_t *i_ctx = q->i_ctx;
+
+    ASSERT(pattern);
+    ASSERT(q->key);
+
+    q->hash = tcs_hash(q->key);
+
+    char path[256] = "";
+    if (*pattern == GROUP_SEPARATOR) {
+        if (!i_ctx->default_group_node && !i_ctx->default_group) {
+            LOGE_RL("Group (%s) not found. No default group provided", pattern);
+            return;
+        }
+        get_default_group_name(i_ctx, path, sizeof(path));
+        pattern++;
+    }
+
+    if (i_ctx->frozen) {
+        query_walk_frozen(q, *path ? i_ctx->default_group : i_ctx->frozen->root, pattern, path);
+    } else {
+        /* budget mode: the budget is met again once the matches are copied (@see query_free) */
+        q->reloaded = i_ctx->group_budget && !*path && reload_module_groups(i_ctx, pattern);
+        query_walk(q, *path ? i_ctx->default_group_node : i_ctx->root_node, pattern, path);
+    }
+}
+
+static void query_free(query_t *q)
+{
+    for (int i = 0; i < q->nb; i++)
+        free(q->matches[i].group);
+    free(q->matches);
+    if (q->reloaded)
+        evict_module_groups(q->i_ctx, "");
+}
+
+/**
+ * @see tcs.h
+ */
+static int query_int(tcs_ctx_t *ctx, const char *pattern, const char *key,
+                     tcs_int_match_t **matches)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+    query_t q = { .i_ctx = i_ctx, .tag = TCS_TAG_INT, .xml_tag = TAG_INT, .key = key };
+    int nb = 0;
+
+    STATS_START(start);
+
+    ASSERT(matches);
+
+    query_run(&q, pattern);
+    *matches = NULL;
+    if (q.nb) {
+        *matches = malloc(q.nb * sizeof(tcs_int_match_t) + q.strings_size);
+        ASSERT(*matches);
+        char *strings = (char *)(*matches + q.nb);
+        for (int i = 0; i < q.nb; i++) {
+            tcs_int_match_t *match = &(*matches)[nb];
+            if (to_int(q.matches[i].value, &match->value)) {
+                LOGE_RL("Conversion failure for key (%s) group (%s)", key, q.matches[i].group);
+                continue;
+            }
+            match->group = strings;
+            strings = stpcpy(strings, q.matches[i].group) + 1;
+            nb++;
+        }
+        if (!nb) {
+            free(*matches);
+            *matches = NULL;
+        }
+    }
+    query_free(&q);
+
+    STATS_STOP(&i_ctx->stats, TCS_API_QUERY, start, nb != 0);
+
+    return nb;
+}
+
+/**
+ * @see tcs.h
+ */
+static int query_string(tcs_ctx_t *ctx, const char *pattern, const char *key,
+                        tcs_string_match_t **matches)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+    query_t q = { .i_ctx = i_ctx, .tag = TCS_TAG_STRING, .xml_tag = TAG_STRING, .key = key };
+
+    STATS_START(start);
+
+    ASSERT(matches);
+
+    query_run(&q, pattern);
+    *matches = NULL;
+    if (q.nb) {
+        *matches = malloc(q.nb * sizeof(tcs_string_match_t) + q.strings_size);
+        ASSERT(*matches);
+        char *strings = (char *)(*matches + q.nb);
+        for (int i = 0; i < q.nb; i++) {
+            tcs_string_match_t *match = &(*matches)[i];
+            match->group = strings;
+            strings = stpcpy(strings, q.matches[i].group) + 1;
+            match->value = strings;
+            strings = stpcpy(strings, q.matches[i].value) + 1;
+        }
+    }
+    query_free(&q);
+
+    STATS_STOP(&i_ctx->stats, TCS_API_QUERY, start, q.nb != 0);
+
+    return q.nb;
+}
+
+static bool is_user_build(void)
+{
+    char build[PROPERTY_VALUE_MAX] = { "\0" };
+
+    property_get(TCS_KEY_ANDROID_BUILD, build, "");
+
+    return strcmp(build, "user") == 0;
+}
+
+static void get_config_from_sysfs(char *name, size_t len)
+{
+    ASSERT(name != NULL);
+    ASSERT(len > 0);
+
+    int fd = open(TCS_SYSFS_CONFIG_NAME, O_RDONLY);
+    DASSERT(fd >= 0, "Failed to open: %s. Reason: %s", TCS_SYSFS_CONFIG_NAME, strerror(errno));
+    size_t read_size = read(fd, name, len);
+    if ((close(fd) == 0) && (read_size > 0)) {
+        ASSERT(read_size != len);
+        name[read_size - 1] = '\0'; /* \n removal */
+    } else {
+        *name = '\0';
+    }
+}
+
+static int get_config_file(char *name, size_t len)
+{
+    int ret = 0;
+    char *type = NULL;
+
+    ASSERT(name != NULL);
+    ASSERT(len == PROPERTY_VALUE_MAX);
+
+    *name = '\0';
+    if (!is_user_build() && property_get(TCS_KEY_DBG_HW_FILENAME, name, "") > 0) {
+        type = "DEBUG";
+    } else if (property_get(TCS_KEY_HW_FILENAME, name, "") > 0) {
+        type = "ANDROID PROPERTY";
+    } else {
+        get_config_from_sysfs(name, PROPERTY_VALUE_MAX);
+        type = "SYSFS";
+    }
+
+    if (*name == '\0') {
+        LOGE("Platform not detected");
+        ret = -1;
+    } else {
+        LOGV("Platform (%s) set by (%s)", name, type);
+    }
+
+    return ret;
+}
+
+static char *get_overlay_folder(void)
+{
+#ifdef HOST_BUILD
+    char value[PROPERTY_VALUE_MAX];
+    property_get(TCS_KEY_DBG_HOST_OVERLAY_FOLDER, value, "");
+    char *folder = strdup(value);
+    ASSERT(folder);
+    return folder;
+#else /* HOST_BUILD */
+    char *path = NULL;
+    char *property = NULL;
+
+    char tmp[PROPERTY_VALUE_MAX] = { "\0" };
+
+    if (!is_user_build() && property_get(TCS_KEY_DBG_SW_FOLDER, tmp, "") > 0)
+        property = TCS_KEY_DBG_SW_FOLDER;
+    else if (property_get(TCS_KEY_SW_FOLDER, tmp, "") > 0)
+        property = TCS_KEY_SW_FOLDER;
+
+    if (property) {
+        size_t size = strlen(tmp) + strlen(TCS_OVERLAY_FOLDER) + 2;
+        path = malloc(sizeof(char) * size);
+        ASSERT(path);
+        snprintf(path, size, "%s/%s", TCS_OVERLAY_FOLDER, tmp);
+        LOGV("overlay folder: %s set by %s", path, property);
+    }
+
+    return path;
+#endif  /* HOST_BUILD */
+}
+
+static char *get_hw_config_folder()
+{
+    char *path = NULL;
+
+#ifdef HOST_BUILD
+    char value[PROPERTY_VALUE_MAX];
+    property_get(TCS_KEY_DBG_HOST_HW_FOLDER, value, "");
+    path = strdup(value);
+    ASSERT(path);
+#else /* HOST_BUILD */
+    path = strdup(TCS_XML_FOLDER);
+    ASSERT(path);
+#endif /* HOST_BUILD */
+
+    return path;
+}
+
+typedef struct file_list {
+    int nb;
+    char **paths;
+} file_list_t;
+
+static void file_list_add(file_list_t *list, const char *path)
+{
+    ASSERT(list);
+    ASSERT(path);
+
+    list->paths = realloc(list->paths, (list->nb + 1) * sizeof(char *));
+    ASSERT(list->paths);
+    list->paths[list->nb] = strdup(path);
+    ASSERT(list->paths[list->nb]);
+    list->nb++;
+}
+
+static void file_list_free(file_list_t *list)
+{
+    ASSERT(list);
+
+    for (int i = 0; i < list->nb; i++)
+        free(list->paths[i]);
+    free(list->paths);
+    list->paths = NULL;
+    list->nb = 0;
+}
+
+/*
+ * Overlay index
+ *
+ * An overlay folder is scanned, or its manifest loaded, once per context. The top-level group of
+ * each module overlay file is
+ * recorded when the file is parsed. If a file parsed for an instance touches another instance that
+ * is listed in the configuration but not added yet, its group is kept until that instance is
+ * added: each file is parsed at most once.
+ */
+
+typedef struct overlay_file {
+    char *path;
+    char *group;                   // Top-level group of the file. NULL until parsed
+    xmlDocPtr parked;              // Group of another instance, not applied yet. Can be NULL
+} overlay_file_t;
+
+typedef struct overlay_folder {
+    char *path;
+    int nb;
+    overlay_file_t *files;         // In apply order
+    tcs_manifest_t *manifest;      // Entries match files. NULL if missing or stale
+} overlay_folder_t;
+
+static overlay_folder_t *find_overlay_folder(tcs_internal_ctx_t *i_ctx, const char *path)
+{
+    ASSERT(i_ctx);
+    ASSERT(path);
+
+    for (int i = 0; i < i_ctx->nb_overlay_folders; i++)
+        if (!strcmp(i_ctx->overlay_folders[i].path, path))
+            return &i_ctx->overlay_folders[i];
+    return NULL;
+}
+
+static void free_overlay_files(overlay_folder_t *folder)
+{
+    ASSERT(folder);
+
+    for (int i = 0; i < folder->nb; i++) {
+        free(folder->files[i].path);
+        free(folder->files[i].group);
+        xmlFreeDoc(folder->files[i].parked);
+    }
+    free(folder->files);
+    folder->files = NULL;
+    folder->nb = 0;
+}
+
+static void set_overlay_files(overlay_folder_t *folder, const file_list_t *files)
+{
+    ASSERT(folder);
+    ASSERT(files);
+
+    folder->nb = files->nb;
+    folder->files = calloc(files->nb ? files->nb : 1, sizeof(overlay_file_t));
+    ASSERT(folder->files);
+    for (int i = 0; i < files->nb; i++) {
+        folder->files[i].path = strdup(files->paths[i]);
+        ASSERT(folder->files[i].path);
+    }
+}
+
+/**
+ * Lists the files of an overlay folder, in alphabetical order
+ */
+static void scan_overlay_folder(const char *folder, file_list_t *files)
+{
+    ASSERT(folder);
+    ASSERT(files);
+
+    struct dirent **list = NULL;
+    int nb = scandir(folder, &list, NULL, alphasort);
+    for (int i = 0; i < nb; i++) {
+        if (*list[i]->d_name != '.') {
+            char xml_file[256];
+            snprintf(xml_file, sizeof(xml_file), "%s/%s", folder, list[i]->d_name);
+            file_list_add(files, xml_file);
+        }
+        free(list[i]);
+    }
+    free(list);
+}
+
+/**
+ * Gives the index of an overlay folder. At the first call, the folder is listed by its manifest
+ * if it is valid, scanned otherwise
+ */
+static overlay_folder_t *index_overlay_folder(tcs_internal_ctx_t *i_ctx, const char *path)
+{
+    ASSERT(i_ctx);
+    ASSERT(path);
+
+    overlay_folder_t *folder = find_overlay_folder(i_ctx, path);
+    if (folder)
+        return folder;
+
+    i_ctx->overlay_folders = realloc(i_ctx->overlay_folders,
+                                     (i_ctx->nb_overlay_folders + 1) * sizeof(overlay_folder_t));
+    ASSERT(i_ctx->overlay_folders);
+    folder = &i_ctx->overlay_folders[i_ctx->nb_overlay_folders++];
+    folder->path = strdup(path);
+    ASSERT(folder->path);
+
+    file_list_t files = { 0 };
+    folder->manifest = tcs_manifest_load(path);
+    if (folder->manifest) {
+        for (int i = 0; i < folder->manifest->nb; i++) {
+            char xml_file[256];
+            snprintf(xml_file, sizeof(xml_file), "%s/%s", path, folder->manifest->entries[i].file);
+            file_list_add(&files, xml_file);
+        }
+    } else {
+        scan_overlay_folder(path, &files);
+    }
+    set_overlay_files(folder, &files);
+    file_list_free(&files);
+
+    return folder;
+}
+
+static overlay_file_t *find_overlay_file(tcs_internal_ctx_t *i_ctx, const char *xml_file)
+{
+    ASSERT(i_ctx);
+    ASSERT(xml_file);
+
+    for (int i = 0; i < i_ctx->nb_overlay_folders; i++) {
+        overlay_folder_t *folder = &i_ctx->overlay_folders[i];
+        for (int j = 0; j < folder->nb; j++)
+            if (!strcmp(folder->files[j].path, xml_file))
+                return &folder->files[j];
+    }
+    return NULL;
+}
+
+/**
+ * Records the top-level group of a module overlay file
+ */
+static void set_overlay_group(overlay_file_t *file, xmlNodePtr overlay_node)
+{
+    ASSERT(file);
+    ASSERT(overlay_node);
+
+    free(file->group);
+    file->group = NULL;
+    if (!xmlStrcmp(overlay_node->name, TAG_GROUP)) {
+        const xmlChar *name = tcs_peek_prop(overlay_node, ATTR_NAME);
+        file->group = name ? strdup((const char *)name) : NULL;
+    }
+}
+
+/**
+ * Keeps the group of a module overlay file touching another instance, if this instance is listed
+ * in the configuration and not added yet. The rest of the document is released by the caller
+ *
+ * @param [in] i_ctx Module context
+ * @param [in] file  Overlay file. Can be NULL
+ * @param [in] doc   Document of the file
+ *
+ * @return true if the group is kept
+ */
+static bool park_overlay_group(tcs_internal_ctx_t *i_ctx, overlay_file_t *file, xmlDocPtr doc)
+{
+    ASSERT(i_ctx);
+    ASSERT(doc);
+
+    if (!file || !file->group)
+        return false;
+
+    xmlNodePtr groups = next_node(i_ctx->root_node->children);
+    xmlNodePtr modules_node = search_group(groups, (const xmlChar *)"modules");
+    if (!modules_node ||
+        !search_property(next_node(modules_node->children), TAG_STRING,
+                         (const xmlChar *)file->group) ||
+        search_group(groups, (const xmlChar *)file->group))
+        return false;
+
+    /* the group is moved to a document sharing the dictionary: names are not copied */
+    xmlDocPtr parked = xmlNewDoc(doc->version);
+    ASSERT(parked);
+    if (doc->dict) {
+        parked->dict = doc->dict;
+        xmlDictReference(parked->dict);
+    }
+    xmlNodePtr node = xmlDocGetRootElement(doc);
+    xmlUnlinkNode(node);
+    xmlDocSetRootElement(parked, node);
+
+    xmlFreeDoc(file->parked);
+    file->parked = parked;
+
+    return true;
+}
+
+static void free_overlay_index(tcs_internal_ctx_t *i_ctx)
+{
+    ASSERT(i_ctx);
+
+    for (int i = 0; i < i_ctx->nb_overlay_folders; i++) {
+        overlay_folder_t *folder = &i_ctx->overlay_folders[i];
+        free_overlay_files(folder);
+        tcs_manifest_free(folder->manifest);
+        free(folder->path);
+    }
+    free(i_ctx->overlay_folders);
+    i_ctx->nb_overlay_folders = 0;
+    i_ctx->overlay_folders = NULL;
+}
+
+static void apply_overlay_file(tcs_internal_ctx_t *i_ctx, const char *xml_file,
+                               const char *group_name, bool config, tcs_prefetch_t *prefetch)
+{
+    ASSERT(i_ctx);
+    ASSERT(xml_file);
+    ASSERT(group_name);
+
+    unsigned long long start;
+    long long bytes = file_size(xml_file);
+    overlay_file_t *file = config ? NULL : find_overlay_file(i_ctx, xml_file);
+    xmlDocPtr doc = file ? file->parked : NULL;
+    if (doc) {
+        file->parked = NULL;
+    } else {
+        start = now_ns();
+        doc = tcs_xml_read(i_ctx->xml_parser, prefetch, xml_file);
+        DASSERT(doc != NULL, "xml file (%s) not parsed correctly (%s)", xml_file,
+                xmlGetLastError()->message);
+        timing_add(i_ctx, TCS_PHASE_OVERLAY_READ, start, xml_file, bytes);
+    }
+
+    xmlNodePtr overlay_node = xmlDocGetRootElement(doc);
+    xmlNodePtr dest_node = NULL;
+
+    if (!config) {
+        if (file)
+            set_overlay_group(file, overlay_node);
+        xmlNodePtr node = search_group(overlay_node, (xmlChar *)group_name);
+        if (!node) {
+            /* kept for the instance it touches */
+            park_overlay_group(i_ctx, file, doc);
+            xmlFreeDoc(doc);
+            return;
+        }
+        dest_node = search_group(i_ctx->root_node->children, (xmlChar *)group_name);
+        ASSERT(dest_node);
+    } else {
+        if (!xmlStrcmp(overlay_node->name, TAG_CONFIG))
+            dest_node = i_ctx->root_node;
+        else
+            LOGE("Tag (%s) not found in file (%s)", TAG_CONFIG, xml_file);
+    }
+
+    if (dest_node) {
+        LOGD("overlay file: %s", xml_file);
+        start = now_ns();
+        if (i_ctx->index.layered) {
+            /* the file is kept as is: it is resolved by the group indexes */
+            tcs_index_add_layer(&i_ctx->index, dest_node, overlay_node);
+            i_ctx->layer_docs = realloc(i_ctx->layer_docs,
+                                        (i_ctx->nb_layer_docs + 1) * sizeof(xmlDocPtr));
+            ASSERT(i_ctx->layer_docs);
+            i_ctx->layer_docs[i_ctx->nb_layer_docs++] = doc;
+            doc = NULL;
+        } else {
+            parse_overlay_group(overlay_node, dest_node);
+        }
+        timing_add(i_ctx, TCS_PHASE_OVERLAY_MERGE, start, xml_file, bytes);
+
+        if (!config) {
+            bump_generation(i_ctx, dest_node);
+        } else {
+            bump_generation(i_ctx, i_ctx->root_node);
+            /* update generation of all top-level groups touched by the overlay */
+            xmlNodePtr cur = next_node(overlay_node->children);
+            for (; cur; cur = next_node(cur)) {
+                if (xmlStrcmp(cur->name, TAG_GROUP))
+                    continue;
+                xmlChar *name = xmlGetProp(cur, ATTR_NAME);
+                ASSERT(name);
+                xmlNodePtr group_node = search_group(next_node(i_ctx->root_node->children),
+                                                     name);
+                /* groups added by a layer are not in the tree */
+                ASSERT(group_node || i_ctx->index.layered);
+                if (group_node)
+                    bump_generation(i_ctx, group_node);
+                xmlFree(name);
+            }
+        }
+    }
+    xmlFreeDoc(doc);
+}
+
+/**
+ * Lists the overlay files of a group, in the order they are applied
+ */
+static void list_overlay_files(tcs_internal_ctx_t *i_ctx, const char *group_name, bool config,
+                               file_list_t *files)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_name);
+    ASSERT(files);
+
+    if (!i_ctx->overlay_xml_folder)
+        return;
+
+    char *group = strdup(group_name);
+    ASSERT(group);
+    group = strsep(&group, "0123456789");
+
+    char folder[256];
+    snprintf(folder, sizeof(folder), "%s/%s", i_ctx->overlay_xml_folder, group);
+    free(group);
+
+    unsigned long long start = now_ns();
+    overlay_folder_t *indexed = index_overlay_folder(i_ctx, folder);
+    tcs_manifest_t *manifest = indexed->manifest;
+    if (manifest) {
+        /* Only files touching the group are opened */
+        bool valid = true;
+        for (int i = 0; valid && (i < manifest->nb); i++)
+            if (tcs_manifest_entry_match(&manifest->entries[i], group_name, config))
+                valid = tcs_manifest_entry_check(folder, &manifest->entries[i]);
+        if (valid) {
+            for (int i = 0; i < manifest->nb; i++)
+                if (tcs_manifest_entry_match(&manifest->entries[i], group_name, config))
+                    file_list_add(files, indexed->files[i].path);
+            timing_add(i_ctx, TCS_PHASE_OVERLAY_SCAN, start, NULL, 0);
+            return;
+        }
+
+        LOGD("manifest of folder (%s) is stale. Ignored", folder);
+        tcs_manifest_free(manifest);
+        indexed->manifest = NULL;
+        file_list_t scanned = { 0 };
+        scan_overlay_folder(folder, &scanned);
+        free_overlay_files(indexed);
+        set_overlay_files(indexed, &scanned);
+        file_list_free(&scanned);
+    }
+
+    /* Only files whose group is unknown or matches are applied */
+    for (int i = 0; i < indexed->nb; i++)
+        if (config || !indexed->files[i].group || !strcmp(indexed->files[i].group, group_name))
+            file_list_add(files, indexed->files[i].path);
+    timing_add(i_ctx, TCS_PHASE_OVERLAY_SCAN, start, NULL, 0);
+}
+
+/**
+ * Counts the instances of a module using the same XML file
+ *
+ * @param [in] modules_node Group listing the module instances
+ * @param [in] module       Module name (instance name without its number)
+ * @param [in] xml_name     XML file of the module
+ *
+ * @return the number of instances
+ */
+static int count_module_instances(xmlNodePtr modules_node, const char *module,
+                                  const xmlChar *xml_name)
+{
+    ASSERT(modules_node);
+    ASSERT(module);
+    ASSERT(xml_name);
+
+    int nb = 0;
+    size_t len = strlen(module);
+    for (xmlNodePtr cur = next_node(modules_node->children); cur; cur = next_node(cur)) {
+        const char *key = (const char *)tcs_peek_prop(cur, ATTR_KEY);
+        const xmlChar *content = tcs_peek_content(cur);
+        if (key && content && !strncmp(key, module, len) &&
+            (!key[len] || isdigit((unsigned char)key[len])) && !xmlStrcmp(content, xml_name))
+            nb++;
+    }
+
+    return nb;
+}
+
+/**
+ * Lists the overlays of a group and starts reading them together with the configuration or
+ * module file: parsing of this file overlaps the reads of the overlays
+ *
+ * @param [in]  i_ctx      Module context
+ * @param [in]  path       Path of the configuration or module file. Can be NULL
+ * @param [in]  group_name Group of the overlays
+ * @param [in]  config     true for the configuration overlays
+ * @param [out] overlays   Overlay files to apply
+ *
+ * @return the prefetched files
+ */
+static tcs_prefetch_t *prefetch_files(tcs_internal_ctx_t *i_ctx, const char *path,
+                                      const char *group_name, bool config, file_list_t *overlays)
+{
+    ASSERT(i_ctx);
+    ASSERT(overlays);
 
-    property_get(TCS_KEY_ANDROID_BUILD, build, "");
+    list_overlay_files(i_ctx, group_name, config, overlays);
 
-    return strcmp(build, "user") == 0;
+    tcs_prefetch_t *prefetch = tcs_prefetch_new();
+    if (path)
+        tcs_prefetch_add(prefetch, path);
+    for (int i = 0; i < overlays->nb; i++) {
+        overlay_file_t *file = config ? NULL : find_overlay_file(i_ctx, overlays->paths[i]);
+        if (!file || !file->parked)
+            tcs_prefetch_add(prefetch, overlays->paths[i]);
+    }
+
+    return prefetch;
 }
 
-static void get_config_from_sysfs(char *name, size_t len)
+static void parse_overlay(tcs_internal_ctx_t *i_ctx, const char *group_name, bool config,
+                          file_list_t *overlays, tcs_prefetch_t *prefetch)
 {
-    ASSERT(name != NULL);
-    ASSERT(len > 0);
+    ASSERT(i_ctx);
+    ASSERT(overlays);
 
-    int fd = open(TCS_SYSFS_CONFIG_NAME, O_RDONLY);
-    DASSERT(fd >= 0, "Failed to open: %s. Reason: %s", TCS_SYSFS_CONFIG_NAME, strerror(errno));
-    size_t read_size = read(fd, name, len);
-    if ((close(fd) == 0) && (read_size > 0)) {
-        ASSERT(read_size != len);
-        name[read_size - 1] = '\0'; /* \n removal */
-    } else {
-        *name = '\0';
+    for (int i = 0; i < overlays->nb; i++)
+        apply_overlay_file(i_ctx, overlays->paths[i], group_name, config, prefetch);
+    file_list_free(overlays);
+    tcs_prefetch_free(prefetch);
+}
+
+static xmlNodePtr priv_add_group(tcs_internal_ctx_t *i_ctx, const char *group_name,
+                                 bool print_group)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_name);
+
+    xmlNodePtr node = NULL;
+    if (i_ctx->bundle) {
+        /* Group already merged at build time. Parse its entry of the bundle */
+        long long bytes = 0;
+        unsigned long long start = now_ns();
+        xmlDocPtr doc = tcs_bundle_read(i_ctx->bundle, i_ctx->xml_parser, group_name, &bytes);
+        if (doc) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s:%s", tcs_bundle_get_path(i_ctx->bundle),
+                     group_name);
+            timing_add(i_ctx, TCS_PHASE_MODULE_READ, start, path, bytes);
+            node = xmlDocCopyNode(xmlDocGetRootElement(doc), i_ctx->doc, 1);
+            ASSERT(node);
+            ASSERT(xmlAddChild(i_ctx->root_node, node));
+            xmlFreeDoc(doc);
+        }
+    } else if (i_ctx->flat) {
+        /* Group already merged at build time. Copy it from the flattened file: it stays there
+         * to be added again once removed or evicted */
+        xmlNodePtr flat_node = next_node(i_ctx->root_node);
+        if (flat_node)
+            flat_node = search_group(flat_node, (xmlChar *)group_name);
+        if (flat_node) {
+            node = xmlDocCopyNode(flat_node, i_ctx->doc, 1);
+            ASSERT(node);
+            ASSERT(xmlAddChild(i_ctx->root_node, node));
+        }
+    }
+    if (node) {
+        LOGD("flattened group (%s)", group_name);
+        bump_generation(i_ctx, node);
+        if (print_group)
+            print_node(node, 0);
+        return node;
+    }
+
+    xmlNodePtr modules_node = search_group(next_node(i_ctx->root_node->children),
+                                           (xmlChar *)"modules");
+    DASSERT(modules_node, "Group (modules) not found");
+
+    /* get XML name */
+    xmlNodePtr group_node = search_property(next_node(modules_node->children), TAG_STRING,
+                                            (const xmlChar *)group_name);
+    DASSERT(group_node, "Group (%s) not found", group_name);
+    xmlChar *xml_name = xmlNodeGetContent(group_node);
+    ASSERT(xml_name);
+
+    char *module = strdup(group_name);
+    ASSERT(module);
+    module = strsep(&module, "0123456789");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s/%s", i_ctx->hw_xml_folder, module, xml_name);
+    bool shared = count_module_instances(modules_node, module, xml_name) > 1;
+    free(module);
+    xmlFree(xml_name);
+
+    /* Instances sharing a module file use the document parsed for the first one */
+    xmlDocPtr doc = shared ? tcs_doc_cache_find(i_ctx->module_docs, path) : NULL;
+    bool cached = doc != NULL;
+
+    file_list_t overlays = { 0 };
+    tcs_prefetch_t *prefetch = prefetch_files(i_ctx, cached ? NULL : path, group_name, false,
+                                              &overlays);
+
+    /* Add XML content */
+    LOGD("xml file (%s) for group (%s)%s", path, group_name, cached ? " already parsed" : "");
+    if (!cached) {
+        unsigned long long start = now_ns();
+        doc = tcs_xml_read(i_ctx->xml_parser, prefetch, path);
+        DASSERT(doc != NULL, "xml file (%s) not parsed correctly (%s)", path,
+                xmlGetLastError()->message);
+        timing_add(i_ctx, TCS_PHASE_MODULE_READ, start, path, file_size(path));
+    }
+
+    node = xmlDocGetRootElement(doc);
+    ASSERT(xmlStrcmp(node->name, TAG_GROUP) == 0);
+
+    xmlNodePtr new_node = xmlCopyNodeList(node);
+    ASSERT(new_node);
+    /* the group of a shared file is named after the instance */
+    if (xmlStrcmp(tcs_peek_prop(new_node, ATTR_NAME), (const xmlChar *)group_name))
+        ASSERT(xmlSetProp(new_node, ATTR_NAME, (const xmlChar *)group_name));
+    ASSERT(xmlAddChildList(i_ctx->root_node, new_node));
+
+    if (!shared) {
+        xmlFreeDoc(doc);
+    } else if (!cached) {
+        if (!i_ctx->module_docs)
+            i_ctx->module_docs = tcs_doc_cache_new();
+        tcs_doc_cache_add(i_ctx->module_docs, path, doc);
+    }
+
+    node = search_group(i_ctx->root_node->children, (xmlChar *)group_name);
+    ASSERT(node);
+    bump_generation(i_ctx, node);
+
+    parse_overlay(i_ctx, group_name, false, &overlays, prefetch);
+    if (print_group)
+        print_node(node, 0);
+
+    return node;
+}
+
+/**
+ * Removes a group added by add_group from the tree, with its indexes and its overlay layers
+ *
+ * @return 0 if successful
+ */
+static int priv_remove_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_name);
+
+    xmlNodePtr modules_node = search_group(next_node(i_ctx->root_node->children),
+                                           (xmlChar *)"modules");
+    xmlNodePtr node = search_group(next_node(i_ctx->root_node->children),
+                                   (const xmlChar *)group_name);
+    if (!node || !modules_node ||
+        !search_property(next_node(modules_node->children), TAG_STRING,
+                         (const xmlChar *)group_name)) {
+        LOGE("Group (%s) not added. Not removed", group_name);
+        return -1;
+    }
+    if (node == i_ctx->default_group_node) {
+        LOGE("Group (%s) provided at init. Not removed", group_name);
+        return -1;
+    }
+
+    /* layered mode: overlay files applied on the group go with it */
+    int nb_docs = 0;
+    xmlDocPtr *docs = NULL;
+    tcs_group_info_t *info = node->_private;
+    for (int i = 0; info && (i < info->nb_own_layers); i++) {
+        for (int j = 0; j < i_ctx->nb_layer_docs; j++) {
+            if (xmlDocGetRootElement(i_ctx->layer_docs[j]) == info->own_layers[i]) {
+                docs = realloc(docs, (nb_docs + 1) * sizeof(xmlDocPtr));
+                ASSERT(docs);
+                docs[nb_docs++] = i_ctx->layer_docs[j];
+                i_ctx->layer_docs[j] = i_ctx->layer_docs[--i_ctx->nb_layer_docs];
+                break;
+            }
+        }
+    }
+
+    for (xmlNodePtr cur = i_ctx->select_group_node; cur; cur = cur->parent) {
+        if (cur == node) {
+            i_ctx->select_group_node = NULL;
+            break;
+        }
     }
+
+    tcs_index_release(&i_ctx->index, node);
+    xmlUnlinkNode(node);
+    xmlFreeNode(node);
+    for (int i = 0; i < nb_docs; i++)
+        xmlFreeDoc(docs[i]);
+    free(docs);
+    bump_generation(i_ctx, i_ctx->root_node);
+    LOGD("group (%s) removed", group_name);
+
+    return 0;
 }
 
-static int get_config_file(char *name, size_t len)
+static module_group_t *find_module_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
 {
-    int ret = 0;
-    char *type = NULL;
+    ASSERT(i_ctx);
+    ASSERT(group_name);
 
-    ASSERT(name != NULL);
-    ASSERT(len == PROPERTY_VALUE_MAX);
+    for (int i = 0; i < i_ctx->nb_module_groups; i++)
+        if (!strcmp(i_ctx->module_groups[i].name, group_name))
+            return &i_ctx->module_groups[i];
+    return NULL;
+}
 
-    *name = '\0';
-    if (!is_user_build() && property_get(TCS_KEY_DBG_HW_FILENAME, name, "") > 0) {
-        type = "DEBUG";
-    } else if (property_get(TCS_KEY_HW_FILENAME, name, "") > 0) {
-        type = "ANDROID PROPERTY";
+/**
+ * Budget mode: records that a group is used. Its use count is updated
+ */
+static void track_module_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_name);
+
+    module_group_t *group = find_module_group(i_ctx, group_name);
+    if (!group) {
+        i_ctx->module_groups = realloc(i_ctx->module_groups,
+                                       (i_ctx->nb_module_groups + 1) * sizeof(module_group_t));
+        ASSERT(i_ctx->module_groups);
+        group = &i_ctx->module_groups[i_ctx->nb_module_groups++];
+        group->name = strdup(group_name);
+        ASSERT(group->name);
+    }
+    group->last_use = ++i_ctx->use_count;
+    group->evicted = false;
+}
+
+static void untrack_module_group(tcs_internal_ctx_t *i_ctx, const char *group_name)
+{
+    ASSERT(i_ctx);
+
+    module_group_t *group = find_module_group(i_ctx, group_name);
+    if (group) {
+        free(group->name);
+        *group = i_ctx->module_groups[--i_ctx->nb_module_groups];
+    }
+}
+
+static void free_module_groups(tcs_internal_ctx_t *i_ctx)
+{
+    ASSERT(i_ctx);
+
+    for (int i = 0; i < i_ctx->nb_module_groups; i++)
+        free(i_ctx->module_groups[i].name);
+    free(i_ctx->module_groups);
+    i_ctx->module_groups = NULL;
+    i_ctx->nb_module_groups = 0;
+}
+
+/**
+ * Budget mode: evicts the least recently used groups until the budget is met. The group being
+ * used, the selected group and groups with open handles are kept
+ */
+static void evict_module_groups(tcs_internal_ctx_t *i_ctx, const char *keep)
+{
+    ASSERT(i_ctx);
+    ASSERT(keep);
+
+    for (;;) {
+        int nb_loaded = 0;
+        module_group_t *lru = NULL;
+        xmlNodePtr lru_node = NULL;
+        for (int i = 0; i < i_ctx->nb_module_groups; i++) {
+            module_group_t *group = &i_ctx->module_groups[i];
+            if (group->evicted)
+                continue;
+            nb_loaded++;
+
+            xmlNodePtr node = search_group(next_node(i_ctx->root_node->children),
+                                           (const xmlChar *)group->name);
+            bool selected = false;
+            for (xmlNodePtr cur = i_ctx->select_group_node; node && cur; cur = cur->parent)
+                selected |= cur == node;
+            if (node && !selected && strcmp(group->name, keep) &&
+                (node != i_ctx->default_group_node) &&
+                !tcs_index_is_open(&i_ctx->index, node) &&
+                (!lru || (group->last_use < lru->last_use))) {
+                lru = group;
+                lru_node = node;
+            }
+        }
+        if (nb_loaded <= i_ctx->group_budget)
+            return;
+        if (!lru) {
+            LOGD("%d groups loaded. None can be evicted", nb_loaded);
+            return;
+        }
+
+        LOGD("group (%s) evicted", lru->name);
+        lru->generation = tcs_group_info_get(&i_ctx->index, lru_node)->generation;
+        if (priv_remove_group(i_ctx, lru->name))
+            untrack_module_group(i_ctx, lru->name);
+        else
+            lru->evicted = true;
+    }
+}
+
+/**
+ * Budget mode: reloads the top-level group of a path if it has been evicted
+ */
+static void use_module_group(tcs_internal_ctx_t *i_ctx, const char *group_path)
+{
+    ASSERT(i_ctx);
+    ASSERT(group_path);
+
+    if (*group_path == GROUP_SEPARATOR)
+        return;
+
+    char name[40];
+    get_path_element(group_path, name, sizeof(name));
+    module_group_t *group = find_module_group(i_ctx, name);
+    if (!group)
+        return;
+
+    if (group->evicted) {
+        LOGD("group (%s) reloaded", name);
+        priv_add_group(i_ctx, name, false);
+    }
+    track_module_group(i_ctx, name);
+    evict_module_groups(i_ctx, name);
+}
+
+/**
+ * Budget mode: reloads the evicted groups matched by the first element of a pattern
+ *
+ * @param [in] i_ctx   Module context
+ * @param [in] pattern Pattern of a query, or NULL to reload all evicted groups
+ *
+ * @return true if a group has been reloaded
+ */
+static bool reload_module_groups(tcs_internal_ctx_t *i_ctx, const char *pattern)
+{
+    ASSERT(i_ctx);
+
+    char element[64] = "*";
+    if (pattern) {
+        const char *next = strchr(pattern, GROUP_SEPARATOR);
+        size_t len = next ? (size_t)(next - pattern) : strlen(pattern);
+        if (len >= sizeof(element))
+            return false;
+        memcpy(element, pattern, len);
+        element[len] = '\0';
+    }
+
+    bool reloaded = false;
+    for (int i = 0; i < i_ctx->nb_module_groups; i++) {
+        module_group_t *group = &i_ctx->module_groups[i];
+        if (!group->evicted || fnmatch(element, group->name, 0))
+            continue;
+        LOGD("group (%s) reloaded", group->name);
+        priv_add_group(i_ctx, group->name, false);
+        track_module_group(i_ctx, group->name);
+        reloaded = true;
+    }
+
+    return reloaded;
+}
+
+/**
+ * @see tcs.h
+ */
+static void add_group(tcs_ctx_t *ctx, const char *group_name, bool print_group)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+
+    STATS_START(start);
+    if (i_ctx->frozen) {
+        LOGE("Configuration is frozen. Group (%s) not added", group_name);
     } else {
-        get_config_from_sysfs(name, PROPERTY_VALUE_MAX);
-        type = "SYSFS";
+        priv_add_group(i_ctx, group_name, print_group);
+        if (i_ctx->group_budget) {
+            track_module_group(i_ctx, group_name);
+            evict_module_groups(i_ctx, group_name);
+        }
     }
+    STATS_STOP(&i_ctx->stats, TCS_API_ADD_GROUP, start, !i_ctx->frozen);
+}
 
-    if (*name == '\0') {
-        LOGE("Platform not detected");
-        ret = -1;
+/**
+ * @see tcs.h
+ */
+static int remove_group(tcs_ctx_t *ctx, const char *group_name)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+
+    ASSERT(i_ctx);
+    ASSERT(group_name);
+
+    if (i_ctx->frozen) {
+        LOGE("Configuration is frozen. Group (%s) not removed", group_name);
+        return -1;
+    }
+
+    module_group_t *group = find_module_group(i_ctx, group_name);
+    int ret = (group && group->evicted) ? 0 : priv_remove_group(i_ctx, group_name);
+    if (!ret)
+        untrack_module_group(i_ctx, group_name);
+
+    return ret;
+}
+
+/**
+ * Loads the flattened configuration file generated at build time by tcs2_flatten, if any. This
+ * file contains the configuration and all module groups, already merged with their overlays.
+ *
+ * @return true if the flattened configuration is used
+ */
+static bool parse_flat_config(tcs_internal_ctx_t *i_ctx, const char *hw_name)
+{
+    ASSERT(i_ctx);
+    ASSERT(hw_name);
+
+    char value[PROPERTY_VALUE_MAX];
+    if (!is_user_build() && (property_get(TCS_KEY_DBG_DISABLE_FLAT, value, "") > 0) &&
+        !strcmp(value, "true"))
+        return false;
+
+    const char *sw_folder = TCS_FLAT_DEFAULT_SW_FOLDER;
+    if (i_ctx->overlay_xml_folder && (*i_ctx->overlay_xml_folder != '\0')) {
+        sw_folder = strrchr(i_ctx->overlay_xml_folder, '/');
+        sw_folder = sw_folder ? sw_folder + 1 : i_ctx->overlay_xml_folder;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/" TCS_FLAT_FOLDER "/%s/TCS2_%s" TCS_BUNDLE_SUFFIX,
+             i_ctx->hw_xml_folder, sw_folder, hw_name);
+    unsigned long long start = now_ns();
+    i_ctx->bundle = tcs_bundle_open(path);
+    if (i_ctx->bundle) {
+        long long bytes = 0;
+        i_ctx->doc = tcs_bundle_read(i_ctx->bundle, i_ctx->xml_parser, TCS_BUNDLE_CONFIG, &bytes);
+        DASSERT(i_ctx->doc != NULL, "entry (%s) not found in bundle (%s)", TCS_BUNDLE_CONFIG,
+                path);
+        timing_add(i_ctx, TCS_PHASE_CONFIG_READ, start, path, bytes);
+
+        i_ctx->root_node = xmlDocGetRootElement(i_ctx->doc);
     } else {
-        LOGV("Platform (%s) set by (%s)", name, type);
+        snprintf(path, sizeof(path), "%s/" TCS_FLAT_FOLDER "/%s/TCS2_%s.xml",
+                 i_ctx->hw_xml_folder, sw_folder, hw_name);
+        if (access(path, R_OK))
+            return false;
+
+        LOGD("flattened configuration file: %s", path);
+        start = now_ns();
+        i_ctx->doc = tcs_xml_read(i_ctx->xml_parser, NULL, path);
+        DASSERT(i_ctx->doc != NULL, "xml file (%s) not parsed correctly (%s)", path,
+                xmlGetLastError()->message);
+        timing_add(i_ctx, TCS_PHASE_CONFIG_READ, start, path, file_size(path));
+
+        xmlNodePtr root = xmlDocGetRootElement(i_ctx->doc);
+        ASSERT(xmlStrcmp(root->name, TAG_FLAT) == 0);
+        i_ctx->root_node = next_node(root->children);
+    }
+    ASSERT(i_ctx->root_node);
+    ASSERT(xmlStrcmp(i_ctx->root_node->name, TAG_CONFIG) == 0);
+    i_ctx->flat = true;
+
+    xmlNodePtr node = next_node(i_ctx->root_node->children);
+    for (; node; node = next_node(node))
+        if (!xmlStrcmp(node->name, TAG_GROUP))
+            bump_generation(i_ctx, node);
+
+    return true;
+}
+
+static void get_process_name(char *name, size_t len)
+{
+    ASSERT(name);
+    ASSERT(len > 0);
+
+    *name = '\0';
+    int fd = open("/proc/self/comm", O_RDONLY);
+    if (fd >= 0) {
+        ssize_t size = read(fd, name, len - 1);
+        name[size > 0 ? size : 0] = '\0';
+        name[strcspn(name, "\n")] = '\0';
+        close(fd);
+    }
+    if (*name == '\0')
+        snprintf(name, len, "unknown");
+}
+
+/**
+ * Loads the access profile of the process, shipped in the hw folder, and starts recording a new
+ * one if requested. Nothing is opened unless one of the profile properties is set
+ */
+static void init_profile(tcs_internal_ctx_t *i_ctx)
+{
+    ASSERT(i_ctx);
+
+    char value[PROPERTY_VALUE_MAX];
+    char folder[PROPERTY_VALUE_MAX];
+    property_get(TCS_KEY_PROFILE, value, "");
+    bool load = !strcmp(value, "true");
+    bool record = !is_user_build() && (property_get(TCS_KEY_DBG_PROFILE_RECORD, folder, "") > 0);
+    if (!load && !record)
+        return;
+
+    char name[32];
+    char path[256];
+    get_process_name(name, sizeof(name));
+
+    if (load) {
+        snprintf(path, sizeof(path), "%s/" TCS_PROFILE_FOLDER "/%s" TCS_PROFILE_EXTENSION,
+                 i_ctx->hw_xml_folder, name);
+        i_ctx->profile = tcs_profile_load(path);
+    }
+
+    if (record) {
+        snprintf(path, sizeof(path), "%s/%s" TCS_PROFILE_EXTENSION, folder, name);
+        i_ctx->record_path = strdup(path);
+        ASSERT(i_ctx->record_path);
+        i_ctx->record = tcs_profile_new();
+        LOGD("recording access profile: %s", path);
+    }
+}
+
+static int parse_config(tcs_internal_ctx_t *i_ctx)
+{
+    ASSERT(i_ctx);
+
+    char xml_file[PROPERTY_VALUE_MAX];
+
+    unsigned long long start = now_ns();
+    int ret = get_config_file(xml_file, sizeof(xml_file));
+    timing_add(i_ctx, TCS_PHASE_PLATFORM, start, NULL, 0);
+    if (!ret && !parse_flat_config(i_ctx, xml_file)) {
+        char path[256];
+        /* @TODO: XML files are TCS2_ prefixed because we cannot export two different XML files
+         * with the same name. Remove this HACK once TCS is merged. Or maybe find another solution ?
+         **/
+        snprintf(path, sizeof(path), "%s/config/TCS2_%s.xml", i_ctx->hw_xml_folder, xml_file);
+
+        file_list_t overlays = { 0 };
+        tcs_prefetch_t *prefetch = prefetch_files(i_ctx, path, "config", true, &overlays);
+
+        LOGD("configuration file: %s", path);
+        start = now_ns();
+        i_ctx->doc = tcs_xml_read(i_ctx->xml_parser, prefetch, path);
+        DASSERT(i_ctx->doc != NULL, "xml file (%s) not parsed correctly (%s)", path,
+                xmlGetLastError()->message);
+        timing_add(i_ctx, TCS_PHASE_CONFIG_READ, start, path, file_size(path));
+
+        i_ctx->root_node = xmlDocGetRootElement(i_ctx->doc);
+        ASSERT(xmlStrcmp(i_ctx->root_node->name, TAG_CONFIG) == 0);
+
+        xmlNodePtr node = next_node(i_ctx->root_node->children);
+        for (; node; node = next_node(node))
+            if (!xmlStrcmp(node->name, TAG_GROUP))
+                bump_generation(i_ctx, node);
+
+        parse_overlay(i_ctx, "config", true, &overlays, prefetch);
     }
 
     return ret;
 }
 
-static char *get_overlay_folder(void)
+/**
+ * Writes a flattened configuration file: configuration and all module groups listed in the
+ * "modules" group, merged with their overlays. Used by host tools.
+ *
+ * @param [in] ctx  Module context, initialized without optional group
+ * @param [in] path Path of the file to write
+ *
+ * @return 0 if successful
+ */
+int tcs_flat_write(tcs_ctx_t *ctx, const char *path)
 {
-#ifdef HOST_BUILD
-    char value[PROPERTY_VALUE_MAX];
-    property_get(TCS_KEY_DBG_HOST_OVERLAY_FOLDER, value, "");
-    char *folder = strdup(value);
-    ASSERT(folder);
-    return folder;
-#else /* HOST_BUILD */
-    char *path = NULL;
-    char *property = NULL;
-
-    char tmp[PROPERTY_VALUE_MAX] = { "\0" };
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
 
-    if (!is_user_build() && property_get(TCS_KEY_DBG_SW_FOLDER, tmp, "") > 0)
-        property = TCS_KEY_DBG_SW_FOLDER;
-    else if (property_get(TCS_KEY_SW_FOLDER, tmp, "") > 0)
-        property = TCS_KEY_SW_FOLDER;
+    ASSERT(i_ctx);
+    ASSERT(path);
+    ASSERT(!i_ctx->flat);
 
-    if (property) {
-        size_t size = strlen(tmp) + strlen(TCS_OVERLAY_FOLDER) + 2;
-        path = malloc(sizeof(char) * size);
-        ASSERT(path);
-        snprintf(path, size, "%s/%s", TCS_OVERLAY_FOLDER, tmp);
-        LOGV("overlay folder: %s set by %s", path, property);
+    if (i_ctx->index.layered) {
+        LOGE("Overlays are not merged in layered mode (%s)", TCS_KEY_LAYERED_OVERLAYS);
+        return -1;
     }
 
-    return path;
-#endif  /* HOST_BUILD */
-}
+    xmlDocPtr doc = xmlNewDoc((const xmlChar *)"1.0");
+    ASSERT(doc);
+    xmlNodePtr root = xmlNewDocNode(doc, NULL, TAG_FLAT, NULL);
+    ASSERT(root);
+    xmlDocSetRootElement(doc, root);
 
-static char *get_hw_config_folder()
-{
-    char *path = NULL;
+    /* configuration must be copied before adding module groups to it */
+    ASSERT(xmlAddChild(root, xmlDocCopyNode(i_ctx->root_node, doc, 1)));
 
-#ifdef HOST_BUILD
-    char value[PROPERTY_VALUE_MAX];
-    property_get(TCS_KEY_DBG_HOST_HW_FOLDER, value, "");
-    path = strdup(value);
-    ASSERT(path);
-#else /* HOST_BUILD */
-    path = strdup(TCS_XML_FOLDER);
-    ASSERT(path);
-#endif /* HOST_BUILD */
+    xmlNodePtr node = search_group(next_node(i_ctx->root_node->children), (xmlChar *)"modules");
+    DASSERT(node, "Group (modules) not found");
+    for (node = next_node(node->children); node; node = next_node(node)) {
+        if (xmlStrcmp(node->name, TAG_STRING))
+            continue;
+        xmlChar *group_name = xmlGetProp(node, ATTR_KEY);
+        ASSERT(group_name);
+        xmlNodePtr group_node = priv_add_group(i_ctx, (const char *)group_name, false);
+        ASSERT(xmlAddChild(root, xmlDocCopyNode(group_node, doc, 1)));
+        xmlFree(group_name);
+    }
 
-    return path;
+    int ret = xmlSaveFormatFileEnc(path, doc, "UTF-8", 1) < 0 ? -1 : 0;
+    if (ret)
+        LOGE("Failed to write file (%s)", path);
+    xmlFreeDoc(doc);
+
+    return ret;
 }
 
-static void parse_overlay(tcs_internal_ctx_t *i_ctx, const char *group_name, bool config)
+/**
+ * Writes a flattened configuration bundle: same content as tcs_flat_write, with one entry for the
+ * configuration and one entry per module group. Used by host tools.
+ *
+ * @param [in] ctx      Module context, initialized without optional group
+ * @param [in] path     Path of the bundle to write
+ * @param [in] compress Entries are compressed if true
+ *
+ * @return 0 if successful
+ */
+int tcs_flat_write_bundle(tcs_ctx_t *ctx, const char *path, bool compress)
 {
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+
     ASSERT(i_ctx);
-    ASSERT(group_name);
+    ASSERT(path);
+    ASSERT(!i_ctx->flat);
 
-    if (!i_ctx->overlay_xml_folder)
-        return;
+    if (i_ctx->index.layered) {
+        LOGE("Overlays are not merged in layered mode (%s)", TCS_KEY_LAYERED_OVERLAYS);
+        return -1;
+    }
 
-    char *group = strdup(group_name);
-    ASSERT(group);
-    group = strsep(&group, "0123456789");
+    tcs_bundle_writer_t *writer = tcs_bundle_writer_new(compress);
 
-    char folder[256];
-    snprintf(folder, sizeof(folder), "%s/%s", i_ctx->overlay_xml_folder, group);
-    free(group);
+    /* configuration must be written before adding module groups to it */
+    tcs_bundle_writer_add(writer, TCS_BUNDLE_CONFIG, i_ctx->root_node);
 
-    struct dirent **list = NULL;
-    int nb = scandir(folder, &list, NULL, alphasort);
-    for (int i = 0; i < nb; i++) {
-        if (*list[i]->d_name == '.') {
-            free(list[i]);
+    xmlNodePtr node = search_group(next_node(i_ctx->root_node->children), (xmlChar *)"modules");
+    DASSERT(node, "Group (modules) not found");
+    for (node = next_node(node->children); node; node = next_node(node)) {
+        if (xmlStrcmp(node->name, TAG_STRING))
             continue;
-        }
+        xmlChar *group_name = xmlGetProp(node, ATTR_KEY);
+        ASSERT(group_name);
+        xmlNodePtr group_node = priv_add_group(i_ctx, (const char *)group_name, false);
+        tcs_bundle_writer_add(writer, (const char *)group_name, group_node);
+        xmlFree(group_name);
+    }
 
-        char xml_file[256];
-        snprintf(xml_file, sizeof(xml_file), "%s/%s", folder, list[i]->d_name);
-        free(list[i]);
+    return tcs_bundle_writer_save(writer, path);
+}
 
-        xmlDocPtr doc = xmlReadFile(xml_file, NULL, XML_PARSE_NOENT);
-        DASSERT(doc != NULL, "xml file (%s) not parsed correctly (%s)", xml_file,
-                xmlGetLastError()->message);
+/**
+ * @see tcs.h
+ */
+static unsigned int get_generation(tcs_ctx_t *ctx, const char *group_name)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+    xmlNodePtr node = NULL;
 
-        xmlNodePtr overlay_node = xmlDocGetRootElement(doc);
-        xmlNodePtr dest_node = NULL;
+    ASSERT(i_ctx);
 
-        if (!config) {
-            xmlNodePtr node = search_group(overlay_node, (xmlChar *)group_name);
-            if (node) {
-                dest_node = search_group(i_ctx->root_node->children, (xmlChar *)group_name);
-                ASSERT(dest_node);
-            }
-        } else {
-            if (!xmlStrcmp(overlay_node->name, TAG_CONFIG))
-                dest_node = i_ctx->root_node;
-            else
-                LOGE("Tag (%s) not found in file (%s)", TAG_CONFIG, xml_file);
-        }
+    if (!group_name)
+        return i_ctx->index.generation;
 
-        if (dest_node) {
-            LOGD("overlay file: %s", xml_file);
-            parse_overlay_group(overlay_node, dest_node);
+    if (i_ctx->frozen) {
+        const tcs_group_t *group = i_ctx->default_group;
+        if ((group_name[0] != GROUP_SEPARATOR) || (group_name[1] != '\0')) {
+            const tcs_index_entry_t *entry = tcs_index_find(i_ctx->frozen->root, TCS_TAG_GROUP,
+                                                            tcs_hash(group_name), group_name);
+            group = entry ? entry->group : NULL;
         }
-        xmlFreeDoc(doc);
+        return group ? group->generation : 0;
     }
-    free(list);
-}
 
-static xmlNodePtr priv_add_group(tcs_internal_ctx_t *i_ctx, const char *group_name,
-                                 bool print_group)
-{
-    ASSERT(i_ctx);
-    ASSERT(group_name);
-
-    xmlNodePtr group_node = search_group(next_node(i_ctx->root_node->children),
-                                         (xmlChar *)"modules");
-    DASSERT(group_node, "Group (modules) not found");
-
-    /* get XML name */
-    group_node = search_property(next_node(group_node->children), TAG_STRING,
-                                 (const xmlChar *)group_name);
-    DASSERT(group_node, "Group (%s) not found", group_name);
-    xmlChar *xml_name = xmlNodeGetContent(group_node);
-    ASSERT(xml_name);
+    if ((group_name[0] == GROUP_SEPARATOR) && (group_name[1] == '\0')) {
+        node = i_ctx->default_group_node;
+    } else {
+        /* the root index is only rebuilt when the configuration changes */
+        const tcs_index_entry_t *entry = tcs_index_lookup(&i_ctx->index, i_ctx->root_node,
+                                                          TCS_TAG_GROUP, tcs_hash(group_name),
+                                                          group_name);
+        node = entry ? entry->node : NULL;
+    }
 
-    char *module = strdup(group_name);
-    ASSERT(module);
-    module = strsep(&module, "0123456789");
-    char path[256];
-    snprintf(path, sizeof(path), "%s/%s/%s", i_ctx->hw_xml_folder, module, xml_name);
-    free(module);
-    xmlFree(xml_name);
+    if (!node && i_ctx->group_budget) {
+        /* evicted groups are still available: the generation they had is kept */
+        const module_group_t *group = find_module_group(i_ctx, group_name);
+        if (group && group->evicted)
+            return group->generation;
+    }
 
-    /* Add XML content */
-    LOGD("xml file (%s) for group (%s)", path, group_name);
-    xmlDocPtr doc = xmlReadFile(path, NULL, XML_PARSE_NOENT);
-    DASSERT(doc != NULL, "xml file (%s) not parsed correctly (%s)", path,
-            xmlGetLastError()->message);
+    return (node && node->_private) ? ((tcs_group_info_t *)node->_private)->generation : 0;
+}
 
-    xmlNodePtr node = xmlDocGetRootElement(doc);
-    ASSERT(xmlStrcmp(node->name, TAG_GROUP) == 0);
+/**
+ * @see tcs.h
+ */
+static int freeze(tcs_ctx_t *ctx)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
 
-    xmlNodePtr new_node = xmlCopyNodeList(node);
-    ASSERT(new_node);
-    ASSERT(xmlAddChildList(i_ctx->root_node, new_node));
+    ASSERT(i_ctx);
 
-    xmlFreeDoc(doc);
+    if (i_ctx->frozen)
+        return 0;
+
+    /* evicted groups are part of the frozen configuration */
+    if (i_ctx->group_budget)
+        reload_module_groups(i_ctx, NULL);
+
+    char name[128] = "";
+    if (i_ctx->default_group_node)
+        get_default_group_name(i_ctx, name, sizeof(name));
+
+    /* hot groups of the profile are copied first, in first access order */
+    xmlNodePtr *hot = NULL;
+    int nb_hot = 0;
+    if (i_ctx->profile) {
+        hot = malloc(i_ctx->profile->nb * sizeof(xmlNodePtr));
+        ASSERT(hot);
+        for (int i = 0; i < i_ctx->profile->nb; i++) {
+            xmlNodePtr node = lookup_group(i_ctx, i_ctx->root_node,
+                                           i_ctx->profile->entries[i].group);
+            if (node)
+                hot[nb_hot++] = node;
+        }
+    }
 
-    parse_overlay(i_ctx, group_name, false);
+    tcs_frozen_t *frozen = tcs_index_freeze(&i_ctx->index, i_ctx->root_node, hot, nb_hot);
+    free(hot);
+    if (!frozen)
+        return -1;
+    i_ctx->frozen = frozen;
+    i_ctx->shared = calloc(1, sizeof(shared_config_t));
+    ASSERT(i_ctx->shared);
+    i_ctx->shared->refs = 1;
+    i_ctx->shared->frozen = frozen;
+
+    if (*name) {
+        const tcs_index_entry_t *entry = tcs_index_find(frozen->root, TCS_TAG_GROUP,
+                                                        tcs_hash(name), name);
+        ASSERT(entry);
+        i_ctx->default_group = entry->group;
+    }
+    if (i_ctx->select_group_node) {
+        /* not recorded again */
+        tcs_profile_t *record = i_ctx->record;
+        i_ctx->record = NULL;
+        i_ctx->select_group = resolve_frozen_group(i_ctx, i_ctx->select_group_name);
+        i_ctx->record = record;
+    }
 
-    node = search_group(i_ctx->root_node->children, (xmlChar *)group_name);
-    ASSERT(node);
-    if (print_group)
-        print_node(node, 0);
+    /* the tree and everything pointing to it is released */
+    tcs_index_free(&i_ctx->index);
+    xmlFreeDoc(i_ctx->doc);
+    for (int i = 0; i < i_ctx->nb_layer_docs; i++)
+        xmlFreeDoc(i_ctx->layer_docs[i]);
+    free(i_ctx->layer_docs);
+    tcs_bundle_close(i_ctx->bundle);
+    tcs_doc_cache_free(i_ctx->module_docs);
+    free_overlay_index(i_ctx);
+    free_module_groups(i_ctx);
+    tcs_profile_free(i_ctx->profile);
+    free(i_ctx->select_group_name);
+    i_ctx->doc = NULL;
+    i_ctx->root_node = NULL;
+    i_ctx->select_group_node = NULL;
+    i_ctx->default_group_node = NULL;
+    i_ctx->nb_layer_docs = 0;
+    i_ctx->layer_docs = NULL;
+    i_ctx->bundle = NULL;
+    i_ctx->module_docs = NULL;
+    i_ctx->profile = NULL;
+    i_ctx->select_group_name = NULL;
 
-    return node;
+    return 0;
 }
 
 /**
  * @see tcs.h
  */
-static void add_group(tcs_ctx_t *ctx, const char *group_name, bool print_group)
+static const tcs_timing_report_t *get_timing_report(tcs_ctx_t *ctx)
 {
-    priv_add_group((tcs_internal_ctx_t *)ctx, group_name, print_group);
-}
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
 
-static int parse_config(tcs_internal_ctx_t *i_ctx)
-{
     ASSERT(i_ctx);
 
-    char xml_file[PROPERTY_VALUE_MAX];
-
-    int ret = get_config_file(xml_file, sizeof(xml_file));
-    if (!ret) {
-        char path[256];
-        /* @TODO: XML files are TCS2_ prefixed because we cannot export two different XML files
-         * with the same name. Remove this HACK once TCS is merged. Or maybe find another solution ?
-         **/
-        snprintf(path, sizeof(path), "%s/config/TCS2_%s.xml", i_ctx->hw_xml_folder, xml_file);
-
-        LOGD("configuration file: %s", path);
-        i_ctx->doc = xmlReadFile(path, NULL, XML_PARSE_NOENT);
-        DASSERT(i_ctx->doc != NULL, "xml file (%s) not parsed correctly (%s)", path,
-                xmlGetLastError()->message);
+    return &i_ctx->timing;
+}
 
-        i_ctx->root_node = xmlDocGetRootElement(i_ctx->doc);
-        ASSERT(xmlStrcmp(i_ctx->root_node->name, TAG_CONFIG) == 0);
+/**
+ * @see tcs.h
+ */
+static int get_stats(tcs_ctx_t *ctx, tcs_stats_t *stats, bool reset)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
 
-        parse_overlay(i_ctx, "config", true);
-    }
+    ASSERT(i_ctx);
 
-    return ret;
+#ifdef TCS_ENABLE_STATS
+    tcs_stats_snapshot(&i_ctx->stats, stats, reset);
+    return 0;
+#else
+    (void)stats;
+    (void)reset;
+    return -1;
+#endif
 }
 
 /**
@@ -788,13 +2756,43 @@ static void dispose(tcs_ctx_t *ctx)
 
     ASSERT(i_ctx != NULL);
 
+#ifdef TCS_ENABLE_STATS
+    if (i_ctx->stats_dump)
+        tcs_stats_dump(&i_ctx->stats);
+#endif
+
+    tcs_index_free(&i_ctx->index);
     xmlFreeDoc(i_ctx->doc);
-    xmlCleanupParser();
+    for (int i = 0; i < i_ctx->nb_layer_docs; i++)
+        xmlFreeDoc(i_ctx->layer_docs[i]);
+    free(i_ctx->layer_docs);
+    tcs_bundle_close(i_ctx->bundle);
+    tcs_doc_cache_free(i_ctx->module_docs);
+    free_overlay_index(i_ctx);
+    free_module_groups(i_ctx);
+    if (i_ctx->shared && !__atomic_sub_fetch(&i_ctx->shared->refs, 1, __ATOMIC_ACQ_REL)) {
+        tcs_frozen_free(i_ctx->shared->frozen);
+        free(i_ctx->shared);
+    }
+    libxml_unref();
+
+    if (i_ctx->record)
+        tcs_profile_write(i_ctx->record, i_ctx->record_path);
+    tcs_profile_free(i_ctx->record);
+    tcs_profile_free(i_ctx->profile);
+    free(i_ctx->record_path);
 
     free(i_ctx->hw_xml_folder);
     free(i_ctx->overlay_xml_folder);
     free(i_ctx->select_group_name);
 
+    for (int i = 0; i < i_ctx->timing.nb_files; i++)
+        free((char *)i_ctx->timing_files[i].path);
+    free(i_ctx->timing_files);
+
+    /* messages of the context are written before it is gone */
+    tcs_log_flush();
+
     free(i_ctx);
 }
 
@@ -808,27 +2806,224 @@ tcs_ctx_t *tcs2_init(const char *optional_group)
     ASSERT(i_ctx != NULL);
     /* optional_group can be NULL */
 
+    libxml_ref();
+
     i_ctx->ctx.dispose = dispose;
     i_ctx->ctx.select_group = select_group;
+    i_ctx->ctx.open_group = open_group;
+    i_ctx->ctx.group_get_bool = group_get_bool;
+    i_ctx->ctx.group_get_int = group_get_int;
+    i_ctx->ctx.group_get_string = group_get_string;
+    i_ctx->ctx.group_get_string_array = group_get_string_array;
+    i_ctx->ctx.query_int = query_int;
+    i_ctx->ctx.query_string = query_string;
     i_ctx->ctx.get_string = get_string;
     i_ctx->ctx.get_string_array = get_string_array;
     i_ctx->ctx.get_int = get_int;
     i_ctx->ctx.get_bool = get_bool;
     i_ctx->ctx.print = print;
     i_ctx->ctx.add_group = add_group;
+    i_ctx->ctx.get_generation = get_generation;
+    i_ctx->ctx.get_stats = get_stats;
+    i_ctx->ctx.get_timing_report = get_timing_report;
+    i_ctx->ctx.get_int_hashed = get_int_hashed;
+    i_ctx->ctx.get_bool_hashed = get_bool_hashed;
+    i_ctx->ctx.peek_string = peek_string;
+    i_ctx->ctx.peek_string_array = peek_string_array;
+    i_ctx->ctx.freeze = freeze;
+    i_ctx->ctx.get_string_array_packed = get_string_array_packed;
+    i_ctx->ctx.remove_group = remove_group;
+    i_ctx->ctx.open_group_hashed = open_group_hashed;
+    i_ctx->ctx.select_group_handle = select_group_handle;
+    i_ctx->ctx.close_group = close_group;
+
+#ifdef TCS_ENABLE_STATS
+    char value[PROPERTY_VALUE_MAX];
+    property_get(TCS_KEY_STATS_DUMP, value, "");
+    i_ctx->stats_dump = !strcmp(value, "true");
+#endif
 
+    char layered[PROPERTY_VALUE_MAX];
+    property_get(TCS_KEY_LAYERED_OVERLAYS, layered, "");
+    i_ctx->index.layered = !strcmp(layered, "true");
+
+    char parser[PROPERTY_VALUE_MAX];
+    property_get(TCS_KEY_XML_PARSER, parser, "");
+    i_ctx->xml_parser = TCS_DEFAULT_XML_PARSER;
+    if (!strcmp(parser, "libxml2"))
+        i_ctx->xml_parser = TCS_XML_PARSER_LIBXML2;
+    else if (!strcmp(parser, "builtin"))
+        i_ctx->xml_parser = TCS_XML_PARSER_BUILTIN;
+    else if (!strcmp(parser, "check"))
+        i_ctx->xml_parser = TCS_XML_PARSER_CHECK;
+
+    char budget[PROPERTY_VALUE_MAX];
+    property_get(TCS_KEY_GROUP_BUDGET, budget, "0");
+    int group_budget = atoi(budget);
+    i_ctx->group_budget = (group_budget > 0) ? group_budget : 0;
+
+    unsigned long long start = now_ns();
     i_ctx->hw_xml_folder = get_hw_config_folder();
     i_ctx->overlay_xml_folder = get_overlay_folder();
+    timing_add(i_ctx, TCS_PHASE_PLATFORM, start, NULL, 0);
+    init_profile(i_ctx);
 
     if (!parse_config(i_ctx)) {
         if (optional_group) {
             i_ctx->default_group_node = priv_add_group(i_ctx, optional_group, false);
             i_ctx->select_group_node = next_node(i_ctx->default_group_node->children);
             i_ctx->select_group_name = strdup(optional_group);
+            if (i_ctx->record)
+                record_group(i_ctx, optional_group);
         }
+        char timing_log[PROPERTY_VALUE_MAX];
+        property_get(TCS_KEY_TIMING_LOG, timing_log, "");
+        if (!strcmp(timing_log, "true"))
+            print_timing(i_ctx);
         return &i_ctx->ctx;
     } else {
         dispose((tcs_ctx_t *)i_ctx);
         return NULL;
     }
 }
+
+/**
+ * @see tcs.h
+ */
+tcs_ctx_t *tcs2_clone(tcs_ctx_t *ctx)
+{
+    tcs_internal_ctx_t *i_ctx = (tcs_internal_ctx_t *)ctx;
+
+    ASSERT(i_ctx);
+
+    if (!i_ctx->frozen) {
+        LOGE("Configuration is not frozen. Context not cloned");
+        return NULL;
+    }
+
+    tcs_internal_ctx_t *clone = calloc(1, sizeof(tcs_internal_ctx_t));
+    ASSERT(clone);
+    libxml_ref();
+
+    clone->ctx = i_ctx->ctx;
+    __atomic_add_fetch(&i_ctx->shared->refs, 1, __ATOMIC_RELAXED);
+    clone->shared = i_ctx->shared;
+    clone->frozen = i_ctx->frozen;
+    clone->default_group = i_ctx->default_group;
+    clone->select_group = i_ctx->select_group;
+    clone->index.generation = i_ctx->index.generation;
+    clone->index.layered = i_ctx->index.layered;
+#ifdef TCS_ENABLE_STATS
+    clone->stats_dump = i_ctx->stats_dump;
+#endif
+
+    return &clone->ctx;
+}
+
+static void *async_init_thread(void *data)
+{
+    tcs_async_t *handle = data;
+
+    ASSERT(handle);
+
+    handle->ctx = tcs2_init(handle->optional_group);
+    libxml_unref();
+
+    uint64_t event = 1;
+    ASSERT(write(handle->fd, &event, sizeof(event)) == sizeof(event));
+
+    return NULL;
+}
+
+/**
+ * @see tcs.h
+ */
+tcs_async_t *tcs2_init_async(const char *optional_group)
+{
+    tcs_async_t *handle = calloc(1, sizeof(tcs_async_t));
+
+    ASSERT(handle != NULL);
+    /* optional_group can be NULL */
+
+    if (optional_group) {
+        handle->optional_group = strdup(optional_group);
+        ASSERT(handle->optional_group);
+    }
+
+    handle->fd = eventfd(0, EFD_CLOEXEC);
+    DASSERT(handle->fd >= 0, "Failed to create eventfd. Reason: %s", strerror(errno));
+
+    /* libxml2 must be initialized by the main thread before being used by other threads. It is
+     * not released until the context is created */
+    libxml_ref();
+    xmlInitParser();
+
+    int err = pthread_create(&handle->thread, NULL, async_init_thread, handle);
+    DASSERT(err == 0, "Failed to create init thread. Reason: %s", strerror(err));
+
+    return handle;
+}
+
+/**
+ * @see tcs.h
+ */
+int tcs2_async_get_fd(tcs_async_t *handle)
+{
+    ASSERT(handle);
+
+    return handle->fd;
+}
+
+/**
+ * @see tcs.h
+ */
+int tcs2_async_wait(tcs_async_t *handle, int timeout_ms)
+{
+    ASSERT(handle);
+
+    struct pollfd pfd = { .fd = handle->fd, .events = POLLIN };
+    int err;
+
+    do
+        err = poll(&pfd, 1, timeout_ms);
+    while ((err < 0) && (errno == EINTR));
+    DASSERT(err >= 0, "poll failure. Reason: %s", strerror(errno));
+
+    return err > 0 ? 0 : -1;
+}
+
+/**
+ * @see tcs.h
+ */
+int tcs2_async_get_result(tcs_async_t *handle, tcs_ctx_t **ctx)
+{
+    ASSERT(handle);
+    ASSERT(ctx);
+
+    if (!handle->joined) {
+        ASSERT(pthread_join(handle->thread, NULL) == 0);
+        handle->joined = true;
+    }
+
+    *ctx = handle->ctx;
+    handle->ctx = NULL;
+
+    return *ctx ? 0 : -1;
+}
+
+/**
+ * @see tcs.h
+ */
+void tcs2_async_dispose(tcs_async_t *handle)
+{
+    ASSERT(handle);
+
+    tcs_ctx_t *ctx = NULL;
+    tcs2_async_get_result(handle, &ctx);
+    if (ctx)
+        ctx->dispose(ctx);
+
+    close(handle->fd);
+    free(handle->optional_group);
+    free(handle);
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Configuration bundle
+ *
+ * A bundle gathers the flattened configuration and module groups of one platform and one sw
+ * folder in a single file. It is mapped in memory at init and an entry is parsed only when its
+ * group is added. Entries can be zlib compressed.
+ *
+ * Bundle format (integers are 32-bit, native byte order):
+ *   header: "TCS2BNDL", version, number of entries
+ *   table of contents, one record per entry:
+ *     name (64 bytes, NUL terminated), offset from the beginning of the file, stored size,
+ *     raw size, flags
+ *   entries: XML text of the configuration ("config" entry) or of a module group (entry named
+ *   after the group), compressed with zlib if TCS_BUNDLE_COMPRESSED is set
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+#define BUNDLE_MAGIC "TCS2BNDL"
+#define BUNDLE_VERSION 1
+#define BUNDLE_NAME_SIZE 64
+
+#define TCS_BUNDLE_COMPRESSED 0x1
+
+typedef struct bundle_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t nb;
+} bundle_header_t;
+
+typedef struct bundle_entry {
+    char name[BUNDLE_NAME_SIZE];
+    uint32_t offset;
+    uint32_t size;
+    uint32_t raw_size;
+    uint32_t flags;
+} bundle_entry_t;
+
+struct tcs_bundle {
+    char *path;
+    const uint8_t *data;
+    size_t size;
+    const bundle_entry_t *entries;
+    int nb;
+};
+
+typedef struct writer_entry {
+    char name[BUNDLE_NAME_SIZE];
+    void *data;
+    uint32_t size;
+    uint32_t raw_size;
+    uint32_t flags;
+} writer_entry_t;
+
+struct tcs_bundle_writer {
+    bool compress;
+    int nb;
+    writer_entry_t *entries;
+};
+
+/**
+ * Maps a bundle
+ *
+ * @param [in] path Path of the bundle
+ *
+ * @return the bundle or NULL if the file doesn't exist or is invalid
+ */
+tcs_bundle_t *tcs_bundle_open(const char *path)
+{
+    ASSERT(path);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (!fstat(fd, &st) && (st.st_size >= (off_t)sizeof(bundle_header_t)))
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOGE("Failed to map bundle (%s)", path);
+        return NULL;
+    }
+
+    const bundle_header_t *header = data;
+    size_t size = st.st_size;
+    bool valid = !memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) &&
+                 (header->version == BUNDLE_VERSION) &&
+                 (header->nb <= (size - sizeof(*header)) / sizeof(bundle_entry_t));
+    const bundle_entry_t *entries = (const bundle_entry_t *)(header + 1);
+    for (uint32_t i = 0; valid && (i < header->nb); i++)
+        valid = (entries[i].offset <= size) && (entries[i].size <= size - entries[i].offset) &&
+                (memchr(entries[i].name, '\0', BUNDLE_NAME_SIZE) != NULL);
+    if (!valid) {
+        LOGE("Bundle (%s) is corrupted. Ignored", path);
+        munmap(data, size);
+        return NULL;
+    }
+
+    tcs_bundle_t *bundle = calloc(1, sizeof(tcs_bundle_t));
+    ASSERT(bundle);
+    bundle->path = strdup(path);
+    ASSERT(bundle->path);
+    bundle->data = data;
+    bundle->size = size;
+    bundle->entries = entries;
+    bundle->nb = header->nb;
+    LOGD("bundle (%s): %d entries", path, bundle->nb);
+
+    return bundle;
+}
+
+void tcs_bundle_close(tcs_bundle_t *bundle)
+{
+    if (!bundle)
+        return;
+
+    munmap((void *)bundle->data, bundle->size);
+    free(bundle->path);
+    free(bundle);
+}
+
+const char *tcs_bundle_get_path(const tcs_bundle_t *bundle)
+{
+    ASSERT(bundle);
+    return bundle->path;
+}
+
+/**
+ * Parses an entry of a bundle. Only this entry is decompressed
+ *
+ * @param [in]  bundle Bundle
+ * @param [in]  parser Parser backend
+ * @param [in]  name   Name of the entry
+ * @param [out] bytes  Stored size of the entry. Can be NULL
+ *
+ * @return the XML document or NULL if the entry is not found
+ */
+xmlDocPtr tcs_bundle_read(const tcs_bundle_t *bundle, tcs_xml_parser_t parser, const char *name,
+                          long long *bytes)
+{
+    ASSERT(bundle);
+    ASSERT(name);
+
+    const bundle_entry_t *entry = NULL;
+    for (int i = 0; !entry && (i < bundle->nb); i++)
+        if (!strcmp(bundle->entries[i].name, name))
+            entry = &bundle->entries[i];
+    if (!entry)
+        return NULL;
+
+    if (bytes)
+        *bytes = entry->size;
+
+    const char *data = (const char *)bundle->data + entry->offset;
+    void *raw = NULL;
+    size_t size = entry->size;
+    if (entry->flags & TCS_BUNDLE_COMPRESSED) {
+        uLongf raw_size = entry->raw_size;
+        raw = malloc(raw_size ? raw_size : 1);
+        ASSERT(raw);
+        int err = uncompress(raw, &raw_size, (const Bytef *)data, entry->size);
+        DASSERT(err == Z_OK, "entry (%s) of bundle (%s) not decompressed (%d)", name,
+                bundle->path, err);
+        data = raw;
+        size = raw_size;
+    }
+
+    xmlDocPtr doc = tcs_xml_parse(parser, data, size, name);
+    DASSERT(doc != NULL, "entry (%s) of bundle (%s) not parsed correctly (%s)", name,
+            bundle->path, xmlGetLastError()->message);
+    free(raw);
+
+    return doc;
+}
+
+tcs_bundle_writer_t *tcs_bundle_writer_new(bool compress)
+{
+    tcs_bundle_writer_t *writer = calloc(1, sizeof(tcs_bundle_writer_t));
+
+    ASSERT(writer);
+    writer->compress = compress;
+    return writer;
+}
+
+/**
+ * Adds an entry to a bundle being written
+ *
+ * @param [in] writer Bundle writer
+ * @param [in] name   Name of the entry
+ * @param [in] node   Node serialized in the entry, with its children
+ */
+void tcs_bundle_writer_add(tcs_bundle_writer_t *writer, const char *name, xmlNodePtr node)
+{
+    ASSERT(writer);
+    ASSERT(name);
+    ASSERT(node);
+    ASSERT(strlen(name) < BUNDLE_NAME_SIZE);
+
+    xmlBufferPtr buf = xmlBufferCreate();
+    ASSERT(buf);
+    ASSERT(xmlNodeDump(buf, node->doc, node, 0, 1) >= 0);
+
+    writer->entries = realloc(writer->entries, (writer->nb + 1) * sizeof(writer_entry_t));
+    ASSERT(writer->entries);
+    writer_entry_t *entry = &writer->entries[writer->nb++];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->raw_size = xmlBufferLength(buf);
+
+    if (writer->compress) {
+        uLongf size = compressBound(entry->raw_size);
+        entry->data = malloc(size);
+        ASSERT(entry->data);
+        ASSERT(compress2(entry->data, &size, xmlBufferContent(buf), entry->raw_size,
+                         Z_BEST_COMPRESSION) == Z_OK);
+        entry->size = size;
+        entry->flags = TCS_BUNDLE_COMPRESSED;
+    } else {
+        entry->data = malloc(entry->raw_size ? entry->raw_size : 1);
+        ASSERT(entry->data);
+        memcpy(entry->data, xmlBufferContent(buf), entry->raw_size);
+        entry->size = entry->raw_size;
+    }
+    xmlBufferFree(buf);
+}
+
+/**
+ * Writes a bundle and frees the writer
+ *
+ * @param [in] writer Bundle writer
+ * @param [in] path   Path of the bundle
+ *
+ * @return 0 if successful
+ */
+int tcs_bundle_writer_save(tcs_bundle_writer_t *writer, const char *path)
+{
+    ASSERT(writer);
+    ASSERT(path);
+
+    bundle_header_t header = { .version = BUNDLE_VERSION, .nb = writer->nb };
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+
+    bundle_entry_t *toc = calloc(writer->nb ? writer->nb : 1, sizeof(bundle_entry_t));
+    ASSERT(toc);
+    uint32_t offset = sizeof(header) + writer->nb * sizeof(bundle_entry_t);
+    for (int i = 0; i < writer->nb; i++) {
+        memcpy(toc[i].name, writer->entries[i].name, BUNDLE_NAME_SIZE);
+        toc[i].offset = offset;
+        toc[i].size = writer->entries[i].size;
+        toc[i].raw_size = writer->entries[i].raw_size;
+        toc[i].flags = writer->entries[i].flags;
+        offset += toc[i].size;
+    }
+
+    int ret = -1;
+    FILE *fp = fopen(path, "w");
+    if (fp) {
+        bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+                  (fwrite(toc, sizeof(bundle_entry_t), writer->nb, fp) == (size_t)writer->nb);
+        for (int i = 0; ok && (i < writer->nb); i++)
+            ok = fwrite(writer->entries[i].data, 1, writer->entries[i].size, fp) ==
+                 writer->entries[i].size;
+        ret = (fclose(fp) || !ok) ? -1 : 0;
+    }
+    if (ret)
+        LOGE("Failed to write bundle (%s)", path);
+
+    for (int i = 0; i < writer->nb; i++)
+        free(writer->entries[i].data);
+    free(writer->entries);
+    free(writer);
+    free(toc);
+
+    return ret;
+}
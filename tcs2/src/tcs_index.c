@@ -0,0 +1,690 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Group index
+ *
+ * Each group node gets a tcs_group_info_t, stored in its _private field. It holds a hash table of
+ * the direct children of the group (properties, lists and groups), keyed by tcs_hash() of their
+ * key or name. The table is built at first lookup and rebuilt lazily once the context generation
+ * has changed. Values point to the tree: nothing is copied unless the content of a node is split
+ * in several text nodes.
+ *
+ * In layered mode, overlay files are not merged in the tree: their groups are kept as layers on
+ * top of the group they apply to. The overlay semantics (overwritten properties, appended or
+ * overwritten lists, new groups) are resolved when the index of a group is built, and memoised
+ * in its entries. Building the index of a group gives their layers to its child groups, so the
+ * index of the parent is always refreshed first.
+ *
+ * Clients probe many optional keys that don't exist. Each index has a Bloom filter of the hashes
+ * of its entries (2 bits per entry, 8 filter bits per slot, so at least 16 filter bits per entry):
+ * about 99% of the misses are rejected without probing the table.
+ *
+ * Freezing copies the indexes of all the groups, built beforehand, in a single anonymous mapping
+ * made read-only: tables, Bloom filters and list arrays first, then all the strings. Nothing
+ * points to the tree anymore, which can be freed, and the pages are never written again: they
+ * stay shared with the processes forked afterwards. The root and the hot groups of the access
+ * profile are copied first, so that startup lookups touch the first pages only.
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+static const xmlChar *const g_tags[TCS_TAG_NB] = {
+    [TCS_TAG_GROUP] = TAG_GROUP,
+    [TCS_TAG_LIST] = TAG_LIST,
+    [TCS_TAG_STRING] = TAG_STRING,
+    [TCS_TAG_INT] = TAG_INT,
+    [TCS_TAG_BOOL] = TAG_BOOL,
+};
+
+const xmlChar *tcs_peek_prop(xmlNodePtr node, const xmlChar *name)
+{
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next)
+        if (!xmlStrcmp(attr->name, name))
+            return (attr->children && (attr->children->type == XML_TEXT_NODE) &&
+                    !attr->children->next) ? attr->children->content : NULL;
+    return NULL;
+}
+
+const xmlChar *tcs_peek_content(xmlNodePtr node)
+{
+    xmlNodePtr text = node->children;
+
+    if (!text)
+        return (const xmlChar *)"";
+    return ((text->type == XML_TEXT_NODE) && !text->next) ? text->content : NULL;
+}
+
+static const char *keep(tcs_group_info_t *info, xmlChar *str)
+{
+    ASSERT(str);
+
+    info->owned = realloc(info->owned, (info->nb_owned + 1) * sizeof(xmlChar *));
+    ASSERT(info->owned);
+    info->owned[info->nb_owned++] = str;
+
+    return (const char *)str;
+}
+
+static const char *get_content(tcs_group_info_t *info, xmlNodePtr node)
+{
+    const xmlChar *content = tcs_peek_content(node);
+
+    return content ? (const char *)content : keep(info, xmlNodeGetContent(node));
+}
+
+static void clear(tcs_group_info_t *info)
+{
+    if (info->entries)
+        for (unsigned int i = 0; i <= info->mask; i++)
+            free(info->entries[i].list);
+    free(info->entries);
+    info->entries = NULL;
+    free(info->bloom);
+    info->bloom = NULL;
+    info->mask = 0;
+
+    for (int i = 0; i < info->nb_owned; i++)
+        xmlFree(info->owned[i]);
+    free(info->owned);
+    info->owned = NULL;
+    info->nb_owned = 0;
+}
+
+static tcs_tag_t get_tag(xmlNodePtr node)
+{
+    tcs_tag_t tag = 0;
+
+    while ((tag < TCS_TAG_NB) && xmlStrcmp(node->name, g_tags[tag]))
+        tag++;
+    return tag;
+}
+
+/**
+ * Gets the key of a property or the name of a list or a group
+ */
+static const char *get_key(tcs_group_info_t *info, xmlNodePtr node, tcs_tag_t tag)
+{
+    const xmlChar *attr = (tag == TCS_TAG_GROUP || tag == TCS_TAG_LIST) ? ATTR_NAME : ATTR_KEY;
+    const char *key = (const char *)tcs_peek_prop(node, attr);
+
+    if (!key) {
+        xmlChar *tmp = xmlGetProp(node, attr);
+        if (tmp)
+            key = keep(info, tmp);
+    }
+    return key;
+}
+
+/**
+ * Gives the two bits of a hash in the Bloom filter of a group
+ */
+static inline void bloom_bits(const tcs_group_info_t *info, unsigned int hash, unsigned int *bit1,
+                              unsigned int *bit2)
+{
+    unsigned int mask = info->mask * 8 + 7;
+
+    *bit1 = hash & mask;
+    *bit2 = ((hash >> 16) | (hash << 16)) & mask;
+}
+
+static void bloom_add(tcs_group_info_t *info, unsigned int hash)
+{
+    unsigned int bit1, bit2;
+
+    bloom_bits(info, hash, &bit1, &bit2);
+    info->bloom[bit1 / 64] |= 1ULL << (bit1 % 64);
+    info->bloom[bit2 / 64] |= 1ULL << (bit2 % 64);
+}
+
+static inline bool bloom_test(const tcs_group_info_t *info, unsigned int hash)
+{
+    unsigned int bit1, bit2;
+
+    bloom_bits(info, hash, &bit1, &bit2);
+    return (info->bloom[bit1 / 64] & (1ULL << (bit1 % 64))) &&
+           (info->bloom[bit2 / 64] & (1ULL << (bit2 % 64)));
+}
+
+/**
+ * Finds the slot of an element
+ *
+ * @return the slot of the element, or the free slot where it must be added
+ */
+static tcs_index_entry_t *find_slot(const tcs_group_info_t *info, tcs_tag_t tag,
+                                    unsigned int hash, const char *key)
+{
+    for (unsigned int i = hash & info->mask;; i = (i + 1) & info->mask) {
+        tcs_index_entry_t *entry = &info->entries[i];
+        if (!entry->key ||
+            ((entry->hash == hash) && (entry->tag == tag) && !strcmp(entry->key, key)))
+            return entry;
+    }
+}
+
+/**
+ * Appends the contents of the elements of a list node to a list entry
+ */
+static void append_list(tcs_group_info_t *info, tcs_index_entry_t *entry, xmlNodePtr node)
+{
+    int nb = 0;
+    xmlNodePtr cur = next_node(node->children);
+
+    for (xmlNodePtr tmp = cur; tmp; tmp = next_node(tmp))
+        nb++;
+    if (!nb)
+        return;
+
+    entry->list = realloc(entry->list, (entry->nb + nb) * sizeof(char *));
+    ASSERT(entry->list);
+    for (; cur; cur = next_node(cur))
+        entry->list[entry->nb++] = get_content(info, cur);
+}
+
+static void add_entry(tcs_group_info_t *info, tcs_index_entry_t *entry, xmlNodePtr node,
+                      tcs_tag_t tag, unsigned int hash, const char *key)
+{
+    entry->hash = hash;
+    entry->tag = tag;
+    entry->key = key;
+    entry->node = node;
+    bloom_add(info, hash);
+    if (tag == TCS_TAG_LIST)
+        append_list(info, entry, node);
+    else if (tag != TCS_TAG_GROUP)
+        entry->value = get_content(info, node);
+}
+
+/**
+ * Applies a layer on top of the entries: properties are overwritten, lists are appended or
+ * overwritten depending on their overlay mode, groups and lists are added. Groups existing in
+ * the tree are left as is: they get the layer when the index is pushed down (@see push_layers)
+ */
+static void apply_layer(tcs_group_info_t *info, xmlNodePtr layer)
+{
+    for (xmlNodePtr node = next_node(layer->children); node; node = next_node(node)) {
+        tcs_tag_t tag = get_tag(node);
+        if (tag == TCS_TAG_NB)
+            continue;
+        const char *key = get_key(info, node, tag);
+        if (!key)
+            continue;
+
+        unsigned int hash = tcs_hash(key);
+        tcs_index_entry_t *entry = find_slot(info, tag, hash, key);
+        if (!entry->key) {
+            add_entry(info, entry, node, tag, hash, key);
+        } else if (tag == TCS_TAG_LIST) {
+            const xmlChar *mode = tcs_peek_prop(node, ATTR_OVERLAY_MODE);
+            if (mode && !xmlStrcmp(mode, (const xmlChar *)"overwrite")) {
+                free(entry->list);
+                entry->list = NULL;
+                entry->nb = 0;
+            }
+            entry->node = node;
+            append_list(info, entry, node);
+        } else if (tag != TCS_TAG_GROUP) {
+            entry->node = node;
+            entry->value = get_content(info, node);
+        }
+    }
+}
+
+static void build(tcs_group_info_t *info)
+{
+    int nb = 0;
+
+    for (xmlNodePtr node = next_node(info->node->children); node; node = next_node(node))
+        nb++;
+    for (int i = 0; i < info->nb_layers; i++)
+        for (xmlNodePtr node = next_node(info->layers[i]->children); node; node = next_node(node))
+            nb++;
+
+    unsigned int size = 8;
+    while (size < 2 * (unsigned int)nb)
+        size *= 2;
+    info->mask = size - 1;
+    info->entries = calloc(size, sizeof(tcs_index_entry_t));
+    ASSERT(info->entries);
+    info->bloom = calloc(size / 8, sizeof(unsigned long long));
+    ASSERT(info->bloom);
+
+    for (xmlNodePtr node = next_node(info->node->children); node; node = next_node(node)) {
+        tcs_tag_t tag = get_tag(node);
+        if (tag == TCS_TAG_NB)
+            continue;
+        const char *key = get_key(info, node, tag);
+        if (!key)
+            continue;
+
+        unsigned int hash = tcs_hash(key);
+        tcs_index_entry_t *entry = find_slot(info, tag, hash, key);
+        /* Only the first element of a given tag and key is indexed, as search_node() does */
+        if (!entry->key)
+            add_entry(info, entry, node, tag, hash, key);
+    }
+
+    for (int i = 0; i < info->nb_layers; i++)
+        apply_layer(info, info->layers[i]);
+}
+
+static void add_layer(xmlNodePtr **layers, int *nb, xmlNodePtr layer)
+{
+    *layers = realloc(*layers, (*nb + 1) * sizeof(xmlNodePtr));
+    ASSERT(*layers);
+    (*layers)[(*nb)++] = layer;
+}
+
+/**
+ * Gives their layers to the child groups: groups of the same name in the layers of the parent,
+ * then their own layers
+ */
+static void push_layers(tcs_index_t *index, tcs_group_info_t *info)
+{
+    for (unsigned int i = 0; i <= info->mask; i++) {
+        const tcs_index_entry_t *entry = &info->entries[i];
+        if (!entry->key || (entry->tag != TCS_TAG_GROUP))
+            continue;
+
+        tcs_group_info_t *child = tcs_group_info_get(index, entry->node);
+        child->parent = info;
+        child->nb_layers = 0;
+        for (int j = 0; j < info->nb_layers; j++) {
+            xmlNodePtr node = next_node(info->layers[j]->children);
+            for (; node; node = next_node(node)) {
+                if ((node != entry->node) && (get_tag(node) == TCS_TAG_GROUP) &&
+                    !xmlStrcmp(tcs_peek_prop(node, ATTR_NAME), (const xmlChar *)entry->key)) {
+                    add_layer(&child->layers, &child->nb_layers, node);
+                    break;
+                }
+            }
+        }
+        for (int j = 0; j < child->nb_own_layers; j++)
+            add_layer(&child->layers, &child->nb_layers, child->own_layers[j]);
+    }
+}
+
+tcs_group_info_t *tcs_group_info_get(tcs_index_t *index, xmlNodePtr group)
+{
+    ASSERT(index);
+    ASSERT(group);
+
+    tcs_group_info_t *info = group->_private;
+    if (!info) {
+        info = calloc(1, sizeof(tcs_group_info_t));
+        ASSERT(info);
+        info->node = group;
+        info->next = index->infos;
+        index->infos = info;
+        group->_private = info;
+    }
+
+    return info;
+}
+
+tcs_group_info_t *tcs_index_refresh(tcs_index_t *index, xmlNodePtr group)
+{
+    tcs_group_info_t *info = tcs_group_info_get(index, group);
+
+    if (info->entries && (info->index_generation == index->generation))
+        return info;
+
+    if (index->layered) {
+        /* layers of the group are given by its parent */
+        tcs_group_info_t *parent = info->parent;
+        if (!parent && group->parent && (group->parent->type == XML_ELEMENT_NODE))
+            parent = tcs_group_info_get(index, group->parent);
+        if (parent) {
+            tcs_index_refresh(index, parent->node);
+        } else {
+            info->nb_layers = 0;
+            for (int i = 0; i < info->nb_own_layers; i++)
+                add_layer(&info->layers, &info->nb_layers, info->own_layers[i]);
+        }
+    }
+
+    clear(info);
+    build(info);
+    info->index_generation = index->generation;
+    if (index->layered)
+        push_layers(index, info);
+
+    return info;
+}
+
+const tcs_index_entry_t *tcs_index_lookup(tcs_index_t *index, xmlNodePtr group, tcs_tag_t tag,
+                                          unsigned int hash, const char *key)
+{
+    ASSERT(tag < TCS_TAG_NB);
+    ASSERT(key);
+
+    return tcs_index_find(tcs_index_refresh(index, group), tag, hash, key);
+}
+
+/**
+ * Finds an element in an index already built, e.g. a group of the frozen configuration
+ */
+const tcs_index_entry_t *tcs_index_find(const tcs_group_info_t *info, tcs_tag_t tag,
+                                        unsigned int hash, const char *key)
+{
+    ASSERT(info);
+
+    if (!bloom_test(info, hash))
+        return NULL;
+    const tcs_index_entry_t *entry = find_slot(info, tag, hash, key);
+
+    return entry->key ? entry : NULL;
+}
+
+const xmlChar *tcs_tag_name(tcs_tag_t tag)
+{
+    ASSERT(tag < TCS_TAG_NB);
+    return g_tags[tag];
+}
+
+/**
+ * Adds an overlay group on top of a group. The generation must be bumped by the caller
+ *
+ * @param [in] index Index of the context
+ * @param [in] group Group node: top-level group or configuration root
+ * @param [in] layer Overlay group node, owned by the caller
+ */
+void tcs_index_add_layer(tcs_index_t *index, xmlNodePtr group, xmlNodePtr layer)
+{
+    ASSERT(index);
+    ASSERT(index->layered);
+    ASSERT(layer);
+
+    tcs_group_info_t *info = tcs_group_info_get(index, group);
+    add_layer(&info->own_layers, &info->nb_own_layers, layer);
+}
+
+static void free_info(tcs_group_info_t *info)
+{
+    info->node->_private = NULL;
+    clear(info);
+    free(info->path);
+    free(info->own_layers);
+    free(info->layers);
+    free(info);
+}
+
+void tcs_index_free(tcs_index_t *index)
+{
+    ASSERT(index);
+
+    while (index->infos) {
+        tcs_group_info_t *next = index->infos->next;
+        free_info(index->infos);
+        index->infos = next;
+    }
+}
+
+/**
+ * @return true if node is the group or one of its descendants, or is in one of its own layers
+ */
+static bool in_group(xmlNodePtr node, xmlNodePtr group, xmlNodePtr *layers, int nb_layers)
+{
+    for (; node && (node->type == XML_ELEMENT_NODE); node = node->parent) {
+        if (node == group)
+            return true;
+        for (int i = 0; i < nb_layers; i++)
+            if (node == layers[i])
+                return true;
+    }
+
+    return false;
+}
+
+/**
+ * Releases the infos of a top-level group, of its children and of its own layers, before the
+ * group is removed from the tree. The generation must be bumped by the caller
+ *
+ * @param [in] index Index of the context
+ * @param [in] group Group node
+ */
+void tcs_index_release(tcs_index_t *index, xmlNodePtr group)
+{
+    ASSERT(index);
+    ASSERT(group);
+
+    tcs_group_info_t *group_info = group->_private;
+    if (!group_info)
+        return;
+
+    /* the group info holds the layers: released last */
+    xmlNodePtr *layers = group_info->own_layers;
+    int nb_layers = group_info->nb_own_layers;
+    for (tcs_group_info_t **cur = &index->infos; *cur;) {
+        tcs_group_info_t *info = *cur;
+        if ((info != group_info) && in_group(info->node, group, layers, nb_layers)) {
+            *cur = info->next;
+            free_info(info);
+        } else {
+            cur = &info->next;
+        }
+    }
+
+    for (tcs_group_info_t **cur = &index->infos; *cur; cur = &(*cur)->next) {
+        if (*cur == group_info) {
+            *cur = group_info->next;
+            break;
+        }
+    }
+    free_info(group_info);
+}
+
+/**
+ * @return true if a handle was opened on the group or one of its descendants
+ */
+bool tcs_index_is_open(const tcs_index_t *index, xmlNodePtr group)
+{
+    ASSERT(index);
+    ASSERT(group);
+
+    const tcs_group_info_t *group_info = group->_private;
+    xmlNodePtr *layers = group_info ? group_info->own_layers : NULL;
+    int nb_layers = group_info ? group_info->nb_own_layers : 0;
+    for (const tcs_group_info_t *info = index->infos; info; info = info->next)
+        if (info->refs && in_group(info->node, group, layers, nb_layers))
+            return true;
+
+    return false;
+}
+
+#define ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+typedef struct arena {
+    char *data;                    // Next free byte of the tables
+    char *strings;                 // Next free byte of the strings
+} arena_t;
+
+static void *arena_alloc(arena_t *arena, size_t size)
+{
+    void *ptr = arena->data;
+
+    /* anonymous mapping: memory is already zeroed */
+    arena->data += ALIGN(size);
+    return ptr;
+}
+
+static const char *arena_strdup(arena_t *arena, const char *str)
+{
+    char *ptr = arena->strings;
+
+    arena->strings = stpcpy(ptr, str) + 1;
+    return ptr;
+}
+
+static size_t group_size(const tcs_group_info_t *info)
+{
+    return ALIGN(sizeof(tcs_group_info_t)) + (info->mask + 1) * sizeof(tcs_index_entry_t) +
+           (info->mask + 1) / 8 * sizeof(unsigned long long);
+}
+
+/**
+ * Builds the indexes of a group and of its child groups, and computes the size of their copy
+ */
+static void frozen_size(tcs_index_t *index, xmlNodePtr node, size_t path_len, size_t *data,
+                        size_t *strings)
+{
+    tcs_group_info_t *info = tcs_index_refresh(index, node);
+
+    *data += group_size(info);
+    *strings += path_len + 1;
+    for (unsigned int i = 0; i <= info->mask; i++) {
+        const tcs_index_entry_t *entry = &info->entries[i];
+        if (!entry->key)
+            continue;
+
+        size_t len = strlen(entry->key);
+        *strings += len + 1;
+        if (entry->value)
+            *strings += strlen(entry->value) + 1;
+        *data += ALIGN(entry->nb * sizeof(char *));
+        for (int j = 0; j < entry->nb; j++)
+            *strings += strlen(entry->list[j]) + 1;
+        if (entry->tag == TCS_TAG_GROUP)
+            frozen_size(index, entry->node, path_len + (path_len ? 1 : 0) + len, data, strings);
+    }
+}
+
+/**
+ * Copies the table, Bloom filter and entries of a group. Child groups are linked by freeze_group
+ */
+static tcs_group_info_t *copy_group(arena_t *arena, const tcs_group_info_t *info)
+{
+    tcs_group_info_t *frozen = arena_alloc(arena, sizeof(tcs_group_info_t));
+
+    frozen->generation = info->generation;
+    frozen->index_generation = info->index_generation;
+    frozen->mask = info->mask;
+    frozen->entries = arena_alloc(arena, (info->mask + 1) * sizeof(tcs_index_entry_t));
+    frozen->bloom = arena_alloc(arena, (info->mask + 1) / 8 * sizeof(unsigned long long));
+    memcpy(frozen->bloom, info->bloom, (info->mask + 1) / 8 * sizeof(unsigned long long));
+
+    for (unsigned int i = 0; i <= info->mask; i++) {
+        const tcs_index_entry_t *src = &info->entries[i];
+        if (!src->key)
+            continue;
+
+        tcs_index_entry_t *dst = &frozen->entries[i];
+        dst->hash = src->hash;
+        dst->tag = src->tag;
+        dst->key = arena_strdup(arena, src->key);
+        if (src->value)
+            dst->value = arena_strdup(arena, src->value);
+        if (src->nb) {
+            dst->list = arena_alloc(arena, src->nb * sizeof(char *));
+            for (int j = 0; j < src->nb; j++)
+                dst->list[j] = arena_strdup(arena, src->list[j]);
+            dst->nb = src->nb;
+        }
+    }
+
+    return frozen;
+}
+
+static tcs_group_info_t *freeze_group(tcs_index_t *index, arena_t *arena, xmlNodePtr node,
+                                      tcs_group_info_t *parent, const char *path)
+{
+    const tcs_group_info_t *info = tcs_index_refresh(index, node);
+    tcs_group_info_t *frozen = info->frozen ? info->frozen : copy_group(arena, info);
+
+    frozen->path = (char *)arena_strdup(arena, path);
+    frozen->parent = parent;
+
+    for (unsigned int i = 0; i <= info->mask; i++) {
+        const tcs_index_entry_t *src = &info->entries[i];
+        if (!src->key || (src->tag != TCS_TAG_GROUP))
+            continue;
+
+        char child_path[256];
+        snprintf(child_path, sizeof(child_path), "%s%s%s", path, *path ? "." : "", src->key);
+        frozen->entries[i].group = freeze_group(index, arena, src->node, frozen, child_path);
+    }
+
+    return frozen;
+}
+
+/**
+ * Copies the indexes of all the groups in a read-only mapping. The tree is left unchanged
+ *
+ * @param [in] index  Index of the context
+ * @param [in] root   Configuration root
+ * @param [in] hot    Groups copied first, after the root, e.g. from the access profile. Can be NULL
+ * @param [in] nb_hot Number of hot groups
+ *
+ * @return the frozen configuration or NULL if the mapping cannot be created
+ */
+tcs_frozen_t *tcs_index_freeze(tcs_index_t *index, xmlNodePtr root, const xmlNodePtr *hot,
+                               int nb_hot)
+{
+    ASSERT(index);
+    ASSERT(root);
+
+    size_t data = ALIGN(sizeof(tcs_frozen_t));
+    size_t strings = 0;
+    frozen_size(index, root, 0, &data, &strings);
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (data + strings + page - 1) / page * page;
+    char *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        LOGE("Failed to map frozen configuration (%zu bytes)", size);
+        return NULL;
+    }
+
+    arena_t arena = { .data = base, .strings = base + data };
+    tcs_frozen_t *frozen = arena_alloc(&arena, sizeof(tcs_frozen_t));
+    frozen->size = size;
+
+    /* startup lookups touch the root and the hot groups: they share the first pages */
+    tcs_group_info_t *info = tcs_group_info_get(index, root);
+    info->frozen = copy_group(&arena, info);
+    for (int i = 0; i < nb_hot; i++) {
+        info = tcs_group_info_get(index, hot[i]);
+        if (!info->frozen)
+            info->frozen = copy_group(&arena, info);
+    }
+
+    frozen->root = freeze_group(index, &arena, root, NULL, "");
+    ASSERT((arena.data == base + data) && (arena.strings == base + data + strings));
+    ASSERT(mprotect(base, size, PROT_READ) == 0);
+    LOGD("frozen configuration: %zu bytes", size);
+
+    return frozen;
+}
+
+void tcs_frozen_free(tcs_frozen_t *frozen)
+{
+    if (frozen)
+        munmap(frozen, frozen->size);
+}
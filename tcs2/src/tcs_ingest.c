@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * XML file ingestion
+ *
+ * All the files needed by an init or an add_group are known before the first one is parsed. They
+ * are opened up front and the kernel is asked to read them ahead (POSIX_FADV_WILLNEED): reads of
+ * all the files are issued together and the parsing of the first file overlaps the I/O of the
+ * next ones. Each file is then mapped and parsed from memory, by libxml2 or by the built-in
+ * tokenizer (@see tcs_tokenizer.c).
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+typedef struct prefetch_file {
+    char *path;
+    int fd;                        // -1 once parsed
+} prefetch_file_t;
+
+struct tcs_prefetch {
+    int nb;
+    prefetch_file_t *files;
+};
+
+tcs_prefetch_t *tcs_prefetch_new(void)
+{
+    tcs_prefetch_t *prefetch = calloc(1, sizeof(tcs_prefetch_t));
+
+    ASSERT(prefetch);
+    return prefetch;
+}
+
+/**
+ * Opens a file and starts reading it in the background
+ *
+ * @param [in] prefetch Set of prefetched files
+ * @param [in] path     Path of the file
+ */
+void tcs_prefetch_add(tcs_prefetch_t *prefetch, const char *path)
+{
+    ASSERT(prefetch);
+    ASSERT(path);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+    prefetch->files = realloc(prefetch->files, (prefetch->nb + 1) * sizeof(prefetch_file_t));
+    ASSERT(prefetch->files);
+    prefetch->files[prefetch->nb].path = strdup(path);
+    ASSERT(prefetch->files[prefetch->nb].path);
+    prefetch->files[prefetch->nb++].fd = fd;
+}
+
+void tcs_prefetch_free(tcs_prefetch_t *prefetch)
+{
+    if (!prefetch)
+        return;
+
+    for (int i = 0; i < prefetch->nb; i++) {
+        if (prefetch->files[i].fd >= 0)
+            close(prefetch->files[i].fd);
+        free(prefetch->files[i].path);
+    }
+    free(prefetch->files);
+    free(prefetch);
+}
+
+/**
+ * Compares two lists of sibling nodes and their subtrees
+ */
+static bool same_nodes(xmlNodePtr a, xmlNodePtr b)
+{
+    for (; a && b; a = a->next, b = b->next) {
+        if ((a->type != b->type) || xmlStrcmp(a->name, b->name) ||
+            xmlStrcmp(a->content, b->content) || !same_nodes(a->children, b->children))
+            return false;
+        if (a->type != XML_ELEMENT_NODE)
+            continue;
+
+        xmlAttrPtr attr_a = a->properties;
+        xmlAttrPtr attr_b = b->properties;
+        for (; attr_a && attr_b; attr_a = attr_a->next, attr_b = attr_b->next)
+            if (xmlStrcmp(attr_a->name, attr_b->name) ||
+                !same_nodes(attr_a->children, attr_b->children))
+                return false;
+        if (attr_a || attr_b)
+            return false;
+    }
+
+    return !a && !b;
+}
+
+/**
+ * Parses an XML buffer
+ *
+ * @param [in] parser Parser backend
+ * @param [in] data   Content of the file
+ * @param [in] size   Size of the content
+ * @param [in] url    Name of the file
+ *
+ * @return the XML document or NULL if the content cannot be parsed
+ */
+xmlDocPtr tcs_xml_parse(tcs_xml_parser_t parser, const char *data, size_t size, const char *url)
+{
+    ASSERT(data);
+    ASSERT(url);
+
+    if (parser == TCS_XML_PARSER_LIBXML2)
+        return xmlReadMemory(data, size, url, NULL, XML_PARSE_NOENT);
+
+    /* files declined by the tokenizer are parsed by libxml2 */
+    xmlDocPtr doc = tcs_tokenizer_parse(data, size, url);
+    if (!doc)
+        return xmlReadMemory(data, size, url, NULL, XML_PARSE_NOENT);
+
+    if (parser == TCS_XML_PARSER_CHECK) {
+        xmlDocPtr ref = xmlReadMemory(data, size, url, NULL, XML_PARSE_NOENT);
+        DASSERT(ref && same_nodes(doc->children, ref->children) &&
+                !xmlStrcmp(doc->version, ref->version) &&
+                !xmlStrcmp(doc->encoding, ref->encoding) &&
+                (doc->standalone == ref->standalone),
+                "file (%s) parsed differently by the built-in tokenizer and libxml2", url);
+        xmlFreeDoc(ref);
+    }
+
+    return doc;
+}
+
+/**
+ * Parses an XML file
+ *
+ * @param [in] parser   Parser backend
+ * @param [in] prefetch Set of prefetched files. Can be NULL
+ * @param [in] path     Path of the file. Opened here if not prefetched
+ *
+ * @return the XML document or NULL if the file cannot be read or parsed
+ */
+xmlDocPtr tcs_xml_read(tcs_xml_parser_t parser, tcs_prefetch_t *prefetch, const char *path)
+{
+    ASSERT(path);
+
+    int fd = -1;
+    for (int i = 0; prefetch && (i < prefetch->nb); i++) {
+        if ((prefetch->files[i].fd >= 0) && !strcmp(prefetch->files[i].path, path)) {
+            fd = prefetch->files[i].fd;
+            prefetch->files[i].fd = -1;
+            break;
+        }
+    }
+    if (fd < 0)
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    xmlDocPtr doc = NULL;
+    struct stat st;
+    if (!fstat(fd, &st) && (st.st_size > 0)) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            doc = tcs_xml_parse(parser, data, st.st_size, path);
+            munmap(data, st.st_size);
+        }
+    }
+    close(fd);
+
+    return doc;
+}
+
+/*
+ * Parsed documents cache
+ *
+ * A file used several times by a context is parsed once. Documents are kept with the size and
+ * modification time of their file and parsed again if the file has changed.
+ */
+
+typedef struct cached_doc {
+    char *path;
+    off_t size;
+    struct timespec mtime;
+    xmlDocPtr doc;
+} cached_doc_t;
+
+struct tcs_doc_cache {
+    int nb;
+    cached_doc_t *docs;
+};
+
+tcs_doc_cache_t *tcs_doc_cache_new(void)
+{
+    tcs_doc_cache_t *cache = calloc(1, sizeof(tcs_doc_cache_t));
+
+    ASSERT(cache);
+    return cache;
+}
+
+void tcs_doc_cache_free(tcs_doc_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    for (int i = 0; i < cache->nb; i++) {
+        xmlFreeDoc(cache->docs[i].doc);
+        free(cache->docs[i].path);
+    }
+    free(cache->docs);
+    free(cache);
+}
+
+/**
+ * Looks for the entry of a file. The entry of a file that has changed is dropped
+ *
+ * @return the index of the entry or -1 if not cached
+ */
+static int cache_lookup(tcs_doc_cache_t *cache, const char *path)
+{
+    for (int i = 0; cache && (i < cache->nb); i++) {
+        cached_doc_t *cached = &cache->docs[i];
+        if (strcmp(cached->path, path))
+            continue;
+
+        struct stat st;
+        if (!stat(path, &st) && (st.st_size == cached->size) &&
+            (st.st_mtim.tv_sec == cached->mtime.tv_sec) &&
+            (st.st_mtim.tv_nsec == cached->mtime.tv_nsec))
+            return i;
+
+        LOGD("file (%s) has changed since it was parsed", path);
+        xmlFreeDoc(cached->doc);
+        free(cached->path);
+        *cached = cache->docs[--cache->nb];
+        return -1;
+    }
+
+    return -1;
+}
+
+/**
+ * Looks for the document of a file. A document whose file has changed is dropped
+ *
+ * @param [in] cache Documents cache. Can be NULL
+ * @param [in] path  Path of the file
+ *
+ * @return the document, still owned by the cache, or NULL if not cached
+ */
+xmlDocPtr tcs_doc_cache_find(tcs_doc_cache_t *cache, const char *path)
+{
+    ASSERT(path);
+
+    int i = cache_lookup(cache, path);
+    return (i < 0) ? NULL : cache->docs[i].doc;
+}
+
+/**
+ * Adds the document of a file to the cache
+ *
+ * @param [in] cache Documents cache
+ * @param [in] path  Path of the file
+ * @param [in] doc   Document parsed from the file. Owned by the cache once added
+ */
+void tcs_doc_cache_add(tcs_doc_cache_t *cache, const char *path, xmlDocPtr doc)
+{
+    ASSERT(cache);
+    ASSERT(path);
+    ASSERT(doc);
+
+    struct stat st;
+    if (stat(path, &st)) {
+        xmlFreeDoc(doc);
+        return;
+    }
+
+    cache->docs = realloc(cache->docs, (cache->nb + 1) * sizeof(cached_doc_t));
+    ASSERT(cache->docs);
+    cached_doc_t *cached = &cache->docs[cache->nb++];
+    cached->path = strdup(path);
+    ASSERT(cached->path);
+    cached->size = st.st_size;
+    cached->mtime = st.st_mtim;
+    cached->doc = doc;
+}
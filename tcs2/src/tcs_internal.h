@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCS_2_INTERNAL_HEADER__
+#define __TCS_2_INTERNAL_HEADER__
+
+#ifndef HOST_BUILD
+#include <cutils/properties.h>
+#endif
+
+#include <libxml/tree.h>
+#include <libxml/parser.h>
+#include <stdarg.h>
+
+#include "tcs.h"
+
+/* ASSERT macro */
+#define xstr(s) str(s)
+#define str(s) #s
+
+#ifdef __GNUC__
+#define likely(x)   __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#else
+#define likely(x)   (x)
+#define unlikely(x) (x)
+#endif
+
+#define DASSERT(exp, format, ...) do { \
+        if (unlikely(!(exp))) { \
+            if (unlikely(format[0] != '\0')) \
+                LOGE("AssertionLog " format, ## __VA_ARGS__); \
+            LOGE("%s:%d Assertion '" xstr(exp) "'", __FILE__, __LINE__); \
+            abort(); \
+        } \
+} while (0)
+
+#define ASSERT(exp) DASSERT(exp, "")
+
+/* XML tags */
+#define ATTR_KEY ((const xmlChar *)"key")
+#define ATTR_NAME ((const xmlChar *)"name")
+#define ATTR_OVERLAY_MODE ((const xmlChar *)"overlay")
+
+#define TAG_GROUP ((const xmlChar *)"group")
+#define TAG_CONFIG ((const xmlChar *)"config")
+#define TAG_LIST ((const xmlChar *)"list")
+#define TAG_STRING ((const xmlChar *)"string")
+#define TAG_INT ((const xmlChar *)"int")
+#define TAG_BOOL ((const xmlChar *)"bool")
+#define TAG_FLAT ((const xmlChar *)"tcs_flat")
+
+static inline xmlNodePtr next_node(xmlNodePtr cur)
+{
+    do
+        cur = cur->next;
+    while ((cur != NULL) && (cur->type != XML_ELEMENT_NODE));
+    return cur;
+}
+
+/* Log functions:
+ * Messages are written asynchronously by a background thread (@see tcs_log.c). Levels below
+ * TCS_LOG_LEVEL are removed at compile time. Errors are always logged.
+ * _RL variants are rate limited per call site: use them for messages that clients can trigger
+ * repeatedly at runtime.
+ */
+#define TCS_LOG_LEVEL_VERBOSE 0
+#define TCS_LOG_LEVEL_DEBUG 1
+#define TCS_LOG_LEVEL_ERROR 2
+
+#ifndef TCS_LOG_LEVEL
+#define TCS_LOG_LEVEL TCS_LOG_LEVEL_VERBOSE
+#endif
+
+#ifndef HOST_BUILD
+
+#include <utils/Log.h>
+
+#define VERBOSE ANDROID_LOG_VERBOSE
+#define DEBUG ANDROID_LOG_DEBUG
+#define ERROR ANDROID_LOG_ERROR
+
+#else
+
+#define DEBUG 'D'
+#define VERBOSE 'V'
+#define ERROR 'E'
+
+#endif
+
+typedef struct tcs_log_ratelimit {
+    unsigned long long window;     // Start of the current window, in ns
+    unsigned int count;            // Messages logged in the current window
+    unsigned int suppressed;       // Messages suppressed in the current window
+} tcs_log_ratelimit_t;
+
+void tcs_log(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void tcs_log_flush(void);
+bool tcs_log_ratelimit(tcs_log_ratelimit_t *rl, unsigned int *suppressed);
+
+#define TCS_LOG(level, format, ...) do { tcs_log(level, format, ## __VA_ARGS__); } while (0)
+
+/* arguments are still type checked but the call is removed */
+#define TCS_LOG_DISABLED(level, format, ...) do { \
+        if (0) \
+            tcs_log(level, format, ## __VA_ARGS__); \
+} while (0)
+
+#define TCS_LOG_RL(level, format, ...) do { \
+        static tcs_log_ratelimit_t rl; \
+        unsigned int suppressed; \
+        if (tcs_log_ratelimit(&rl, &suppressed)) { \
+            if (suppressed) \
+                TCS_LOG(level, "%-30s: %u messages suppressed\n", __FUNCTION__, suppressed); \
+            TCS_LOG(level, format, ## __VA_ARGS__); \
+        } \
+} while (0)
+
+#if TCS_LOG_LEVEL <= TCS_LOG_LEVEL_VERBOSE
+#define LOGV(format, ...) TCS_LOG(VERBOSE, format "\n", ## __VA_ARGS__)
+#else
+#define LOGV(format, ...) TCS_LOG_DISABLED(VERBOSE, format "\n", ## __VA_ARGS__)
+#endif
+
+#if TCS_LOG_LEVEL <= TCS_LOG_LEVEL_DEBUG
+#define LOGD(format, ...) TCS_LOG(DEBUG, "%-30s: " format "\n", __FUNCTION__, ## __VA_ARGS__)
+#define LOGD_RL(format, ...) TCS_LOG_RL(DEBUG, "%-30s: " format "\n", __FUNCTION__, \
+                                        ## __VA_ARGS__)
+#else
+#define LOGD(format, ...) TCS_LOG_DISABLED(DEBUG, "%-30s: " format "\n", __FUNCTION__, \
+                                           ## __VA_ARGS__)
+#define LOGD_RL LOGD
+#endif
+
+#define LOGE(format, ...) TCS_LOG(ERROR, "%-30s: " format "\n", __FUNCTION__, ## __VA_ARGS__)
+#define LOGE_RL(format, ...) TCS_LOG_RL(ERROR, "%-30s: " format "\n", __FUNCTION__, \
+                                        ## __VA_ARGS__)
+
+/* Group index */
+typedef enum tcs_tag {
+    TCS_TAG_GROUP,
+    TCS_TAG_LIST,
+    TCS_TAG_STRING,
+    TCS_TAG_INT,
+    TCS_TAG_BOOL,
+    TCS_TAG_NB
+} tcs_tag_t;
+
+typedef struct tcs_index_entry {
+    unsigned int hash;             // tcs_hash() of the key
+    tcs_tag_t tag;
+    const char *key;               // NULL for a free slot
+    xmlNodePtr node;
+    const char *value;             // Content of a property. NULL for lists and groups
+    const char **list;             // Contents of the elements of a list
+    int nb;                        // Number of elements of a list
+    struct tcs_group *group;       // Frozen configuration only: child group
+} tcs_index_entry_t;
+
+/* Also the group handle given to clients (tcs_group_t) */
+typedef struct tcs_group {
+    struct tcs_group *next;        // Infos are chained in the index that owns them
+    xmlNodePtr node;
+    char *path;                    // Full path of the group. Set when opened as a handle
+    int refs;                      // Number of open handles
+    unsigned int generation;       // Top-level groups only: generation of the group
+    unsigned int index_generation; // Context generation when the index was built
+    unsigned int mask;             // Size of entries - 1
+    tcs_index_entry_t *entries;    // Open addressing hash table
+    unsigned long long *bloom;     // Bloom filter of the entry hashes: 8 bits per slot
+    int nb_owned;
+    xmlChar **owned;               // Strings allocated because not available as is in the tree
+    struct tcs_group *frozen;      // Freezing only: copy already laid out in the mapping
+
+    /* Layered mode only */
+    struct tcs_group *parent;      // Parent group. Set when the index of the parent is built
+    int nb_own_layers;
+    xmlNodePtr *own_layers;        // Overlay groups applied on this group, in order
+    int nb_layers;
+    xmlNodePtr *layers;            // Overlay groups inherited from the parent, then own layers
+} tcs_group_info_t;
+
+/* Frozen configuration: copy of all the group indexes in a single read-only mapping */
+typedef struct tcs_frozen {
+    size_t size;                   // Size of the mapping, starting with this struct
+    tcs_group_info_t *root;        // Configuration root. Groups have no node
+} tcs_frozen_t;
+
+typedef struct tcs_index {
+    tcs_group_info_t *infos;       // Group infos, owned by the index
+    unsigned int generation;       // Context generation. Indexes are rebuilt once it changes
+    bool layered;                  // Overlays are kept as layers instead of merged in the tree
+} tcs_index_t;
+
+const xmlChar *tcs_peek_prop(xmlNodePtr node, const xmlChar *name);
+const xmlChar *tcs_peek_content(xmlNodePtr node);
+tcs_group_info_t *tcs_group_info_get(tcs_index_t *index, xmlNodePtr group);
+tcs_group_info_t *tcs_index_refresh(tcs_index_t *index, xmlNodePtr group);
+const tcs_index_entry_t *tcs_index_lookup(tcs_index_t *index, xmlNodePtr group, tcs_tag_t tag,
+                                          unsigned int hash, const char *key);
+const tcs_index_entry_t *tcs_index_find(const tcs_group_info_t *info, tcs_tag_t tag,
+                                        unsigned int hash, const char *key);
+const xmlChar *tcs_tag_name(tcs_tag_t tag);
+void tcs_index_add_layer(tcs_index_t *index, xmlNodePtr group, xmlNodePtr layer);
+void tcs_index_free(tcs_index_t *index);
+void tcs_index_release(tcs_index_t *index, xmlNodePtr group);
+bool tcs_index_is_open(const tcs_index_t *index, xmlNodePtr group);
+tcs_frozen_t *tcs_index_freeze(tcs_index_t *index, xmlNodePtr root, const xmlNodePtr *hot,
+                               int nb_hot);
+void tcs_frozen_free(tcs_frozen_t *frozen);
+
+/* Overlay manifest */
+#define TCS_MANIFEST_NAME ".tcs_manifest"
+
+typedef struct tcs_manifest_entry {
+    char *file;                    // File name, relative to the overlay folder
+    bool config;                   // True if the root tag is <config>
+    char *groups;                  // Comma separated names of the root groups
+    long long size;                // Fingerprint of the file: size and CRC32 of the content
+    unsigned long crc;
+    bool checked;                  // True once the fingerprint has been checked
+} tcs_manifest_entry_t;
+
+typedef struct tcs_manifest {
+    int nb;
+    tcs_manifest_entry_t *entries; // Sorted in apply order
+} tcs_manifest_t;
+
+tcs_manifest_t *tcs_manifest_load(const char *folder);
+void tcs_manifest_free(tcs_manifest_t *manifest);
+bool tcs_manifest_entry_check(const char *folder, tcs_manifest_entry_t *entry);
+bool tcs_manifest_entry_match(const tcs_manifest_entry_t *entry, const char *group_name,
+                              bool config);
+int tcs_manifest_write(const char *folder);
+
+/* Access profile */
+typedef struct tcs_profile_entry {
+    char *group;                   // Full path of the group
+    char *tag;                     // NULL for a group entry
+    char *key;                     // NULL for a group entry
+} tcs_profile_entry_t;
+
+typedef struct tcs_profile {
+    int nb;
+    int size;
+    tcs_profile_entry_t *entries;  // Sorted in first access order
+    char *cur_group;               // Recording only: last selected group
+} tcs_profile_t;
+
+tcs_profile_t *tcs_profile_new(void);
+tcs_profile_t *tcs_profile_load(const char *path);
+void tcs_profile_free(tcs_profile_t *profile);
+int tcs_profile_write(const tcs_profile_t *profile, const char *path);
+void tcs_profile_record_group(tcs_profile_t *profile, const char *group);
+void tcs_profile_record_key(tcs_profile_t *profile, const xmlChar *tag, const char *key);
+void tcs_profile_record_group_key(tcs_profile_t *profile, const char *group, const xmlChar *tag,
+                                  const char *key);
+
+/* API statistics */
+#ifdef TCS_ENABLE_STATS
+#include <time.h>
+
+#define STATS_START(start) struct timespec start; clock_gettime(CLOCK_MONOTONIC, &start)
+#define STATS_STOP(stats, api, start, hit) tcs_stats_update(stats, api, &start, hit)
+
+void tcs_stats_update(tcs_stats_t *stats, tcs_api_t api, const struct timespec *start, bool hit);
+void tcs_stats_snapshot(tcs_stats_t *stats, tcs_stats_t *snapshot, bool reset);
+void tcs_stats_dump(tcs_stats_t *stats);
+#else
+#define STATS_START(start)
+#define STATS_STOP(stats, api, start, hit)
+#endif
+
+/* Flattened configuration */
+#define TCS_FLAT_FOLDER "flat"
+#define TCS_FLAT_DEFAULT_SW_FOLDER "default"
+
+int tcs_flat_write(tcs_ctx_t *ctx, const char *path);
+int tcs_flat_write_bundle(tcs_ctx_t *ctx, const char *path, bool compress);
+
+/* XML file ingestion */
+typedef enum tcs_xml_parser {
+    TCS_XML_PARSER_LIBXML2,
+    TCS_XML_PARSER_BUILTIN,        // Built-in tokenizer, libxml2 for the files it declines
+    TCS_XML_PARSER_CHECK,          // Built-in tokenizer, checked against libxml2
+} tcs_xml_parser_t;
+
+typedef struct tcs_prefetch tcs_prefetch_t;
+
+tcs_prefetch_t *tcs_prefetch_new(void);
+void tcs_prefetch_add(tcs_prefetch_t *prefetch, const char *path);
+void tcs_prefetch_free(tcs_prefetch_t *prefetch);
+xmlDocPtr tcs_xml_parse(tcs_xml_parser_t parser, const char *data, size_t size, const char *url);
+xmlDocPtr tcs_xml_read(tcs_xml_parser_t parser, tcs_prefetch_t *prefetch, const char *path);
+xmlDocPtr tcs_tokenizer_parse(const char *data, size_t size, const char *url);
+
+typedef struct tcs_doc_cache tcs_doc_cache_t;
+
+tcs_doc_cache_t *tcs_doc_cache_new(void);
+void tcs_doc_cache_free(tcs_doc_cache_t *cache);
+xmlDocPtr tcs_doc_cache_find(tcs_doc_cache_t *cache, const char *path);
+void tcs_doc_cache_add(tcs_doc_cache_t *cache, const char *path, xmlDocPtr doc);
+
+/* Configuration bundle */
+#define TCS_BUNDLE_SUFFIX ".bundle"
+#define TCS_BUNDLE_CONFIG "config"  // Name of the configuration entry
+
+typedef struct tcs_bundle tcs_bundle_t;
+typedef struct tcs_bundle_writer tcs_bundle_writer_t;
+
+tcs_bundle_t *tcs_bundle_open(const char *path);
+void tcs_bundle_close(tcs_bundle_t *bundle);
+const char *tcs_bundle_get_path(const tcs_bundle_t *bundle);
+xmlDocPtr tcs_bundle_read(const tcs_bundle_t *bundle, tcs_xml_parser_t parser, const char *name,
+                          long long *bytes);
+tcs_bundle_writer_t *tcs_bundle_writer_new(bool compress);
+void tcs_bundle_writer_add(tcs_bundle_writer_t *writer, const char *name, xmlNodePtr node);
+int tcs_bundle_writer_save(tcs_bundle_writer_t *writer, const char *path);
+
+#ifdef HOST_BUILD
+#define PROPERTY_VALUE_MAX 92
+
+int property_get(const char *key, char *value, const char *default_value);
+#endif
+
+#endif /* __TCS_2_INTERNAL_HEADER__ */
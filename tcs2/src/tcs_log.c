@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Logging backend
+ *
+ * Callers format their message in a slot of a bounded lock-free ring buffer (multiple producers,
+ * one consumer at a time). A background thread, started at first log, drains the ring and writes
+ * messages to logcat (stdout on host). Error messages flush the ring so that they are written, in
+ * order, before an abort. If the ring is full, the caller drains it itself: messages are never
+ * dropped. Messages longer than a slot are written by the caller once the ring is flushed. The
+ * thread is stopped and joined when the library is unloaded.
+ *
+ * Define TCS_LOG_SYNC to write messages directly from the caller.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+#define TCS_LOG_RING_SIZE 256     // Must be a power of 2
+#define TCS_LOG_MSG_SIZE 256
+
+#define TCS_LOG_RATELIMIT_INTERVAL_NS 1000000000ULL
+#define TCS_LOG_RATELIMIT_BURST 10
+
+static void write_message(int level, const char *msg)
+{
+#ifndef HOST_BUILD
+    __android_log_buf_write(LOG_ID_RADIO, level, "TCS2", msg);
+#else
+    printf("%c: %s", level, msg);
+#endif
+}
+
+static void write_end(void)
+{
+#ifdef HOST_BUILD
+    fflush(stdout);
+#endif
+}
+
+/**
+ * Formats and writes a message from the caller. A message longer than TCS_LOG_MSG_SIZE is
+ * formatted in an allocated buffer
+ */
+static void write_sync(int level, const char *format, va_list args)
+{
+    char msg[TCS_LOG_MSG_SIZE];
+    va_list copy;
+
+    va_copy(copy, args);
+    int len = vsnprintf(msg, sizeof(msg), format, copy);
+    va_end(copy);
+
+    char *long_msg = (len >= (int)sizeof(msg)) ? malloc(len + 1) : NULL;
+    if (long_msg)
+        vsnprintf(long_msg, len + 1, format, args);
+    write_message(level, long_msg ? long_msg : msg);
+    write_end();
+    free(long_msg);
+}
+
+#ifndef TCS_LOG_SYNC
+
+typedef struct log_slot {
+    unsigned int seq;             // Position + 1 once published, position + RING_SIZE once freed
+    int level;
+    bool skip;                    // Message truncated: written by the caller instead
+    char msg[TCS_LOG_MSG_SIZE];
+} log_slot_t;
+
+static log_slot_t g_ring[TCS_LOG_RING_SIZE];
+static unsigned int g_head;       // Next position to write. Shared by producers
+static unsigned int g_tail;       // Next position to read. Protected by g_drain_lock
+
+static pthread_mutex_t g_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static sem_t g_wakeup;
+static int g_sleeping;            // Set by the drain thread before waiting on g_wakeup
+static bool g_started;
+static bool g_stop;               // Set when the library is unloaded
+static pthread_t g_thread;
+
+/**
+ * Writes all published messages. Must be called with g_drain_lock held
+ *
+ * @return number of messages written
+ */
+static int drain(void)
+{
+    int nb = 0;
+
+    for (;; nb++) {
+        log_slot_t *slot = &g_ring[g_tail & (TCS_LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != g_tail + 1)
+            break;
+        if (!slot->skip)
+            write_message(slot->level, slot->msg);
+        __atomic_store_n(&slot->seq, g_tail + TCS_LOG_RING_SIZE, __ATOMIC_RELEASE);
+        g_tail++;
+    }
+    if (nb)
+        write_end();
+
+    return nb;
+}
+
+static void *drain_thread(void *data)
+{
+    (void)data;
+
+    for (;;) {
+        pthread_mutex_lock(&g_drain_lock);
+        int nb = drain();
+        pthread_mutex_unlock(&g_drain_lock);
+        if (nb)
+            continue;
+        if (__atomic_load_n(&g_stop, __ATOMIC_SEQ_CST))
+            break;
+
+        __atomic_store_n(&g_sleeping, 1, __ATOMIC_SEQ_CST);
+        /* a message published before the flag was set would not wake us up: check again */
+        pthread_mutex_lock(&g_drain_lock);
+        nb = drain();
+        pthread_mutex_unlock(&g_drain_lock);
+        if (!nb)
+            while (sem_wait(&g_wakeup) && (errno == EINTR)) ;
+        __atomic_store_n(&g_sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+
+    return NULL;
+}
+
+static void reset(void)
+{
+    for (unsigned int i = 0; i < TCS_LOG_RING_SIZE; i++)
+        g_ring[i].seq = i;
+    g_head = 0;
+    g_tail = 0;
+    g_sleeping = 0;
+    g_stop = false;
+    sem_init(&g_wakeup, 0, 0);
+
+    g_started = pthread_create(&g_thread, NULL, drain_thread, NULL) == 0;
+}
+
+/**
+ * The drain thread does not exist in a forked child: messages inherited from the parent are
+ * discarded (the parent writes them) and a new thread is started
+ */
+static void atfork_child(void)
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    g_drain_lock = lock;
+    sem_destroy(&g_wakeup);
+    reset();
+}
+
+static void init(void)
+{
+    reset();
+    pthread_atfork(NULL, NULL, atfork_child);
+}
+
+/**
+ * The drain thread must not outlive the library: it is stopped and joined, then messages logged
+ * in between are written by the caller
+ */
+static __attribute__((destructor)) void log_exit(void)
+{
+    if (__atomic_exchange_n(&g_started, false, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&g_stop, true, __ATOMIC_SEQ_CST);
+        sem_post(&g_wakeup);
+        pthread_join(g_thread, NULL);
+        sem_destroy(&g_wakeup);
+    }
+    tcs_log_flush();
+}
+
+void tcs_log_flush(void)
+{
+    pthread_mutex_lock(&g_drain_lock);
+    drain();
+    pthread_mutex_unlock(&g_drain_lock);
+}
+
+#else
+
+void tcs_log_flush(void)
+{
+}
+
+#endif /* TCS_LOG_SYNC */
+
+void tcs_log(int level, const char *format, ...)
+{
+    va_list args;
+
+#ifndef TCS_LOG_SYNC
+    pthread_once(&g_once, init);
+
+    while (__atomic_load_n(&g_started, __ATOMIC_SEQ_CST)) {
+        unsigned int pos = __atomic_load_n(&g_head, __ATOMIC_RELAXED);
+        log_slot_t *slot = &g_ring[pos & (TCS_LOG_RING_SIZE - 1)];
+        int diff = (int)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff > 0)
+            continue;   // another producer took this position
+        if (diff < 0) {
+            tcs_log_flush();   // ring full
+            continue;
+        }
+        if (!__atomic_compare_exchange_n(&g_head, &pos, pos + 1, false, __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED))
+            continue;
+
+        va_start(args, format);
+        bool truncated = vsnprintf(slot->msg, sizeof(slot->msg), format, args) >=
+                         (int)sizeof(slot->msg);
+        va_end(args);
+        slot->level = level;
+        slot->skip = truncated;
+        __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&g_sleeping, 0, __ATOMIC_SEQ_CST))
+            sem_post(&g_wakeup);
+        if ((level == ERROR) || truncated)
+            tcs_log_flush();
+        if (!truncated)
+            return;
+        break;
+    }
+#endif
+
+    /* synchronous write: TCS_LOG_SYNC, message too long or the drain thread is not running */
+    va_start(args, format);
+    write_sync(level, format, args);
+    va_end(args);
+}
+
+bool tcs_log_ratelimit(tcs_log_ratelimit_t *rl, unsigned int *suppressed)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    unsigned long long now = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    unsigned long long window = __atomic_load_n(&rl->window, __ATOMIC_RELAXED);
+
+    *suppressed = 0;
+    if ((now - window >= TCS_LOG_RATELIMIT_INTERVAL_NS) &&
+        __atomic_compare_exchange_n(&rl->window, &window, now, false, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED)) {
+        /* new window: report messages suppressed during the previous one */
+        __atomic_store_n(&rl->count, 0, __ATOMIC_RELAXED);
+        *suppressed = __atomic_exchange_n(&rl->suppressed, 0, __ATOMIC_RELAXED);
+    }
+
+    if (__atomic_add_fetch(&rl->count, 1, __ATOMIC_RELAXED) <= TCS_LOG_RATELIMIT_BURST)
+        return true;
+
+    __atomic_fetch_add(&rl->suppressed, 1, __ATOMIC_RELAXED);
+    return false;
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Overlay manifest
+ *
+ * A manifest lists the overlay files of a folder in apply order, with the root groups each file
+ * touches and a fingerprint of its content (size and CRC32). It lets parse_overlay() open only the
+ * files relevant to the group being added, without scanning the folder.
+ *
+ * Manifest format (one entry per line, fields separated by tabulations):
+ *   TCS_MANIFEST<TAB>2
+ *   <file><TAB><size><TAB><crc32><TAB><config|group><TAB><names>
+ *
+ * Timestamps are not used: image builds normalize them. A manifest is loaded once per folder and
+ * per context. It is considered stale, and ignored, if the folder doesn't hold the same number of
+ * files (checked at load, nothing is stat'ed) or if the fingerprint of a listed file doesn't
+ * match. Only the files touching a group being added are fingerprinted, once, right before they
+ * are parsed: the other files are never opened.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+#define MANIFEST_MAGIC "TCS_MANIFEST"
+#define MANIFEST_VERSION 2
+#define MANIFEST_SEPARATOR "\t"
+
+/**
+ * Computes the fingerprint of a file
+ *
+ * @param [in]  path Path of the file
+ * @param [out] size Size of the file
+ * @param [out] crc  CRC32 of the content
+ *
+ * @return 0 if successful
+ */
+static int fingerprint(const char *path, long long *size, unsigned long *crc)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    char buf[4096];
+    ssize_t len;
+    *size = 0;
+    *crc = crc32(0L, Z_NULL, 0);
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        *crc = crc32(*crc, (const Bytef *)buf, len);
+        *size += len;
+    }
+    close(fd);
+
+    return (len < 0) ? -1 : 0;
+}
+
+/**
+ * Counts the files of a folder, as listed by tcs_manifest_write(). Nothing is stat'ed
+ */
+static int count_files(const char *folder)
+{
+    DIR *dir = opendir(folder);
+    if (!dir)
+        return -1;
+
+    int nb = 0;
+    for (struct dirent *entry = readdir(dir); entry; entry = readdir(dir))
+        if ((*entry->d_name != '.') && (entry->d_type != DT_DIR))
+            nb++;
+    closedir(dir);
+
+    return nb;
+}
+
+static char *read_file(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+
+    if (!fp)
+        return NULL;
+
+    char *data = NULL;
+    struct stat st;
+    if (!fstat(fileno(fp), &st)) {
+        data = malloc(st.st_size + 1);
+        ASSERT(data);
+        if (fread(data, 1, st.st_size, fp) == (size_t)st.st_size) {
+            data[st.st_size] = '\0';
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(fp);
+
+    return data;
+}
+
+static bool parse_entry(char *line, tcs_manifest_entry_t *entry)
+{
+    char *save = NULL;
+    char *file = strtok_r(line, MANIFEST_SEPARATOR, &save);
+    char *size = strtok_r(NULL, MANIFEST_SEPARATOR, &save);
+    char *crc = strtok_r(NULL, MANIFEST_SEPARATOR, &save);
+    char *tag = strtok_r(NULL, MANIFEST_SEPARATOR, &save);
+    char *groups = strtok_r(NULL, MANIFEST_SEPARATOR, &save);
+
+    if (!file || !size || !crc || !tag || !groups)
+        return false;
+
+    entry->size = strtoll(size, NULL, 10);
+    entry->crc = strtoul(crc, NULL, 10);
+    entry->file = strdup(file);
+    entry->groups = strdup(groups);
+    ASSERT(entry->file);
+    ASSERT(entry->groups);
+    entry->config = !xmlStrcmp((const xmlChar *)tag, TAG_CONFIG);
+
+    return true;
+}
+
+/**
+ * Loads the manifest of an overlay folder
+ *
+ * @param [in] folder Overlay folder
+ *
+ * @return a valid manifest or NULL if the manifest is missing or stale
+ */
+tcs_manifest_t *tcs_manifest_load(const char *folder)
+{
+    ASSERT(folder);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", folder, TCS_MANIFEST_NAME);
+
+    char *data = read_file(path);
+    if (!data)
+        return NULL;
+
+    tcs_manifest_t *manifest = calloc(1, sizeof(tcs_manifest_t));
+    ASSERT(manifest);
+
+    int nb_lines = 0;
+    for (char *cur = data; *cur; cur++)
+        if (*cur == '\n')
+            nb_lines++;
+    if (nb_lines > 1) {
+        manifest->entries = calloc(nb_lines - 1, sizeof(tcs_manifest_entry_t));
+        ASSERT(manifest->entries);
+    }
+
+    char *save = NULL;
+    char *line = strtok_r(data, "\n", &save);
+    char header[32];
+    snprintf(header, sizeof(header), MANIFEST_MAGIC MANIFEST_SEPARATOR "%d", MANIFEST_VERSION);
+    bool valid = line && !strcmp(line, header);
+
+    while (valid && (line = strtok_r(NULL, "\n", &save)) != NULL) {
+        ASSERT(manifest->nb < nb_lines - 1);
+        valid = parse_entry(line, &manifest->entries[manifest->nb]);
+        if (valid)
+            manifest->nb++;
+    }
+    free(data);
+
+    if (valid && (count_files(folder) != manifest->nb)) {
+        LOGD("files added to or removed from folder (%s)", folder);
+        valid = false;
+    }
+
+    if (!valid) {
+        LOGD("manifest (%s) is stale or corrupted. Ignored", path);
+        tcs_manifest_free(manifest);
+        manifest = NULL;
+    }
+
+    return manifest;
+}
+
+void tcs_manifest_free(tcs_manifest_t *manifest)
+{
+    if (!manifest)
+        return;
+
+    for (int i = 0; i < manifest->nb; i++) {
+        free(manifest->entries[i].file);
+        free(manifest->entries[i].groups);
+    }
+    free(manifest->entries);
+    free(manifest);
+}
+
+/**
+ * Checks the fingerprint of a manifest entry. The file is read at the first call only
+ *
+ * @param [in] folder Overlay folder of the manifest
+ * @param [in] entry  Manifest entry
+ *
+ * @return true if the file content matches the manifest
+ */
+bool tcs_manifest_entry_check(const char *folder, tcs_manifest_entry_t *entry)
+{
+    ASSERT(folder);
+    ASSERT(entry);
+
+    if (entry->checked)
+        return true;
+
+    char path[256];
+    long long size;
+    unsigned long crc;
+    snprintf(path, sizeof(path), "%s/%s", folder, entry->file);
+    if (fingerprint(path, &size, &crc) || (size != entry->size) || (crc != entry->crc)) {
+        LOGD("fingerprint mismatch for file (%s)", path);
+        return false;
+    }
+    entry->checked = true;
+
+    return true;
+}
+
+/**
+ * Checks if a manifest entry must be applied
+ *
+ * @param [in] entry      Manifest entry
+ * @param [in] group_name Name of the group being added
+ * @param [in] config     True if the configuration overlay is being applied
+ *
+ * @return true if the file touches the group
+ */
+bool tcs_manifest_entry_match(const tcs_manifest_entry_t *entry, const char *group_name,
+                              bool config)
+{
+    ASSERT(entry);
+    ASSERT(group_name);
+
+    if (config)
+        return entry->config;
+    if (entry->config)
+        return false;
+
+    size_t len = strlen(group_name);
+    for (const char *cur = entry->groups; cur; cur = strchr(cur, ',')) {
+        if (*cur == ',')
+            cur++;
+        if (!strncmp(cur, group_name, len) && ((cur[len] == ',') || (cur[len] == '\0')))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Writes the manifest of an overlay folder. Used by host tools.
+ *
+ * @param [in] folder Overlay folder
+ *
+ * @return 0 if successful
+ */
+int tcs_manifest_write(const char *folder)
+{
+    ASSERT(folder);
+
+    struct dirent **list = NULL;
+    int nb = scandir(folder, &list, NULL, alphasort);
+    if (nb < 0) {
+        LOGE("Failed to scan folder (%s). Reason: %s", folder, strerror(errno));
+        return -1;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", folder, TCS_MANIFEST_NAME);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        LOGE("Failed to create manifest (%s). Reason: %s", path, strerror(errno));
+        for (int i = 0; i < nb; i++)
+            free(list[i]);
+        free(list);
+        return -1;
+    }
+
+    int ret = 0;
+    fprintf(fp, MANIFEST_MAGIC MANIFEST_SEPARATOR "%d\n", MANIFEST_VERSION);
+    for (int i = 0; i < nb; i++) {
+        const char *file = list[i]->d_name;
+        char xml_file[256];
+        struct stat st;
+        long long size;
+        unsigned long crc;
+
+        snprintf(xml_file, sizeof(xml_file), "%s/%s", folder, file);
+        if ((*file == '.') || stat(xml_file, &st) || !S_ISREG(st.st_mode)) {
+            free(list[i]);
+            continue;
+        }
+
+        xmlDocPtr doc = xmlReadFile(xml_file, NULL, XML_PARSE_NOENT);
+        if (!doc || strpbrk(file, MANIFEST_SEPARATOR "\n") || fingerprint(xml_file, &size, &crc)) {
+            LOGE("File (%s) cannot be added to the manifest", xml_file);
+            xmlFreeDoc(doc);
+            free(list[i]);
+            ret = -1;
+            continue;
+        }
+
+        xmlNodePtr node = xmlDocGetRootElement(doc);
+        fprintf(fp, "%s" MANIFEST_SEPARATOR "%lld" MANIFEST_SEPARATOR "%lu" MANIFEST_SEPARATOR
+                "%s" MANIFEST_SEPARATOR, file, size, crc, node->name);
+
+        bool first = true;
+        for (; node; node = node->next) {
+            if ((node->type != XML_ELEMENT_NODE) || xmlStrcmp(node->name, TAG_GROUP))
+                continue;
+            xmlChar *name = xmlGetProp(node, ATTR_NAME);
+            if (name) {
+                fprintf(fp, "%s%s", first ? "" : ",", name);
+                first = false;
+            }
+            xmlFree(name);
+        }
+        fprintf(fp, "%s\n", first ? "-" : "");
+
+        xmlFreeDoc(doc);
+        free(list[i]);
+    }
+    free(list);
+
+    if (fclose(fp)) {
+        LOGE("Failed to write manifest (%s). Reason: %s", path, strerror(errno));
+        ret = -1;
+    }
+
+    return ret;
+}
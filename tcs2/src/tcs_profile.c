@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Access profile
+ *
+ * A profile lists the groups and keys accessed by a process, in first access order. It is
+ * recorded in debug mode. When persist.tcs.profile is set, hot groups are laid out first in the
+ * frozen configuration, in first access order: startup lookups then touch a few pages only.
+ *
+ * Profile format (one entry per line, fields separated by tabulations):
+ *   TCS_PROFILE<TAB>1
+ *   <group path>                      group entry
+ *   <group path><TAB><tag><TAB><key>  key entry (tag: int, bool, string or list)
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+#define PROFILE_MAGIC "TCS_PROFILE"
+#define PROFILE_VERSION 1
+#define PROFILE_SEPARATOR "\t"
+
+static bool is_same_entry(const tcs_profile_entry_t *entry, const char *group, const char *tag,
+                          const char *key)
+{
+    if (strcmp(entry->group, group))
+        return false;
+    if (!entry->key || !key)
+        return !entry->key && !key;
+    return !strcmp(entry->tag, tag) && !strcmp(entry->key, key);
+}
+
+static void add_entry(tcs_profile_t *profile, const char *group, const char *tag, const char *key)
+{
+    for (int i = 0; i < profile->nb; i++)
+        if (is_same_entry(&profile->entries[i], group, tag, key))
+            return;
+
+    if (profile->nb == profile->size) {
+        profile->size = profile->size ? 2 * profile->size : 32;
+        profile->entries = realloc(profile->entries, profile->size * sizeof(tcs_profile_entry_t));
+        ASSERT(profile->entries);
+    }
+
+    tcs_profile_entry_t *entry = &profile->entries[profile->nb++];
+    entry->group = strdup(group);
+    ASSERT(entry->group);
+    entry->tag = entry->key = NULL;
+    if (key) {
+        entry->tag = strdup(tag);
+        entry->key = strdup(key);
+        ASSERT(entry->tag);
+        ASSERT(entry->key);
+    }
+}
+
+tcs_profile_t *tcs_profile_new(void)
+{
+    tcs_profile_t *profile = calloc(1, sizeof(tcs_profile_t));
+
+    ASSERT(profile);
+    return profile;
+}
+
+void tcs_profile_free(tcs_profile_t *profile)
+{
+    if (!profile)
+        return;
+
+    for (int i = 0; i < profile->nb; i++) {
+        free(profile->entries[i].group);
+        free(profile->entries[i].tag);
+        free(profile->entries[i].key);
+    }
+    free(profile->entries);
+    free(profile->cur_group);
+    free(profile);
+}
+
+/**
+ * Loads a profile
+ *
+ * @param [in] path Profile file
+ *
+ * @return a valid profile or NULL if the file is missing or corrupted
+ */
+tcs_profile_t *tcs_profile_load(const char *path)
+{
+    ASSERT(path);
+
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return NULL;
+
+    char line[512];
+    char header[32];
+    snprintf(header, sizeof(header), PROFILE_MAGIC PROFILE_SEPARATOR "%d\n", PROFILE_VERSION);
+
+    tcs_profile_t *profile = NULL;
+    if (fgets(line, sizeof(line), fp) && !strcmp(line, header)) {
+        profile = tcs_profile_new();
+        while (fgets(line, sizeof(line), fp)) {
+            char *save = NULL;
+            line[strcspn(line, "\n")] = '\0';
+            char *group = strtok_r(line, PROFILE_SEPARATOR, &save);
+            char *tag = strtok_r(NULL, PROFILE_SEPARATOR, &save);
+            char *key = strtok_r(NULL, PROFILE_SEPARATOR, &save);
+            if (group && (!tag == !key))
+                add_entry(profile, group, tag, key);
+        }
+        LOGD("profile (%s) loaded: %d entries", path, profile->nb);
+    } else {
+        LOGE("profile (%s) is corrupted. Ignored", path);
+    }
+    fclose(fp);
+
+    return profile;
+}
+
+/**
+ * Writes a profile
+ *
+ * @param [in] profile Recorded profile
+ * @param [in] path    Profile file
+ *
+ * @return 0 if successful
+ */
+int tcs_profile_write(const tcs_profile_t *profile, const char *path)
+{
+    ASSERT(profile);
+    ASSERT(path);
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        LOGE("Failed to create profile (%s)", path);
+        return -1;
+    }
+
+    fprintf(fp, PROFILE_MAGIC PROFILE_SEPARATOR "%d\n", PROFILE_VERSION);
+    for (int i = 0; i < profile->nb; i++) {
+        const tcs_profile_entry_t *entry = &profile->entries[i];
+        if (entry->key)
+            fprintf(fp, "%s" PROFILE_SEPARATOR "%s" PROFILE_SEPARATOR "%s\n", entry->group,
+                    entry->tag, entry->key);
+        else
+            fprintf(fp, "%s\n", entry->group);
+    }
+
+    int ret = fclose(fp) ? -1 : 0;
+    if (!ret)
+        LOGD("profile (%s) written: %d entries", path, profile->nb);
+
+    return ret;
+}
+
+/**
+ * Records the selection of a group. Following keys are recorded in this group
+ *
+ * @param [in] profile Recorded profile
+ * @param [in] group   Full path of the group
+ */
+void tcs_profile_record_group(tcs_profile_t *profile, const char *group)
+{
+    ASSERT(profile);
+    ASSERT(group);
+
+    free(profile->cur_group);
+    profile->cur_group = strdup(group);
+    ASSERT(profile->cur_group);
+    add_entry(profile, group, NULL, NULL);
+}
+
+/**
+ * Records the access to a key of the current group
+ *
+ * @param [in] profile Recorded profile
+ * @param [in] tag     Tag of the key (int, bool, string or list)
+ * @param [in] key     Name of the key
+ */
+void tcs_profile_record_key(tcs_profile_t *profile, const xmlChar *tag, const char *key)
+{
+    ASSERT(profile);
+    ASSERT(tag);
+    ASSERT(key);
+
+    if (profile->cur_group)
+        add_entry(profile, profile->cur_group, (const char *)tag, key);
+}
+
+/**
+ * Records the access to a key of a given group. The current group is not changed
+ *
+ * @param [in] profile Recorded profile
+ * @param [in] group   Full path of the group
+ * @param [in] tag     Tag of the key (int, bool, string or list)
+ * @param [in] key     Name of the key
+ */
+void tcs_profile_record_group_key(tcs_profile_t *profile, const char *group, const xmlChar *tag,
+                                  const char *key)
+{
+    ASSERT(profile);
+    ASSERT(group);
+    ASSERT(tag);
+    ASSERT(key);
+
+    add_entry(profile, group, NULL, NULL);
+    add_entry(profile, group, (const char *)tag, key);
+}
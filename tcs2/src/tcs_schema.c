@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Schema loader
+ *
+ * Fills the structs generated by tcs2_codegen. Only the public API is used: the root group is
+ * opened by path, each group of the schema is then reached from it with one hashed lookup per
+ * path element, and each field is read with one hashed getter. All the handles are closed before
+ * returning.
+ */
+
+#include <string.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+#define FIELD(data, offset, type) ((type *)((char *)(data) + (offset)))
+
+static bool load_field(tcs_ctx_t *ctx, bool selected, const tcs_field_t *field, void *data)
+{
+    switch (field->type) {
+    case TCS_FIELD_INT:
+        return selected &&
+               !ctx->get_int_hashed(ctx, field->hash, field->key, FIELD(data, field->offset, int));
+    case TCS_FIELD_BOOL:
+        return selected &&
+               !ctx->get_bool_hashed(ctx, field->hash, field->key,
+                                     FIELD(data, field->offset, bool));
+    case TCS_FIELD_STRING: {
+        const char *value = selected ? ctx->peek_string(ctx, field->hash, field->key) : NULL;
+        if (value) {
+            *FIELD(data, field->offset, char *) = strdup(value);
+            ASSERT(*FIELD(data, field->offset, char *));
+        }
+        return value != NULL;
+    }
+    case TCS_FIELD_STRING_ARRAY: {
+        int nb = 0;
+        const char *const *list = selected ?
+                                  ctx->peek_string_array(ctx, field->hash, field->key, &nb) : NULL;
+        if (list) {
+            char **array = malloc(nb * sizeof(char *));
+            ASSERT(array);
+            for (int i = 0; i < nb; i++) {
+                array[i] = strdup(list[i]);
+                ASSERT(array[i]);
+            }
+            *FIELD(data, field->offset, char **) = array;
+            *FIELD(data, field->nb_offset, int) = nb;
+        }
+        return list != NULL;
+    }
+    default:
+        ASSERT(0);
+    }
+}
+
+static void load_default(const tcs_field_t *field, void *data)
+{
+    switch (field->type) {
+    case TCS_FIELD_INT:
+        *FIELD(data, field->offset, int) = field->default_int;
+        break;
+    case TCS_FIELD_BOOL:
+        *FIELD(data, field->offset, bool) = field->default_int != 0;
+        break;
+    case TCS_FIELD_STRING:
+        if (field->default_string) {
+            *FIELD(data, field->offset, char *) = strdup(field->default_string);
+            ASSERT(*FIELD(data, field->offset, char *));
+        }
+        break;
+    case TCS_FIELD_STRING_ARRAY:
+        break;
+    default:
+        ASSERT(0);
+    }
+}
+
+/**
+ * @see tcs.h
+ */
+int tcs2_load(tcs_ctx_t *ctx, const char *root, const tcs_schema_t *schema, void *data)
+{
+    int ret = 0;
+
+    ASSERT(ctx);
+    ASSERT(root);
+    ASSERT(schema);
+    ASSERT(data);
+
+    tcs_group_t *root_group = ctx->open_group(ctx, root);
+    for (int i = 0; i < schema->nb_groups; i++) {
+        const tcs_schema_group_t *group = &schema->groups[i];
+
+        tcs_group_t *handle = root_group;
+        for (int j = 0; handle && (j < group->nb_elements); j++) {
+            tcs_group_t *parent = handle;
+            handle = ctx->open_group_hashed(ctx, parent, group->elements[j].hash,
+                                            group->elements[j].name);
+            if (parent != root_group)
+                ctx->close_group(ctx, parent);
+        }
+        bool selected = handle && (ctx->select_group_handle(ctx, handle) == 0);
+        if (handle != root_group)
+            ctx->close_group(ctx, handle);
+
+        for (int j = 0; j < group->nb_fields; j++) {
+            const tcs_field_t *field = &group->fields[j];
+            if (load_field(ctx, selected, field, data))
+                continue;
+
+            if (field->required) {
+                LOGE("Required key (%s) not found in group (%s%s%s)", field->key, root,
+                     (*group->path && strcmp(root, ".")) ? "." : "", group->path);
+                ret = -1;
+            } else if (field->has_default) {
+                load_default(field, data);
+            }
+        }
+    }
+    /* handles are released: groups can be evicted in budget mode */
+    ctx->close_group(ctx, root_group);
+
+    return ret;
+}
+
+/**
+ * @see tcs.h
+ */
+void tcs2_unload(const tcs_schema_t *schema, void *data)
+{
+    ASSERT(schema);
+    ASSERT(data);
+
+    for (int i = 0; i < schema->nb_groups; i++) {
+        const tcs_schema_group_t *group = &schema->groups[i];
+        for (int j = 0; j < group->nb_fields; j++) {
+            const tcs_field_t *field = &group->fields[j];
+            if (field->type == TCS_FIELD_STRING) {
+                free(*FIELD(data, field->offset, char *));
+                *FIELD(data, field->offset, char *) = NULL;
+            } else if (field->type == TCS_FIELD_STRING_ARRAY) {
+                char **array = *FIELD(data, field->offset, char **);
+                for (int k = 0; array && (k < *FIELD(data, field->nb_offset, int)); k++)
+                    free(array[k]);
+                free(array);
+                *FIELD(data, field->offset, char **) = NULL;
+                *FIELD(data, field->nb_offset, int) = 0;
+            }
+        }
+    }
+}
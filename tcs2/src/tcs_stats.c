@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * API statistics
+ *
+ * Counters are updated with atomic operations: getters can be called from several threads once
+ * the configuration is loaded. Compiled only if TCS_ENABLE_STATS is defined.
+ */
+
+#ifdef TCS_ENABLE_STATS
+
+#include <string.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+static const char *const api_names[TCS_API_NB] = {
+    [TCS_API_ADD_GROUP] = "add_group",
+    [TCS_API_SELECT_GROUP] = "select_group",
+    [TCS_API_GET_BOOL] = "get_bool",
+    [TCS_API_GET_INT] = "get_int",
+    [TCS_API_GET_STRING] = "get_string",
+    [TCS_API_GET_STRING_ARRAY] = "get_string_array",
+    [TCS_API_OPEN_GROUP] = "open_group",
+    [TCS_API_QUERY] = "query",
+};
+
+void tcs_stats_update(tcs_stats_t *stats, tcs_api_t api, const struct timespec *start, bool hit)
+{
+    struct timespec end;
+
+    ASSERT(stats);
+    ASSERT(api < TCS_API_NB);
+    ASSERT(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    unsigned long long ns = (end.tv_sec - start->tv_sec) * 1000000000ULL + end.tv_nsec -
+                            start->tv_nsec;
+
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (bucket >= TCS_STATS_HISTOGRAM_SIZE)
+        bucket = TCS_STATS_HISTOGRAM_SIZE - 1;
+
+    tcs_api_stats_t *cur = &stats->api[api];
+    __atomic_fetch_add(&cur->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(hit ? &cur->hits : &cur->misses, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cur->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cur->histogram[bucket], 1, __ATOMIC_RELAXED);
+}
+
+void tcs_stats_snapshot(tcs_stats_t *stats, tcs_stats_t *snapshot, bool reset)
+{
+    ASSERT(stats);
+    /* snapshot can be NULL */
+
+    for (int i = 0; i < TCS_API_NB; i++) {
+        tcs_api_stats_t *cur = &stats->api[i];
+        tcs_api_stats_t tmp;
+
+        if (reset) {
+            tmp.calls = __atomic_exchange_n(&cur->calls, 0, __ATOMIC_RELAXED);
+            tmp.hits = __atomic_exchange_n(&cur->hits, 0, __ATOMIC_RELAXED);
+            tmp.misses = __atomic_exchange_n(&cur->misses, 0, __ATOMIC_RELAXED);
+            tmp.total_ns = __atomic_exchange_n(&cur->total_ns, 0, __ATOMIC_RELAXED);
+            for (int j = 0; j < TCS_STATS_HISTOGRAM_SIZE; j++)
+                tmp.histogram[j] = __atomic_exchange_n(&cur->histogram[j], 0, __ATOMIC_RELAXED);
+        } else {
+            tmp.calls = __atomic_load_n(&cur->calls, __ATOMIC_RELAXED);
+            tmp.hits = __atomic_load_n(&cur->hits, __ATOMIC_RELAXED);
+            tmp.misses = __atomic_load_n(&cur->misses, __ATOMIC_RELAXED);
+            tmp.total_ns = __atomic_load_n(&cur->total_ns, __ATOMIC_RELAXED);
+            for (int j = 0; j < TCS_STATS_HISTOGRAM_SIZE; j++)
+                tmp.histogram[j] = __atomic_load_n(&cur->histogram[j], __ATOMIC_RELAXED);
+        }
+
+        if (snapshot)
+            snapshot->api[i] = tmp;
+    }
+}
+
+void tcs_stats_dump(tcs_stats_t *stats)
+{
+    tcs_stats_t snapshot;
+
+    ASSERT(stats);
+
+    tcs_stats_snapshot(stats, &snapshot, false);
+    for (int i = 0; i < TCS_API_NB; i++) {
+        const tcs_api_stats_t *cur = &snapshot.api[i];
+        if (!cur->calls)
+            continue;
+
+        LOGD("%-16s calls: %lu hits: %lu misses: %lu mean: %llu ns", api_names[i], cur->calls,
+             cur->hits, cur->misses, cur->total_ns / cur->calls);
+
+        char histogram[TCS_STATS_HISTOGRAM_SIZE * 16];
+        size_t len = 0;
+        for (int j = 0; (j < TCS_STATS_HISTOGRAM_SIZE) && (len < sizeof(histogram)); j++)
+            if (cur->histogram[j])
+                len += snprintf(histogram + len, sizeof(histogram) - len, " [2^%d]:%lu", j,
+                                cur->histogram[j]);
+        LOGD("%-16s histogram (ns):%s", api_names[i], len ? histogram : " none");
+    }
+}
+
+#endif /* TCS_ENABLE_STATS */
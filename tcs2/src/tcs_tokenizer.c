@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Built-in XML tokenizer
+ *
+ * TCS files only use a small XML subset: elements, attributes, text, comments, processing
+ * instructions and the predefined and character entities. This tokenizer scans such a file in
+ * place, in the mapped buffer, and builds the tree directly, without the general libxml2 parser
+ * (input buffers, SAX callbacks, entity handling). The tree is the one libxml2 builds with
+ * XML_PARSE_NOENT: blank text nodes are kept, entities are substituted, line ends and attribute
+ * values are normalized.
+ *
+ * Anything else (DOCTYPE, CDATA sections, namespaces, other entities or encodings) and malformed
+ * files are declined: the caller then parses the file with libxml2, which reports the errors.
+ */
+
+#include <libxml/parserInternals.h>
+#include <string.h>
+
+#include "tcs.h"
+#include "tcs_internal.h"
+
+typedef struct tokenizer {
+    const char *cur;
+    const char *end;
+    xmlDocPtr doc;
+    xmlChar *buf;                  // Decoded string
+} tokenizer_t;
+
+typedef enum decode_mode {
+    DECODE_TEXT,                   // Entities are substituted
+    DECODE_ATTR,                   // Entities are substituted, blanks are replaced by spaces
+    DECODE_RAW,                    // Comments and processing instructions: taken as is
+} decode_mode_t;
+
+static inline bool is_blank(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+static inline bool is_name_char(char c)
+{
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+           ((c >= '0') && (c <= '9')) || (c == '_') || (c == '-') || (c == '.');
+}
+
+static void skip_blanks(tokenizer_t *t)
+{
+    while ((t->cur < t->end) && is_blank(*t->cur))
+        t->cur++;
+}
+
+static bool starts_with(const tokenizer_t *t, const char *str)
+{
+    size_t len = strlen(str);
+
+    return ((size_t)(t->end - t->cur) >= len) && !memcmp(t->cur, str, len);
+}
+
+static const char *search(const char *start, const char *end, const char *str)
+{
+    size_t len = strlen(str);
+
+    for (const char *cur = start; (cur = memchr(cur, *str, end - cur)) != NULL; cur++) {
+        if ((size_t)(end - cur) < len)
+            return NULL;
+        if (!memcmp(cur, str, len))
+            return cur;
+    }
+    return NULL;
+}
+
+static const char *find(const tokenizer_t *t, const char *str)
+{
+    return search(t->cur, t->end, str);
+}
+
+/**
+ * Reads an ASCII name. Names with a namespace prefix are declined
+ *
+ * @return the name, owned by the dictionary of the document, or NULL
+ */
+static const xmlChar *read_name(tokenizer_t *t)
+{
+    const char *start = t->cur;
+
+    if ((t->cur >= t->end) || !is_name_char(*t->cur) || ((*t->cur >= '0') && (*t->cur <= '9')) ||
+        (*t->cur == '-') || (*t->cur == '.'))
+        return NULL;
+    while ((t->cur < t->end) && is_name_char(*t->cur))
+        t->cur++;
+    if ((t->cur < t->end) && ((*t->cur == ':') || ((unsigned char)*t->cur >= 0x80)))
+        return NULL;
+
+    return xmlDictLookup(t->doc->dict, (const xmlChar *)start, t->cur - start);
+}
+
+/**
+ * Substitutes a predefined entity or a character reference
+ *
+ * @param [in, out] cur Beginning of the reference. Moved after it
+ * @param [in]      end End of the string
+ * @param [in, out] out Output. Moved after the substituted character
+ *
+ * @return false if the reference is declined
+ */
+static bool decode_reference(const char **cur, const char *end, xmlChar **out)
+{
+    static const struct {
+        const char *name;
+        char value;
+    } entities[] = {
+        { "lt;", '<' }, { "gt;", '>' }, { "amp;", '&' }, { "quot;", '"' }, { "apos;", '\'' },
+    };
+    const char *str = *cur + 1;
+
+    if ((str >= end) || (*str != '#')) {
+        for (size_t i = 0; i < sizeof(entities) / sizeof(entities[0]); i++) {
+            size_t len = strlen(entities[i].name);
+            if (((size_t)(end - str) >= len) && !memcmp(str, entities[i].name, len)) {
+                *(*out)++ = entities[i].value;
+                *cur = str + len;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char *semicolon = memchr(str, ';', end - str);
+    bool hex = (str + 1 < end) && (str[1] == 'x');
+    const char *digit = str + (hex ? 2 : 1);
+    if (!semicolon || (digit >= semicolon))
+        return false;
+
+    unsigned long value = 0;
+    for (; digit < semicolon; digit++) {
+        int v;
+        if ((*digit >= '0') && (*digit <= '9'))
+            v = *digit - '0';
+        else if (hex && (*digit >= 'a') && (*digit <= 'f'))
+            v = *digit - 'a' + 10;
+        else if (hex && (*digit >= 'A') && (*digit <= 'F'))
+            v = *digit - 'A' + 10;
+        else
+            return false;
+        value = value * (hex ? 16 : 10) + v;
+        if (value > 0x10FFFF)
+            return false;
+    }
+    /* characters allowed by XML */
+    if (!((value == 0x9) || (value == 0xA) || (value == 0xD) ||
+          ((value >= 0x20) && (value <= 0xD7FF)) || ((value >= 0xE000) && (value <= 0xFFFD)) ||
+          (value >= 0x10000)))
+        return false;
+
+    *out += xmlCopyCharMultiByte(*out, value);
+    *cur = semicolon + 1;
+    return true;
+}
+
+/**
+ * Decodes a string in t->buf. Line ends are normalized
+ *
+ * @return the length of the decoded string or -1 if declined
+ */
+static int decode(tokenizer_t *t, const char *start, const char *end, decode_mode_t mode)
+{
+    xmlChar *out = t->buf;
+    bool ascii = true;
+
+    for (const char *cur = start; cur < end;) {
+        char c = *cur++;
+        if ((c == '&') && (mode != DECODE_RAW)) {
+            cur--;
+            if (!decode_reference(&cur, end, &out))
+                return -1;
+            ascii = false;
+            continue;
+        }
+        if ((c == '<') && (mode != DECODE_RAW))
+            return -1;
+        if (c == '\r') {
+            c = '\n';
+            if ((cur < end) && (*cur == '\n'))
+                cur++;
+        }
+        if ((mode == DECODE_ATTR) && is_blank(c))
+            c = ' ';
+        ascii &= (unsigned char)c < 0x80;
+        *out++ = c;
+    }
+    *out = '\0';
+
+    if (!ascii && !xmlCheckUTF8(t->buf))
+        return -1;
+
+    return out - t->buf;
+}
+
+static bool read_text(tokenizer_t *t, xmlNodePtr parent)
+{
+    const char *start = t->cur;
+    const char *end = memchr(start, '<', t->end - start);
+
+    t->cur = end ? end : t->end;
+    if (parent == (xmlNodePtr)t->doc) {
+        /* only blanks outside the root element */
+        for (const char *c = start; c < t->cur; c++)
+            if (!is_blank(*c))
+                return false;
+        return true;
+    }
+
+    int len = decode(t, start, t->cur, DECODE_TEXT);
+    if ((len < 0) || search(start, t->cur, "]]>"))
+        return false;
+    xmlNodePtr text = xmlNewDocTextLen(t->doc, t->buf, len);
+    ASSERT(text);
+    ASSERT(xmlAddChild(parent, text));
+
+    return true;
+}
+
+static bool read_comment(tokenizer_t *t, xmlNodePtr parent)
+{
+    t->cur += strlen("<!--");
+    const char *end = find(t, "-->");
+    if (!end || search(t->cur, end, "--") || ((end > t->cur) && (end[-1] == '-')) ||
+        (decode(t, t->cur, end, DECODE_RAW) < 0))
+        return false;
+
+    xmlNodePtr comment = xmlNewDocComment(t->doc, t->buf);
+    ASSERT(comment);
+    ASSERT(xmlAddChild(parent, comment));
+    t->cur = end + strlen("-->");
+
+    return true;
+}
+
+static bool read_pi(tokenizer_t *t, xmlNodePtr parent)
+{
+    t->cur += strlen("<?");
+    const xmlChar *target = read_name(t);
+    if (!target || !xmlStrcasecmp(target, (const xmlChar *)"xml"))
+        return false;
+
+    const char *end = find(t, "?>");
+    if (!end || ((t->cur < end) && !is_blank(*t->cur)))
+        return false;
+    skip_blanks(t);
+    if ((t->cur < end) && (decode(t, t->cur, end, DECODE_RAW) < 0))
+        return false;
+
+    xmlNodePtr pi = xmlNewDocPI(t->doc, target, (t->cur < end) ? t->buf : NULL);
+    ASSERT(pi);
+    ASSERT(xmlAddChild(parent, pi));
+    t->cur = end + strlen("?>");
+
+    return true;
+}
+
+/**
+ * Reads an attribute. Its value is decoded in t->buf
+ *
+ * @return the name of the attribute or NULL if declined
+ */
+static const xmlChar *read_attribute(tokenizer_t *t)
+{
+    const xmlChar *name = read_name(t);
+    skip_blanks(t);
+    if (!name || (t->cur >= t->end) || (*t->cur != '='))
+        return NULL;
+    t->cur++;
+    skip_blanks(t);
+    if ((t->cur >= t->end) || ((*t->cur != '"') && (*t->cur != '\'')))
+        return NULL;
+
+    const char *value = t->cur + 1;
+    const char *end = memchr(value, *t->cur, t->end - value);
+    if (!end || (decode(t, value, end, DECODE_ATTR) < 0))
+        return NULL;
+    t->cur = end + 1;
+
+    return name;
+}
+
+/**
+ * Reads the attributes of an element, up to the end of its start tag
+ *
+ * @param [out] empty true if the element has no content (<name/>)
+ *
+ * @return false if declined
+ */
+static bool read_attributes(tokenizer_t *t, xmlNodePtr node, bool *empty)
+{
+    for (;;) {
+        const char *start = t->cur;
+        skip_blanks(t);
+        if (starts_with(t, "/>") || starts_with(t, ">")) {
+            *empty = *t->cur == '/';
+            t->cur += *empty ? 2 : 1;
+            return true;
+        }
+        if (t->cur == start)
+            return false;
+
+        const xmlChar *name = read_attribute(t);
+        if (!name || !xmlStrncmp(name, (const xmlChar *)"xmlns", 5) || xmlHasProp(node, name))
+            return false;
+        ASSERT(xmlNewProp(node, name, t->buf));
+    }
+}
+
+/**
+ * Reads the XML declaration. Only UTF-8 and ASCII encodings are accepted
+ *
+ * @return false if declined
+ */
+static bool read_declaration(tokenizer_t *t)
+{
+    t->cur += strlen("<?xml");
+    if ((t->cur >= t->end) || !is_blank(*t->cur))
+        return false;
+
+    xmlDocPtr doc = t->doc;
+    for (;;) {
+        skip_blanks(t);
+        if (starts_with(t, "?>")) {
+            t->cur += 2;
+            return doc->version != NULL;
+        }
+
+        const xmlChar *name = read_attribute(t);
+        if (!name)
+            return false;
+        if (!xmlStrcmp(name, (const xmlChar *)"version") && !doc->version) {
+            doc->version = xmlStrdup(t->buf);
+        } else if (!xmlStrcmp(name, (const xmlChar *)"encoding") && !doc->encoding) {
+            if (xmlStrcasecmp(t->buf, (const xmlChar *)"UTF-8") &&
+                xmlStrcasecmp(t->buf, (const xmlChar *)"US-ASCII") &&
+                xmlStrcasecmp(t->buf, (const xmlChar *)"ASCII"))
+                return false;
+            doc->encoding = xmlStrdup(t->buf);
+        } else if (!xmlStrcmp(name, (const xmlChar *)"standalone") && (doc->standalone < 0)) {
+            if (xmlStrcmp(t->buf, (const xmlChar *)"yes") &&
+                xmlStrcmp(t->buf, (const xmlChar *)"no"))
+                return false;
+            doc->standalone = !xmlStrcmp(t->buf, (const xmlChar *)"yes");
+        } else {
+            return false;
+        }
+    }
+}
+
+static bool tokenize(tokenizer_t *t)
+{
+    xmlNodePtr parent = (xmlNodePtr)t->doc;
+    bool root = false;
+
+    while (t->cur < t->end) {
+        bool ok;
+        if (*t->cur != '<') {
+            ok = read_text(t, parent);
+        } else if (starts_with(t, "<!--")) {
+            ok = read_comment(t, parent);
+        } else if (starts_with(t, "<?")) {
+            ok = read_pi(t, parent);
+        } else if (starts_with(t, "<!")) {
+            /* DOCTYPE, CDATA sections */
+            ok = false;
+        } else if (starts_with(t, "</")) {
+            t->cur += 2;
+            const xmlChar *name = read_name(t);
+            skip_blanks(t);
+            ok = name && (parent != (xmlNodePtr)t->doc) && (name == parent->name) &&
+                 (t->cur < t->end) && (*t->cur == '>');
+            t->cur++;
+            parent = parent->parent;
+        } else {
+            t->cur++;
+            const xmlChar *name = read_name(t);
+            ok = name && ((parent != (xmlNodePtr)t->doc) || !root);
+            if (ok) {
+                xmlNodePtr node = xmlNewDocNode(t->doc, NULL, name, NULL);
+                ASSERT(node);
+                ASSERT(xmlAddChild(parent, node));
+                root = true;
+
+                bool empty = true;
+                ok = read_attributes(t, node, &empty);
+                if (!empty)
+                    parent = node;
+            }
+        }
+        if (!ok)
+            return false;
+    }
+
+    return root && (parent == (xmlNodePtr)t->doc);
+}
+
+/**
+ * Parses an XML buffer with the built-in tokenizer
+ *
+ * @param [in] data Content of the file
+ * @param [in] size Size of the content
+ * @param [in] url  Name of the file, stored in the document. Can be NULL
+ *
+ * @return the XML document or NULL if declined
+ */
+xmlDocPtr tcs_tokenizer_parse(const char *data, size_t size, const char *url)
+{
+    ASSERT(data);
+
+    tokenizer_t t = { data, data + size, NULL, NULL };
+    if (starts_with(&t, "\xEF\xBB\xBF"))
+        t.cur += 3;
+
+    /* decoded strings are never longer than their source */
+    t.buf = malloc(size + 1);
+    ASSERT(t.buf);
+    t.doc = xmlNewDoc(NULL);
+    ASSERT(t.doc);
+    /* version is set by the declaration, if any */
+    xmlFree((xmlChar *)t.doc->version);
+    t.doc->version = NULL;
+    t.doc->dict = xmlDictCreate();
+    ASSERT(t.doc->dict);
+
+    bool ok = (!starts_with(&t, "<?xml") || read_declaration(&t)) && tokenize(&t);
+    free(t.buf);
+    if (!ok) {
+        LOGD("file (%s) declined by the built-in tokenizer", url ? url : "");
+        xmlFreeDoc(t.doc);
+        return NULL;
+    }
+
+    if (!t.doc->version)
+        t.doc->version = xmlStrdup((const xmlChar *)XML_DEFAULT_VERSION);
+    if (url)
+        t.doc->URL = xmlStrdup((const xmlChar *)url);
+
+    return t.doc;
+}
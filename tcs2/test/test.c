@@ -1,136 +1,82 @@
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <zlib.h>
 
 #include "libtcs2/tcs.h"
 
-#define xstr(s) str(s)
-#define str(s) #s
+#include "test_fixtures.h"
 
-#ifdef __GNUC__
-#define likely(x)   __builtin_expect(!!(x), 1)
-#define unlikely(x) __builtin_expect(!!(x), 0)
-#else
-#define likely(x)   (x)
-#define unlikely(x) (x)
+#ifdef TCS_TEST_CODEGEN
+#include "crm_config.h"
+#include "crm_root_config.h"
 #endif
 
-#define DASSERT(exp, format, ...) do { \
-        if (unlikely(!(exp))) { \
-            if (unlikely(format[0] != '\0')) \
-                printf("AssertionLog " format, ## __VA_ARGS__); \
-            printf("%s:%d Assertion '" xstr(exp) "'", __FILE__, __LINE__); \
-            abort(); \
-        } \
-} while (0)
+/* Allocation counters. Allocator is interposed on glibc hosts, without sanitizer, only */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define ALLOC_COUNTERS
+
+static unsigned long nb_allocs;
+static unsigned long nb_bytes;
+static long nb_live;               // Allocated blocks not freed yet
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    __atomic_fetch_add(&nb_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_bytes, size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_live, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    __atomic_fetch_add(&nb_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_bytes, nmemb * size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_live, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
 
-#define ASSERT(exp) DASSERT(exp, "")
-/* *INDENT-OFF* */
-#define XML_CONFIG \
-"<config> \
-    <group name=\"common\"> \
-           <int key=\"test\">5</int> \
-    </group> \
-    <group name=\"modules\"> \
-        <string key=\"crm1\">crm_test.xml</string> \
-        <string key=\"streamline1\">streamline_test.xml</string> \
-    </group> \
-</config>"
-
-#define XML_CONFIG_OVERLAY \
-"<config> \
-    <group name=\"common\"> \
-           <int key=\"test\">0x20</int> \
-    </group> \
-</config>"
-
-
-#define XML_CRM \
-"<group name=\"crm1\"> \
-    <group name=\"firmware_elector\"> \
-        <int key=\"toto\">2</int> \
-    </group> \
-    <group name=\"hal\"> \
-        <int key=\"ping_timeout\">5200</int> \
-        <string key=\"hello_text\">hello world</string> \
-        <bool key=\"boolean_true\">false</bool> \
-        <bool key=\"boolean_false\">true</bool> \
-    </group> \
-</group>"
-
-#define XML_CRM1_OVERLAY \
-"<group name=\"crm1\"> \
-    <group name=\"firmware_elector\"> \
-        <int key=\"toto\">5</int> \
-    </group> \
-    <group name=\"hal\"> \
-        <int key=\"ping_timeout\">5200</int> \
-        <bool key=\"boolean_true\">true</bool> \
-        <bool key=\"boolean_false\">false</bool> \
-        <int key=\"new_value\">567</int> \
-        <int key=\"bad_int\">1abc</int> \
-        <bool key=\"bad_bool\">abc</bool> \
-    </group> \
-    <!-- add new group --> \
-    <group name=\"new_group\"> \
-        <int key=\"toto\">97264</int> \
-    </group> \
-</group>"
-
-#define XML_CRM2_OVERLAY \
-"<group name=\"crm2\"> \
-    <group name=\"firmware_elector\"> \
-        <int key=\"toto\">47145836</int> \
-    </group> \
-</group>"
-
-
-#define XML_STREAMLINE \
-"<group name=\"streamline1\"> \
-    <list name=\"tlvs\"> \
-        <string>TLV1</string> \
-        <string>TLV2</string> \
-        <string>TLV3</string> \
-    </list> \
-</group>"
-
-#define XML_STREAMLINE_OVERLAY_APPEND \
-"<group name=\"streamline1\"> \
-    <list name=\"tlvs\" overlay=\"append\"> \
-        <string>TLV4</string> \
-        <string>TLV5</string> \
-        <string>TLV6</string> \
-    </list> \
-</group>"
-
-#define XML_STREAMLINE_OVERLAY_APPEND_DEFAULT \
-"<group name=\"streamline1\"> \
-    <list name=\"tlvs\"> \
-        <string>TLV4</string> \
-        <string>TLV5</string> \
-        <string>TLV6</string> \
-    </list> \
-</group>"
-
-#define XML_STREAMLINE_OVERLAY_OVERWRITE \
-"<group name=\"streamline1\"> \
-    <list name=\"tlvs\" overlay=\"overwrite\"> \
-        <string>TLV_OVERWRITE_1</string> \
-        <string>TLV_OVERWRITE_2</string> \
-        <string>TLV_OVERWRITE_3</string> \
-    </list> \
-</group>"
-
-#define XML_STREAMLINE_OVERLAY_OVERWRITE_EMPTY \
-"<group name=\"streamline1\"> \
-    <list name=\"tlvs\" overlay=\"overwrite\"> \
-    </list> \
-</group>"
-
-
-/* *INDENT-ON* */
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&nb_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nb_bytes, size, __ATOMIC_RELAXED);
+    if (!ptr)
+        __atomic_fetch_add(&nb_live, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr)
+        __atomic_fetch_sub(&nb_live, 1, __ATOMIC_RELAXED);
+    __libc_free(ptr);
+}
+
+/* Checks the number of allocations and allocated bytes of a call */
+#define ALLOC_BUDGET(max_allocs, max_bytes, call) do { \
+        unsigned long allocs = nb_allocs; \
+        unsigned long bytes = nb_bytes; \
+        call; \
+        allocs = nb_allocs - allocs; \
+        bytes = nb_bytes - bytes; \
+        printf("budget: %-60s %5lu allocations %7lu bytes\n", xstr(call), allocs, bytes); \
+        DASSERT((allocs <= (max_allocs)) && (bytes <= (max_bytes)), \
+                "%s: %lu allocations (budget %lu), %lu bytes (budget %lu)\n", xstr(call), \
+                allocs, (unsigned long)(max_allocs), bytes, (unsigned long)(max_bytes)); \
+} while (0)
+#endif
 
 #define XML_ROOT_FOLDER "/tmp/tcs"
 #define XML_HW_FOLDER XML_ROOT_FOLDER "/hw"
@@ -139,6 +85,7 @@
 #define XML_HW_CONFIG_FOLDER XML_HW_FOLDER "/config"
 #define XML_HW_CRM_FOLDER XML_HW_FOLDER "/crm"
 #define XML_HW_STREAMLINE_FOLDER XML_HW_FOLDER "/streamline"
+#define XML_HW_FLAT_FOLDER XML_HW_FOLDER "/flat/overlay"
 
 #define XML_OVERLAY_CONFIG_FOLDER XML_OVERLAY_FOLDER "/config"
 #define XML_OVERLAY_CRM_FOLDER XML_OVERLAY_FOLDER "/crm"
@@ -268,15 +215,39 @@ static void check_config(const char *group_name, bool default_group, overlay_typ
     ASSERT(!array && value == 0);
     ASSERT(tcs->select_group(tcs, "wrong_group_name") == -1);
 
+    /* STATISTICS (only if built with TCS_ENABLE_STATS) */
+    tcs_stats_t stats;
+    if (tcs->get_stats(tcs, &stats, true) == 0) {
+        ASSERT(stats.api[TCS_API_GET_INT].calls == stats.api[TCS_API_GET_INT].hits +
+               stats.api[TCS_API_GET_INT].misses);
+        ASSERT(stats.api[TCS_API_GET_INT].misses == 2);
+        ASSERT(stats.api[TCS_API_GET_STRING].hits == 1);
+        ASSERT(stats.api[TCS_API_SELECT_GROUP].misses == 1);
+        ASSERT(tcs->get_stats(tcs, &stats, false) == 0);
+        ASSERT(stats.api[TCS_API_GET_INT].calls == 0);
+    }
+
     /* new group addition */
     snprintf(group, sizeof(group), "%snew_group", prefix);
     ASSERT(tcs->select_group(tcs, group) == 0);
     ASSERT(tcs->get_int(tcs, "toto", &value) == 0);
     ASSERT(value == 97264);
 
+    /* GENERATION */
+    unsigned int ctx_gen = tcs->get_generation(tcs, NULL);
+    unsigned int crm_gen = tcs->get_generation(tcs, group_name);
+    ASSERT(ctx_gen > 0 && crm_gen > 0 && crm_gen <= ctx_gen);
+    ASSERT(tcs->get_generation(tcs, "common") > 0);
+    ASSERT(tcs->get_generation(tcs, "wrong_group_name") == 0);
+    if (default_group)
+        ASSERT(tcs->get_generation(tcs, ".") == crm_gen);
+
     /* DYNAMIC group LOADING */
     int nb = 0;
     tcs->add_group(tcs, "streamline1", true);
+    ASSERT(tcs->get_generation(tcs, NULL) > ctx_gen);
+    ASSERT(tcs->get_generation(tcs, "streamline1") > ctx_gen);
+    ASSERT(tcs->get_generation(tcs, group_name) == crm_gen);
     ASSERT(tcs->select_group(tcs, "streamline1") == 0);
     char **tlvs = tcs->get_string_array(tcs, "tlvs", &nb);
 
@@ -308,6 +279,900 @@ static void check_config(const char *group_name, bool default_group, overlay_typ
     free(tlvs);
 }
 
+static void write_manifest(const char *folder, const char *crm1_groups)
+{
+    const char *files[] = { "crm1_test.xml", "crm2_test.xml" };
+    const char *groups[] = { crm1_groups, "crm2" };
+    char path[256];
+    char data[512];
+    int len = snprintf(data, sizeof(data), "TCS_MANIFEST\t2\n");
+
+    for (int i = 0; i < 2; i++) {
+        char content[4096];
+        snprintf(path, sizeof(path), "%s/%s", folder, files[i]);
+        int fd = open(path, O_RDONLY);
+        ASSERT(fd >= 0);
+        ssize_t size = read(fd, content, sizeof(content));
+        close(fd);
+        ASSERT(size >= 0);
+        len += snprintf(data + len, sizeof(data) - len, "%s\t%zd\t%lu\tgroup\t%s\n", files[i],
+                        size, crc32(0L, (const Bytef *)content, size), groups[i]);
+    }
+    snprintf(path, sizeof(path), "%s/.tcs_manifest", folder);
+    write_xml(path, data);
+}
+
+static int get_crm_toto(void)
+{
+    int value = 0;
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+
+    ASSERT(tcs);
+    ASSERT(tcs->select_group(tcs, ".firmware_elector") == 0);
+    ASSERT(tcs->get_int(tcs, "toto", &value) == 0);
+    tcs->dispose(tcs);
+
+    return value;
+}
+
+static void check_overlay_manifest(void)
+{
+    /* only files listed for the group are applied */
+    write_manifest(XML_OVERLAY_CRM_FOLDER, "crm1");
+    check_config("crm1", true, OVERLAY_APPEND);
+
+    write_manifest(XML_OVERLAY_CRM_FOLDER, "crm2,crm3");
+    ASSERT(get_crm_toto() == 2);
+
+    /* timestamps are not part of the fingerprint: image builds normalize them */
+    system("cp -r " XML_OVERLAY_CRM_FOLDER " " XML_OVERLAY_CRM_FOLDER ".copy && "
+           "rm -fr " XML_OVERLAY_CRM_FOLDER " && "
+           "mv " XML_OVERLAY_CRM_FOLDER ".copy " XML_OVERLAY_CRM_FOLDER " && "
+           "touch -d @0 " XML_OVERLAY_CRM_FOLDER "/.tcs_manifest");
+    ASSERT(get_crm_toto() == 2);
+
+    /* file added to the folder */
+    write_xml(XML_OVERLAY_CRM_FOLDER "/crm3_test.xml", XML_CRM2_OVERLAY);
+    ASSERT(get_crm_toto() == 5);
+    unlink(XML_OVERLAY_CRM_FOLDER "/crm3_test.xml");
+    ASSERT(get_crm_toto() == 2);
+
+    /* files not touching the group are not opened: their fingerprint is not checked */
+    write_manifest(XML_OVERLAY_CRM_FOLDER, "crm1");
+    write_xml(XML_OVERLAY_CRM_FOLDER "/crm2_test.xml",
+              "<group name=\"crm1\"> <group name=\"firmware_elector\"> "
+              "<int key=\"toto\">9</int> </group> </group>");
+    ASSERT(get_crm_toto() == 5);
+
+    /* stale manifest is ignored: all the files are applied */
+    write_xml(XML_OVERLAY_CRM_FOLDER "/crm1_test.xml", XML_CRM1_OVERLAY "<!-- modified -->");
+    ASSERT(get_crm_toto() == 9);
+    write_xml(XML_OVERLAY_CRM_FOLDER "/crm2_test.xml", XML_CRM2_OVERLAY);
+}
+
+static void check_flat_config(void)
+{
+    system("mkdir -p " XML_HW_FLAT_FOLDER);
+    write_xml(XML_HW_FLAT_FOLDER "/TCS2_test.xml", XML_FLAT);
+
+    /* group is read from the flattened file: neither module file nor overlay is parsed */
+    ASSERT(get_crm_toto() == 42);
+
+    setenv("persist.tcs.disable_flat", "true", 1);
+    ASSERT(get_crm_toto() == 5);
+    unsetenv("persist.tcs.disable_flat");
+
+    /* removed or evicted groups are added again from the flattened file */
+    write_xml(XML_HW_FLAT_FOLDER "/TCS2_test.xml",
+              "<tcs_flat> " XML_FLAT_SHARED_CONFIG " " XML_FLAT_CRM " "
+              XML_FLAT_CRM2 " </tcs_flat>");
+    tcs_ctx_t *tcs = tcs2_init(NULL);
+    ASSERT(tcs);
+    int value = 0;
+    tcs->add_group(tcs, "crm1", false);
+    ASSERT(tcs->remove_group(tcs, "crm1") == 0);
+    tcs->add_group(tcs, "crm1", false);
+    ASSERT(tcs->select_group(tcs, "crm1.firmware_elector") == 0);
+    ASSERT((tcs->get_int(tcs, "toto", &value) == 0) && (value == 42));
+    tcs->dispose(tcs);
+
+    setenv("persist.tcs.group_budget", "1", 1);
+    tcs = tcs2_init(NULL);
+    ASSERT(tcs);
+    tcs->add_group(tcs, "crm1", false);
+    tcs->add_group(tcs, "crm2", false);
+    ASSERT(tcs->select_group(tcs, "crm1.firmware_elector") == 0);
+    ASSERT((tcs->get_int(tcs, "toto", &value) == 0) && (value == 42));
+    ASSERT(tcs->select_group(tcs, "crm2.firmware_elector") == 0);
+    ASSERT((tcs->get_int(tcs, "toto", &value) == 0) && (value == 43));
+    ASSERT(tcs->select_group(tcs, "crm1.firmware_elector") == 0);
+    ASSERT((tcs->get_int(tcs, "toto", &value) == 0) && (value == 42));
+    tcs->dispose(tcs);
+    unsetenv("persist.tcs.group_budget");
+
+    system("rm -fr " XML_HW_FOLDER "/flat");
+}
+
+/* @see tcs_bundle.c for the bundle format */
+static void write_bundle(const char *path, bool compress)
+{
+    const char *names[] = { "config", "crm1" };
+    const char *xml[] = { XML_FLAT_CONFIG, XML_FLAT_CRM };
+    struct {
+        char magic[8];
+        uint32_t version;
+        uint32_t nb;
+    } header = { "TCS2BNDL", 1, 2 };
+    struct {
+        char name[64];
+        uint32_t offset;
+        uint32_t size;
+        uint32_t raw_size;
+        uint32_t flags;
+    } toc[2];
+    unsigned char data[2][1024];
+
+    uint32_t offset = sizeof(header) + sizeof(toc);
+    for (int i = 0; i < 2; i++) {
+        memset(&toc[i], 0, sizeof(toc[i]));
+        snprintf(toc[i].name, sizeof(toc[i].name), "%s", names[i]);
+        toc[i].offset = offset;
+        toc[i].raw_size = strlen(xml[i]);
+        uLongf size = sizeof(data[i]);
+        if (compress) {
+            ASSERT(compress2(data[i], &size, (const Bytef *)xml[i], toc[i].raw_size, 9) == Z_OK);
+            toc[i].flags = 1;
+        } else {
+            size = toc[i].raw_size;
+            memcpy(data[i], xml[i], size);
+        }
+        toc[i].size = size;
+        offset += size;
+    }
+
+    FILE *fp = fopen(path, "w");
+    ASSERT(fp);
+    ASSERT(fwrite(&header, sizeof(header), 1, fp) == 1);
+    ASSERT(fwrite(toc, sizeof(toc), 1, fp) == 1);
+    for (int i = 0; i < 2; i++)
+        ASSERT(fwrite(data[i], 1, toc[i].size, fp) == toc[i].size);
+    ASSERT(fclose(fp) == 0);
+}
+
+static void check_bundle(void)
+{
+    system("mkdir -p " XML_HW_FLAT_FOLDER);
+
+    for (int compress = 0; compress < 2; compress++) {
+        write_bundle(XML_HW_FLAT_FOLDER "/TCS2_test.bundle", compress);
+
+        /* group is read from the bundle: neither module file nor overlay is parsed */
+        ASSERT(get_crm_toto() == 42);
+
+        tcs_ctx_t *tcs = tcs2_init(NULL);
+        ASSERT(tcs);
+        int value;
+        ASSERT(tcs->select_group(tcs, "common") == 0);
+        ASSERT(tcs->get_int(tcs, "test", &value) == 0);
+        ASSERT(value == 0x20);
+        tcs->add_group(tcs, "crm1", false);
+        const tcs_timing_report_t *report = tcs->get_timing_report(tcs);
+        ASSERT(report->nb_files == 2);
+        ASSERT(strstr(report->files[1].path, "TCS2_test.bundle:crm1"));
+        tcs->dispose(tcs);
+    }
+
+    /* corrupted bundle is ignored */
+    write_xml(XML_HW_FLAT_FOLDER "/TCS2_test.bundle", "TCS2BNDL");
+    ASSERT(get_crm_toto() == 5);
+
+    system("rm -fr " XML_HW_FOLDER "/flat");
+}
+
+static void check_access_profile(void)
+{
+    char name[32] = { "\0" };
+    char cmd[256];
+    int fd = open("/proc/self/comm", O_RDONLY);
+    ASSERT(fd >= 0);
+    ASSERT(read(fd, name, sizeof(name) - 1) > 0);
+    close(fd);
+    name[strcspn(name, "\n")] = '\0';
+
+    /* record */
+    setenv("persist.tcs.profile_record", XML_ROOT_FOLDER, 1);
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    char *str = tcs->get_string(tcs, "hello_text");
+    ASSERT(str);
+    free(str);
+    int value;
+    ASSERT(tcs->get_int(tcs, "new_value", &value) == 0);
+    tcs->dispose(tcs);
+    unsetenv("persist.tcs.profile_record");
+
+    /* load: hot groups are frozen first but values don't change */
+    snprintf(cmd, sizeof(cmd), "mkdir -p " XML_HW_FOLDER "/profile && mv " XML_ROOT_FOLDER
+             "/%s.profile " XML_HW_FOLDER "/profile/", name);
+    ASSERT(system(cmd) == 0);
+    setenv("persist.tcs.profile", "true", 1);
+    tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    ASSERT(tcs->freeze(tcs) == 0);
+    tcs_group_t *crm1 = tcs->open_group(tcs, "crm1");
+    tcs_group_t *hal = tcs->open_group(tcs, ".hal");
+    tcs_group_t *modules = tcs->open_group(tcs, "modules");
+    ASSERT(crm1 && hal && modules);
+    ASSERT(((char *)crm1 < (char *)hal) && ((char *)hal < (char *)modules));
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT(tcs->get_int(tcs, "new_value", &value) == 0);
+    ASSERT(value == 567);
+    ASSERT(tcs->get_int(tcs, "ping_timeout", &value) == 0);
+    ASSERT(value == 5200);
+    tcs->dispose(tcs);
+    unsetenv("persist.tcs.profile");
+
+    system("rm -fr " XML_HW_FOLDER "/profile");
+}
+
+static void check_async_init(const char *group_name)
+{
+    tcs_async_t *handle = tcs2_init_async(group_name);
+
+    ASSERT(handle);
+    ASSERT(tcs2_async_get_fd(handle) >= 0);
+    ASSERT(tcs2_async_wait(handle, -1) == 0);
+    /* result stays available once init is over */
+    ASSERT(tcs2_async_wait(handle, 0) == 0);
+
+    tcs_ctx_t *tcs = NULL;
+    ASSERT(tcs2_async_get_result(handle, &tcs) == 0);
+    ASSERT(tcs);
+    tcs_ctx_t *again = NULL;
+    ASSERT(tcs2_async_get_result(handle, &again) == -1 && !again);
+
+    int value;
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT(tcs->get_int(tcs, "ping_timeout", &value) == 0);
+    ASSERT(value == 5200);
+    tcs->dispose(tcs);
+    tcs2_async_dispose(handle);
+
+    /* context not retrieved: freed by the handle */
+    handle = tcs2_init_async(NULL);
+    ASSERT(handle);
+    tcs2_async_dispose(handle);
+}
+
+static void check_timing_report(void)
+{
+    setenv("persist.tcs.timing_log", "true", 1);
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    unsetenv("persist.tcs.timing_log");
+    ASSERT(tcs);
+
+    const tcs_timing_report_t *report = tcs->get_timing_report(tcs);
+    ASSERT(report);
+    int nb_files = report->nb_files;
+    bool module_found = false;
+    long long bytes = 0;
+    for (int i = 0; i < report->nb_files; i++) {
+        const tcs_file_timing_t *file = &report->files[i];
+        if (file->phase == TCS_PHASE_MODULE_READ) {
+            ASSERT(strstr(file->path, "crm_test.xml"));
+            ASSERT(file->bytes == (long long)strlen(XML_CRM));
+            module_found = true;
+        }
+        if (file->phase == TCS_PHASE_OVERLAY_READ)
+            bytes += file->bytes;
+    }
+    ASSERT(module_found);
+    ASSERT(report->phase_bytes[TCS_PHASE_OVERLAY_READ] == bytes);
+    ASSERT(report->phase_bytes[TCS_PHASE_CONFIG_READ] == (long long)strlen(XML_CONFIG));
+    ASSERT(report->phase_ns[TCS_PHASE_CONFIG_READ] > 0);
+
+    /* add_group timings are appended */
+    tcs->add_group(tcs, "streamline1", false);
+    report = tcs->get_timing_report(tcs);
+    ASSERT(report->nb_files > nb_files);
+    tcs->dispose(tcs);
+}
+
+static void check_shared_modules(void)
+{
+    write_xml(XML_HW_CONFIG_FOLDER "/TCS2_test.xml", XML_SHARED_MODULES_CONFIG);
+
+    tcs_ctx_t *tcs = tcs2_init(NULL);
+    ASSERT(tcs);
+    tcs->add_group(tcs, "crm1", false);
+    tcs->add_group(tcs, "crm2", false);
+    tcs->add_group(tcs, "crm3", false);
+
+    /* instance overlays are applied on top of the shared file */
+    const char *groups[] = { "crm1", "crm2", "crm3" };
+    int totos[] = { 5, 47145836, 2 };
+    for (int i = 0; i < 3; i++) {
+        char group[30];
+        int value;
+        snprintf(group, sizeof(group), "%s.firmware_elector", groups[i]);
+        ASSERT(tcs->select_group(tcs, group) == 0);
+        ASSERT(!tcs->get_int(tcs, "toto", &value) && (value == totos[i]));
+        snprintf(group, sizeof(group), "%s.hal", groups[i]);
+        ASSERT(tcs->select_group(tcs, group) == 0);
+        ASSERT(!tcs->get_int(tcs, "ping_timeout", &value) && (value == 5200));
+    }
+    ASSERT(tcs->select_group(tcs, "crm3.new_group") != 0);
+
+    /* the shared file and each overlay file are read once */
+    const tcs_timing_report_t *report = tcs->get_timing_report(tcs);
+    int reads = 0;
+    int overlay_reads = 0;
+    for (int i = 0; i < report->nb_files; i++) {
+        if (report->files[i].phase == TCS_PHASE_MODULE_READ)
+            reads++;
+        if ((report->files[i].phase == TCS_PHASE_OVERLAY_READ) &&
+            strstr(report->files[i].path, XML_OVERLAY_CRM_FOLDER))
+            overlay_reads++;
+    }
+    ASSERT(reads == 1);
+    ASSERT(overlay_reads == 2);
+    tcs->dispose(tcs);
+
+    write_xml(XML_HW_CONFIG_FOLDER "/TCS2_test.xml", XML_CONFIG);
+}
+
+static void check_remove_group(bool layered)
+{
+    write_xml(XML_HW_CONFIG_FOLDER "/TCS2_test.xml", XML_SHARED_MODULES_CONFIG);
+    if (layered)
+        setenv("persist.tcs.layered_overlays", "true", 1);
+
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    ASSERT(tcs->remove_group(tcs, "crm1") == -1);
+    ASSERT(tcs->remove_group(tcs, "common") == -1);
+    ASSERT(tcs->remove_group(tcs, "crm2") == -1);
+
+    tcs->add_group(tcs, "crm2", false);
+    ASSERT(tcs->open_group(tcs, "crm2.firmware_elector"));
+    ASSERT(tcs->select_group(tcs, "crm2.hal") == 0);
+    ASSERT(tcs->remove_group(tcs, "crm2") == 0);
+    ASSERT(tcs->select_group(tcs, "crm2.hal") == -1);
+    ASSERT(tcs->get_generation(tcs, "crm2") == 0);
+    ASSERT(tcs->remove_group(tcs, "crm2") == -1);
+
+    /* the group can be added again */
+    int value;
+    tcs->add_group(tcs, "crm2", false);
+    ASSERT(tcs->select_group(tcs, "crm2.firmware_elector") == 0);
+    ASSERT(!tcs->get_int(tcs, "toto", &value) && (value == 47145836));
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT(!tcs->get_int(tcs, "ping_timeout", &value) && (value == 5200));
+    tcs->dispose(tcs);
+
+    /* budget mode: the least recently selected group is evicted, then reloaded when selected */
+    setenv("persist.tcs.group_budget", "2", 1);
+    tcs = tcs2_init(NULL);
+    unsetenv("persist.tcs.group_budget");
+    ASSERT(tcs);
+    tcs->add_group(tcs, "crm1", false);
+    tcs->add_group(tcs, "crm2", false);
+    ASSERT(tcs->select_group(tcs, "crm1.hal") == 0);
+    unsigned int generation = tcs->get_generation(tcs, "crm2");
+    ASSERT(generation);
+    tcs->add_group(tcs, "crm3", false);
+    /* evicted: the generation is kept until the group is reloaded */
+    ASSERT(tcs->get_generation(tcs, "crm2") == generation);
+
+    ASSERT(tcs->select_group(tcs, "crm2.firmware_elector") == 0);
+    ASSERT(!tcs->get_int(tcs, "toto", &value) && (value == 47145836));
+    ASSERT(tcs->get_generation(tcs, "crm2") > generation);
+
+    /* queries reload the evicted groups they match */
+    generation = tcs->get_generation(tcs, "crm3");
+    tcs_int_match_t *ints = NULL;
+    ASSERT(tcs->query_int(tcs, "crm?.firmware_elector", "toto", &ints) == 3);
+    free(ints);
+    ASSERT(tcs->get_generation(tcs, "crm3") > generation);
+
+    /* selected group and groups with open handles are kept */
+    tcs_group_t *hal = tcs->open_group(tcs, "crm1.hal");
+    ASSERT(hal);
+    generation = tcs->get_generation(tcs, "crm1");
+    ASSERT(tcs->select_group(tcs, "crm3.firmware_elector") == 0);
+    ASSERT(!tcs->get_int(tcs, "toto", &value) && (value == 2));
+    ASSERT(!tcs->group_get_int(tcs, hal, "ping_timeout", &value) && (value == 5200));
+    ASSERT(tcs->open_group(tcs, "crm1.hal") == hal);
+    tcs->close_group(tcs, hal);
+    ASSERT(tcs->get_generation(tcs, "crm1") == generation);
+
+    /* closed handles don't keep their group */
+    tcs->close_group(tcs, hal);
+    ASSERT(tcs->select_group(tcs, "crm2.firmware_elector") == 0);
+    ASSERT(tcs->select_group(tcs, "crm1.hal") == 0);
+    ASSERT(tcs->get_generation(tcs, "crm1") > generation);
+
+    /* removed groups are not reloaded */
+    ASSERT(tcs->remove_group(tcs, "crm2") == 0);
+    ASSERT(tcs->select_group(tcs, "crm2.hal") == -1);
+    ASSERT(tcs->query_int(tcs, "crm?.firmware_elector", "toto", &ints) == 2);
+    free(ints);
+
+    tcs->dispose(tcs);
+
+    /* evicted groups are frozen too */
+    setenv("persist.tcs.group_budget", "2", 1);
+    tcs = tcs2_init(NULL);
+    unsetenv("persist.tcs.group_budget");
+    ASSERT(tcs);
+    tcs->add_group(tcs, "crm1", false);
+    tcs->add_group(tcs, "crm2", false);
+    generation = tcs->get_generation(tcs, "crm1");
+    tcs->add_group(tcs, "crm3", false);
+    ASSERT(tcs->get_generation(tcs, "crm1") == generation);
+    ASSERT(tcs->freeze(tcs) == 0);
+    ASSERT(tcs->get_generation(tcs, "crm1") > generation);
+    ASSERT(tcs->select_group(tcs, "crm1.firmware_elector") == 0);
+    ASSERT(!tcs->get_int(tcs, "toto", &value) && (value == 5));
+    tcs->dispose(tcs);
+
+    unsetenv("persist.tcs.layered_overlays");
+    write_xml(XML_HW_CONFIG_FOLDER "/TCS2_test.xml", XML_CONFIG);
+}
+
+static void check_xml_parser(const char *parser)
+{
+    setenv("persist.tcs.xml_parser", parser, 1);
+
+    /* in check mode, every file is also parsed by libxml2 and both trees are compared */
+    create_xml_files(OVERLAY_APPEND);
+    check_config("crm1", false, OVERLAY_APPEND);
+    check_config("crm1", true, OVERLAY_APPEND);
+    check_shared_modules();
+
+    unlink(XML_OVERLAY_CRM_FOLDER "/crm1_test.xml");
+    write_xml(XML_HW_CRM_FOLDER "/crm_test.xml", XML_CRM_SYNTAX);
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    int value;
+    bool flag;
+    ASSERT(tcs->select_group(tcs, ".firmware_elector") == 0);
+    ASSERT(!tcs->get_int(tcs, "toto", &value) && (value == 24));
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT(!tcs->get_int(tcs, "ping_timeout", &value) && (value == 5200));
+    ASSERT(!tcs->get_bool(tcs, "boolean_true", &flag) && flag);
+    char *str = tcs->get_string(tcs, "hello_text");
+    ASSERT(str && !strcmp(str, "caf\xC3\xA9 <&> \"'"));
+    free(str);
+    tcs->dispose(tcs);
+
+    write_xml(XML_HW_CRM_FOLDER "/crm_test.xml", XML_CRM_CDATA);
+    ASSERT(get_crm_toto() == 7);
+
+    create_xml_files(OVERLAY_APPEND);
+    unsetenv("persist.tcs.xml_parser");
+}
+
+static void check_hashed_getters(void)
+{
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+
+    int value;
+    bool flag;
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT(tcs->get_int_hashed(tcs, tcs_hash("ping_timeout"), "ping_timeout", &value) == 0);
+    ASSERT(value == 5200);
+    /* hash collision: key is checked */
+    ASSERT(tcs->get_int_hashed(tcs, tcs_hash("ping_timeout"), "new_value", &value) == -1);
+    ASSERT(tcs->get_bool_hashed(tcs, tcs_hash("boolean_true"), "boolean_true", &flag) == 0);
+    ASSERT(flag);
+    ASSERT(!strcmp(tcs->peek_string(tcs, tcs_hash("hello_text"), "hello_text"), "hello world"));
+    ASSERT(!tcs->peek_string(tcs, tcs_hash("ping_timeout"), "ping_timeout"));
+
+    tcs->add_group(tcs, "streamline1", false);
+    ASSERT(tcs->select_group(tcs, "streamline1") == 0);
+    int nb = 0;
+    const char *const *list = tcs->peek_string_array(tcs, tcs_hash("tlvs"), "tlvs", &nb);
+    ASSERT(list && (nb == 6));
+    ASSERT(!strcmp(list[0], "TLV1") && !strcmp(list[5], "TLV6"));
+
+    /* single block */
+    char **array = tcs->get_string_array_packed(tcs, "tlvs", &nb);
+    ASSERT(array && (nb == 6));
+    for (int i = 0; i < nb; i++)
+        ASSERT(!strcmp(array[i], list[i]));
+    free(array);
+    ASSERT(!tcs->get_string_array_packed(tcs, "unknown", &nb) && (nb == 0));
+    tcs->dispose(tcs);
+}
+
+static void check_missing_keys(void)
+{
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+
+    int value;
+    bool flag;
+    char key[32];
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    /* misses are mostly rejected by the Bloom filter of the group: hits must not be */
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "new_value%d", i);
+        ASSERT(tcs->get_int(tcs, key, &value) == -1);
+        ASSERT(tcs->get_bool(tcs, key, &flag) == -1);
+        ASSERT(!tcs->get_string(tcs, key));
+    }
+    ASSERT(tcs->get_int(tcs, "new_value", &value) == 0);
+    ASSERT(tcs->get_int(tcs, "ping_timeout", &value) == 0);
+    ASSERT(tcs->get_bool(tcs, "boolean_true", &flag) == 0);
+    char *str = tcs->get_string(tcs, "hello_text");
+    ASSERT(str);
+    free(str);
+    tcs->dispose(tcs);
+}
+
+static void check_group_handles(void)
+{
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+
+    tcs_group_t *hal = tcs->open_group(tcs, ".hal");
+    tcs_group_t *elector = tcs->open_group(tcs, "crm1.firmware_elector");
+    ASSERT(hal && elector && (hal != elector));
+    ASSERT(tcs->open_group(tcs, "crm1.hal") == hal);
+    ASSERT(!tcs->open_group(tcs, ".unknown"));
+
+    /* handles do not change the selected group */
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    int value;
+    bool flag;
+    for (int i = 0; i < 2; i++) {
+        ASSERT(tcs->group_get_int(tcs, elector, "toto", &value) == 0);
+        ASSERT(value == 5);
+        ASSERT(tcs->group_get_int(tcs, hal, "ping_timeout", &value) == 0);
+        ASSERT(value == 5200);
+        ASSERT(tcs->group_get_int(tcs, hal, "toto", &value) == -1);
+    }
+    ASSERT(tcs->get_int(tcs, "ping_timeout", &value) == 0);
+    ASSERT(tcs->group_get_bool(tcs, hal, "boolean_true", &flag) == 0);
+    ASSERT(flag);
+    char *str = tcs->group_get_string(tcs, hal, "hello_text");
+    ASSERT(str && !strcmp(str, "hello world"));
+    free(str);
+
+    /* handles stay valid when groups are added */
+    tcs->add_group(tcs, "streamline1", false);
+    tcs_group_t *streamline = tcs->open_group(tcs, "streamline1");
+    ASSERT(streamline);
+    int nb = 0;
+    char **list = tcs->group_get_string_array(tcs, streamline, "tlvs", &nb);
+    ASSERT(list && (nb == 6));
+    ASSERT(!strcmp(list[0], "TLV1"));
+    for (int i = 0; i < nb; i++)
+        free(list[i]);
+    free(list);
+    ASSERT(tcs->group_get_int(tcs, hal, "ping_timeout", &value) == 0);
+    ASSERT(value == 5200);
+
+    tcs->dispose(tcs);
+}
+
+static void check_queries(void)
+{
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+
+    tcs_int_match_t *ints = NULL;
+    ASSERT(tcs->query_int(tcs, "crm1.*", "toto", &ints) == 2);
+    ASSERT(!strcmp(ints[0].group, "crm1.firmware_elector") && (ints[0].value == 5));
+    ASSERT(!strcmp(ints[1].group, "crm1.new_group") && (ints[1].value == 97264));
+    free(ints);
+    ASSERT(tcs->query_int(tcs, "crm?.hal", "ping_timeout", &ints) == 1);
+    ASSERT(!strcmp(ints[0].group, "crm1.hal") && (ints[0].value == 5200));
+    free(ints);
+    ASSERT(tcs->query_int(tcs, ".firmware_elector", "toto", &ints) == 1);
+    ASSERT(!strcmp(ints[0].group, "crm1.firmware_elector"));
+    free(ints);
+    ASSERT(tcs->query_int(tcs, "*", "test", &ints) == 1);
+    int value;
+    ASSERT(tcs->select_group(tcs, "common") == 0);
+    ASSERT(tcs->get_int(tcs, "test", &value) == 0);
+    ASSERT(!strcmp(ints[0].group, "common") && (ints[0].value == value));
+    free(ints);
+    /* conversion failure is skipped */
+    ASSERT(tcs->query_int(tcs, "crm*.hal", "bad_int", &ints) == 0);
+    ASSERT(!ints);
+
+    tcs_string_match_t *strings = NULL;
+    tcs->add_group(tcs, "streamline1", false);
+    ASSERT(tcs->query_string(tcs, "*.hal", "hello_text", &strings) == 1);
+    ASSERT(!strcmp(strings[0].group, "crm1.hal") && !strcmp(strings[0].value, "hello world"));
+    free(strings);
+    ASSERT(tcs->query_string(tcs, "unknown*.hal", "hello_text", &strings) == 0);
+    ASSERT(!strings);
+
+    tcs->dispose(tcs);
+}
+
+static void check_frozen_config(tcs_ctx_t *tcs)
+{
+    int value;
+    bool flag;
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT((tcs->get_int(tcs, "ping_timeout", &value) == 0) && (value == 5200));
+    ASSERT((tcs->get_bool(tcs, "boolean_true", &flag) == 0) && flag);
+    ASSERT(tcs->get_int(tcs, "bad_int", &value) == -1);
+    ASSERT(tcs->get_int(tcs, "missing", &value) == -1);
+    ASSERT(!strcmp(tcs->peek_string(tcs, tcs_hash("hello_text"), "hello_text"), "hello world"));
+    ASSERT(tcs->select_group(tcs, "crm1.new_group") == 0);
+    ASSERT((tcs->get_int(tcs, "toto", &value) == 0) && (value == 97264));
+    ASSERT(tcs->select_group(tcs, "unknown") == -1);
+
+    ASSERT(tcs->select_group(tcs, "streamline1") == 0);
+    int nb = 0;
+    char **array = tcs->get_string_array(tcs, "tlvs", &nb);
+    ASSERT(array && (nb == 6) && !strcmp(array[5], "TLV6"));
+    for (int i = 0; i < nb; i++)
+        free(array[i]);
+    free(array);
+
+    tcs_group_t *hal = tcs->open_group(tcs, ".hal");
+    ASSERT(hal && (hal == tcs->open_group(tcs, "crm1.hal")));
+    char *str = tcs->group_get_string(tcs, hal, "hello_text");
+    ASSERT(str && !strcmp(str, "hello world"));
+    free(str);
+
+    tcs_int_match_t *ints = NULL;
+    ASSERT(tcs->query_int(tcs, "crm?.hal", "ping_timeout", &ints) == 1);
+    ASSERT(!strcmp(ints[0].group, "crm1.hal") && (ints[0].value == 5200));
+    free(ints);
+    ASSERT(tcs->query_int(tcs, ".*", "toto", &ints) == 2);
+    free(ints);
+}
+
+static void check_freeze(void)
+{
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+
+    tcs->add_group(tcs, "streamline1", false);
+    unsigned int generation = tcs->get_generation(tcs, "crm1");
+    ASSERT(tcs->select_group(tcs, ".firmware_elector") == 0);
+    ASSERT(tcs->freeze(tcs) == 0);
+    ASSERT(tcs->freeze(tcs) == 0);
+
+    /* selection is kept */
+    int value;
+    ASSERT((tcs->get_int(tcs, "toto", &value) == 0) && (value == 5));
+    ASSERT(tcs->get_generation(tcs, "crm1") == generation);
+    ASSERT(tcs->get_generation(tcs, ".") == generation);
+    check_frozen_config(tcs);
+    tcs->print(tcs);
+
+    /* configuration can't change anymore */
+    tcs->add_group(tcs, "streamline2", false);
+    ASSERT(tcs->select_group(tcs, "streamline2") == -1);
+
+    pid_t pid = fork();
+    ASSERT(pid >= 0);
+    if (!pid) {
+        check_frozen_config(tcs);
+        _exit(0);
+    }
+    int status;
+    ASSERT(waitpid(pid, &status, 0) == pid);
+    ASSERT(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+    tcs->dispose(tcs);
+}
+
+static void *clone_thread(void *data)
+{
+    tcs_ctx_t *tcs = data;
+
+    for (int i = 0; i < 100; i++)
+        check_frozen_config(tcs);
+    return NULL;
+}
+
+static void check_clone(void)
+{
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    tcs->add_group(tcs, "streamline1", false);
+
+    /* only a frozen context can be cloned */
+    ASSERT(!tcs2_clone(tcs));
+    ASSERT(tcs->freeze(tcs) == 0);
+    tcs_ctx_t *clones[2];
+    for (int i = 0; i < 2; i++) {
+        clones[i] = tcs2_clone(tcs);
+        ASSERT(clones[i]);
+    }
+    tcs->add_group(tcs, "streamline2", false);
+
+    /* each clone has its own selected group, the one of the context at first */
+    int value;
+    ASSERT(clones[0]->select_group(clones[0], ".firmware_elector") == 0);
+    ASSERT((clones[0]->get_int(clones[0], "toto", &value) == 0) && (value == 5));
+    ASSERT((clones[1]->get_int(clones[1], "ping_timeout", &value) == -1));
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT((tcs->get_int(tcs, "ping_timeout", &value) == 0) && (value == 5200));
+    ASSERT((clones[0]->get_int(clones[0], "toto", &value) == 0) && (value == 5));
+
+    /* configuration is released by the last dispose */
+    tcs->dispose(tcs);
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++)
+        ASSERT(pthread_create(&threads[i], NULL, clone_thread, clones[i]) == 0);
+    for (int i = 0; i < 2; i++) {
+        ASSERT(pthread_join(threads[i], NULL) == 0);
+        clones[i]->dispose(clones[i]);
+    }
+}
+
+/**
+ * Allocation budgets of the API on the test fixtures. Getters are measured once the index of
+ * their group is built. Budgets of init and add_group leave room for libxml2 versions.
+ */
+static void check_alloc_budgets(void)
+{
+#ifdef ALLOC_COUNTERS
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    tcs->dispose(tcs);
+
+    long live = nb_live;
+    ALLOC_BUDGET(800, 256 * 1024, tcs = tcs2_init("crm1"));
+    ASSERT(tcs);
+    ALLOC_BUDGET(240, 96 * 1024, tcs->add_group(tcs, "streamline1", false));
+
+    int value;
+    bool flag;
+    int nb;
+    char *str;
+    char **array;
+    ASSERT(tcs->select_group(tcs, ".hal") == 0);
+    ASSERT(tcs->get_int(tcs, "ping_timeout", &value) == 0);
+    /* group name is kept for logs */
+    ALLOC_BUDGET(1, sizeof(".hal"), tcs->select_group(tcs, ".hal"));
+    ALLOC_BUDGET(0, 0, tcs->get_int(tcs, "ping_timeout", &value));
+    ALLOC_BUDGET(0, 0, tcs->get_int(tcs, "missing", &value));
+    ALLOC_BUDGET(0, 0, tcs->get_bool(tcs, "boolean_true", &flag));
+    ASSERT(tcs->get_generation(tcs, "streamline1"));
+    ALLOC_BUDGET(0, 0, tcs->get_generation(tcs, "crm1"));
+    ALLOC_BUDGET(0, 0, tcs->get_int_hashed(tcs, tcs_hash("ping_timeout"), "ping_timeout",
+                                                  &value));
+    ALLOC_BUDGET(0, 0, tcs->peek_string(tcs, tcs_hash("hello_text"), "hello_text"));
+    ALLOC_BUDGET(1, sizeof("hello world"), str = tcs->get_string(tcs, "hello_text"));
+    free(str);
+
+    ASSERT(tcs->select_group(tcs, "streamline1") == 0);
+    ASSERT(tcs->peek_string_array(tcs, tcs_hash("tlvs"), "tlvs", &nb));
+    /* 6 elements of 4 characters */
+    ALLOC_BUDGET(7, 6 * (sizeof(char *) + 5), array = tcs->get_string_array(tcs, "tlvs", &nb));
+    for (int i = 0; i < nb; i++)
+        free(array[i]);
+    free(array);
+    ALLOC_BUDGET(1, 6 * (sizeof(char *) + 5), array = tcs->get_string_array_packed(tcs, "tlvs", &nb));
+    free(array);
+    ALLOC_BUDGET(0, 0, tcs->peek_string_array(tcs, tcs_hash("tlvs"), "tlvs", &nb));
+
+    tcs_group_t *hal;
+    /* path is kept by the handle */
+    ALLOC_BUDGET(1, sizeof("crm1.hal"), hal = tcs->open_group(tcs, "crm1.hal"));
+    ALLOC_BUDGET(0, 0, hal = tcs->open_group(tcs, "crm1.hal"));
+    ALLOC_BUDGET(0, 0, tcs->group_get_int(tcs, hal, "ping_timeout", &value));
+
+    tcs_int_match_t *ints;
+    /* matches, path of the match and result block */
+    ALLOC_BUDGET(3, 256, tcs->query_int(tcs, "crm?.hal", "ping_timeout", &ints));
+    free(ints);
+
+    /* indexes of the groups not visited yet are built */
+    ALLOC_BUDGET(16, 4096, tcs->freeze(tcs));
+    ALLOC_BUDGET(0, 0, tcs->select_group(tcs, ".hal"));
+    ALLOC_BUDGET(0, 0, tcs->get_int(tcs, "ping_timeout", &value));
+    ALLOC_BUDGET(0, 0, tcs->get_int(tcs, "missing", &value));
+    tcs_ctx_t *clone;
+    ALLOC_BUDGET(1, 64 * 1024, clone = tcs2_clone(tcs));
+    ALLOC_BUDGET(0, 0, clone->dispose(clone));
+
+    ALLOC_BUDGET(0, 0, tcs->dispose(tcs));
+    /* everything allocated by the context is freed */
+    DASSERT(nb_live == live, "%ld blocks leaked\n", nb_live - live);
+#endif
+}
+
+#ifdef TCS_TEST_CODEGEN
+/* loaders generated by tcs2_codegen from test/schema */
+static void check_schema_load(void)
+{
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    ASSERT(tcs->select_group(tcs, ".") == 0);
+
+    crm_config_t config;
+    ASSERT(crm_config_load(tcs, ".", &config) == 0);
+    ASSERT(config.firmware_elector.toto == 5);
+    ASSERT(config.hal.ping_timeout == 5200);
+    ASSERT(!strcmp(config.hal.hello_text, "hello world"));
+    ASSERT(!strcmp(config.hal.missing_text, "default"));
+    ASSERT(config.hal.boolean_true);
+    ASSERT(config.hal.missing_int == -3);
+    crm_config_free(&config);
+    ASSERT(!config.hal.hello_text);
+
+    /* fields of the root group, and required key missing in a group named root */
+    crm_root_config_t root_config;
+    ASSERT(crm_root_config_load(tcs, "crm1.hal", &root_config) == -1);
+    ASSERT(root_config.ping_timeout == 5200);
+    ASSERT(!strcmp(root_config.text, "hello world"));
+    crm_root_config_free(&root_config);
+    ASSERT(!root_config.text);
+
+    /* frozen configuration */
+    ASSERT(tcs->freeze(tcs) == 0);
+    ASSERT(crm_config_load(tcs, ".", &config) == 0);
+    ASSERT(config.firmware_elector.toto == 5);
+    ASSERT(!strcmp(config.hal.hello_text, "hello world"));
+    crm_config_free(&config);
+
+    /* unknown root: required keys are missing */
+    ASSERT(crm_config_load(tcs, "unknown", &config) == -1);
+    ASSERT(config.hal.ping_timeout == 1000);
+    crm_config_free(&config);
+
+    tcs->dispose(tcs);
+
+    /* budget mode: loaded groups are not kept by the handles of the loader */
+    setenv("persist.tcs.group_budget", "1", 1);
+    tcs = tcs2_init(NULL);
+    unsetenv("persist.tcs.group_budget");
+    ASSERT(tcs);
+    tcs->add_group(tcs, "crm1", false);
+    ASSERT(crm_config_load(tcs, "crm1", &config) == 0);
+    crm_config_free(&config);
+    unsigned int generation = tcs->get_generation(tcs, "crm1");
+    tcs->add_group(tcs, "streamline1", false);
+    ASSERT(tcs->select_group(tcs, "streamline1") == 0);
+    tcs_group_t *streamline = tcs->open_group(tcs, "streamline1");
+    ASSERT(streamline);
+    tcs->close_group(tcs, streamline);
+    ASSERT(tcs->select_group(tcs, "crm1.hal") == 0);
+    ASSERT(tcs->get_generation(tcs, "crm1") > generation);
+    tcs->dispose(tcs);
+}
+#endif
+
+static void check_layered_overlays(void)
+{
+    setenv("persist.tcs.layered_overlays", "true", 1);
+
+    for (overlay_type_t type = OVERLAY_APPEND; type <= OVERLAY_OVERWRITE_EMPTY; type++) {
+        create_xml_files(type);
+        check_config("crm1", true, type);
+    }
+    check_config("crm1", false, OVERLAY_OVERWRITE_EMPTY);
+
+    /* new_group is only found in the overlay layer */
+    tcs_ctx_t *tcs = tcs2_init("crm1");
+    ASSERT(tcs);
+    tcs_int_match_t *ints = NULL;
+    ASSERT(tcs->query_int(tcs, "crm1.*", "toto", &ints) == 2);
+    ASSERT(!strcmp(ints[1].group, "crm1.new_group") && (ints[1].value == 97264));
+    free(ints);
+    tcs->dispose(tcs);
+
+    /* layers are resolved in the frozen configuration */
+    create_xml_files(OVERLAY_APPEND);
+    check_freeze();
+
+    unsetenv("persist.tcs.layered_overlays");
+}
+
 int main()
 {
     /* Configure TCS inputs */
@@ -319,6 +1184,25 @@ int main()
     create_xml_files(OVERLAY_APPEND);
     check_config("crm1", false, OVERLAY_APPEND);
     check_config("crm1", true, OVERLAY_APPEND);
+    check_async_init("crm1");
+    check_overlay_manifest();
+    check_flat_config();
+    check_bundle();
+    check_access_profile();
+    check_timing_report();
+    check_shared_modules();
+    check_remove_group(false);
+    check_remove_group(true);
+    check_hashed_getters();
+    check_missing_keys();
+#ifdef TCS_TEST_CODEGEN
+    check_schema_load();
+#endif
+    check_group_handles();
+    check_queries();
+    check_freeze();
+    check_clone();
+    check_alloc_budgets();
 
     create_xml_files(OVERLAY_APPEND_DEFAULT);
     check_config("crm1", true, OVERLAY_APPEND_DEFAULT);
@@ -329,6 +1213,11 @@ int main()
     create_xml_files(OVERLAY_OVERWRITE_EMPTY);
     check_config("crm1", true, OVERLAY_OVERWRITE_EMPTY);
 
+    check_layered_overlays();
+
+    check_xml_parser("builtin");
+    check_xml_parser("check");
+
     printf("\n\n*** SUCCESS ***\n");
     return 0;
 }
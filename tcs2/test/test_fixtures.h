@@ -0,0 +1,213 @@
+#ifndef __TCS_2_TEST_FIXTURES_H__
+#define __TCS_2_TEST_FIXTURES_H__
+
+/* Assertions and XML fixtures shared by the C and C++ tests */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define xstr(s) str(s)
+#define str(s) #s
+
+#ifdef __GNUC__
+#define likely(x)   __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#else
+#define likely(x)   (x)
+#define unlikely(x) (x)
+#endif
+
+#define DASSERT(exp, format, ...) do { \
+        if (unlikely(!(exp))) { \
+            if (unlikely(format[0] != '\0')) \
+                printf("AssertionLog " format, ## __VA_ARGS__); \
+            printf("%s:%d Assertion '" xstr(exp) "'", __FILE__, __LINE__); \
+            abort(); \
+        } \
+} while (0)
+
+#define ASSERT(exp) DASSERT(exp, "")
+
+/* *INDENT-OFF* */
+#define XML_CONFIG \
+"<config> \
+    <group name=\"common\"> \
+           <int key=\"test\">5</int> \
+    </group> \
+    <group name=\"modules\"> \
+        <string key=\"crm1\">crm_test.xml</string> \
+        <string key=\"streamline1\">streamline_test.xml</string> \
+    </group> \
+</config>"
+
+#define XML_SHARED_MODULES_CONFIG \
+"<config> \
+    <group name=\"common\"> \
+           <int key=\"test\">5</int> \
+    </group> \
+    <group name=\"modules\"> \
+        <string key=\"crm1\">crm_test.xml</string> \
+        <string key=\"crm2\">crm_test.xml</string> \
+        <string key=\"crm3\">crm_test.xml</string> \
+        <string key=\"streamline1\">streamline_test.xml</string> \
+    </group> \
+</config>"
+
+#define XML_CONFIG_OVERLAY \
+"<config> \
+    <group name=\"common\"> \
+           <int key=\"test\">0x20</int> \
+    </group> \
+</config>"
+
+
+#define XML_CRM \
+"<group name=\"crm1\"> \
+    <group name=\"firmware_elector\"> \
+        <int key=\"toto\">2</int> \
+    </group> \
+    <group name=\"hal\"> \
+        <int key=\"ping_timeout\">5200</int> \
+        <string key=\"hello_text\">hello world</string> \
+        <bool key=\"boolean_true\">false</bool> \
+        <bool key=\"boolean_false\">true</bool> \
+    </group> \
+</group>"
+
+#define XML_CRM1_OVERLAY \
+"<group name=\"crm1\"> \
+    <group name=\"firmware_elector\"> \
+        <int key=\"toto\">5</int> \
+    </group> \
+    <group name=\"hal\"> \
+        <int key=\"ping_timeout\">5200</int> \
+        <bool key=\"boolean_true\">true</bool> \
+        <bool key=\"boolean_false\">false</bool> \
+        <int key=\"new_value\">567</int> \
+        <int key=\"bad_int\">1abc</int> \
+        <bool key=\"bad_bool\">abc</bool> \
+    </group> \
+    <!-- add new group --> \
+    <group name=\"new_group\"> \
+        <int key=\"toto\">97264</int> \
+    </group> \
+</group>"
+
+#define XML_CRM2_OVERLAY \
+"<group name=\"crm2\"> \
+    <group name=\"firmware_elector\"> \
+        <int key=\"toto\">47145836</int> \
+    </group> \
+</group>"
+
+
+#define XML_STREAMLINE \
+"<group name=\"streamline1\"> \
+    <list name=\"tlvs\"> \
+        <string>TLV1</string> \
+        <string>TLV2</string> \
+        <string>TLV3</string> \
+    </list> \
+</group>"
+
+#define XML_STREAMLINE_OVERLAY_APPEND \
+"<group name=\"streamline1\"> \
+    <list name=\"tlvs\" overlay=\"append\"> \
+        <string>TLV4</string> \
+        <string>TLV5</string> \
+        <string>TLV6</string> \
+    </list> \
+</group>"
+
+#define XML_STREAMLINE_OVERLAY_APPEND_DEFAULT \
+"<group name=\"streamline1\"> \
+    <list name=\"tlvs\"> \
+        <string>TLV4</string> \
+        <string>TLV5</string> \
+        <string>TLV6</string> \
+    </list> \
+</group>"
+
+#define XML_STREAMLINE_OVERLAY_OVERWRITE \
+"<group name=\"streamline1\"> \
+    <list name=\"tlvs\" overlay=\"overwrite\"> \
+        <string>TLV_OVERWRITE_1</string> \
+        <string>TLV_OVERWRITE_2</string> \
+        <string>TLV_OVERWRITE_3</string> \
+    </list> \
+</group>"
+
+#define XML_STREAMLINE_OVERLAY_OVERWRITE_EMPTY \
+"<group name=\"streamline1\"> \
+    <list name=\"tlvs\" overlay=\"overwrite\"> \
+    </list> \
+</group>"
+
+
+#define XML_FLAT_CONFIG \
+"<config> \
+    <group name=\"common\"> \
+        <int key=\"test\">0x20</int> \
+    </group> \
+    <group name=\"modules\"> \
+        <string key=\"crm1\">crm_test.xml</string> \
+    </group> \
+</config>"
+
+#define XML_FLAT_CRM \
+"<group name=\"crm1\"> \
+    <group name=\"firmware_elector\"> \
+        <int key=\"toto\">42</int> \
+    </group> \
+</group>"
+
+#define XML_FLAT_SHARED_CONFIG \
+"<config> \
+    <group name=\"common\"> \
+        <int key=\"test\">0x20</int> \
+    </group> \
+    <group name=\"modules\"> \
+        <string key=\"crm1\">crm_test.xml</string> \
+        <string key=\"crm2\">crm_test.xml</string> \
+    </group> \
+</config>"
+
+#define XML_FLAT_CRM2 \
+"<group name=\"crm2\"> \
+    <group name=\"firmware_elector\"> \
+        <int key=\"toto\">43</int> \
+    </group> \
+</group>"
+
+#define XML_FLAT "<tcs_flat> " XML_FLAT_CONFIG " " XML_FLAT_CRM " </tcs_flat>"
+
+/* XML constructs handled by the built-in tokenizer */
+#define XML_CRM_SYNTAX \
+"\xEF\xBB\xBF<?xml version='1.0' encoding='UTF-8' standalone='yes'?>\r\n\
+<!-- prolog comment -->\r\n\
+<?tcs-generator version=\"2\"?>\r\n\
+<group\tname='crm1' >\r\n\
+    <group name=\"firmware_elector\">\r\n\
+        <int key='toto'>&#x32;&#52;</int>\r\n\
+    </group>\r\n\
+    <group name=\"hal\"\r\n\
+           >\r\n\
+        <int key=\"ping_timeout\">5200</int>\r\n\
+        <string key=\"hello_text\">caf\xC3\xA9 &lt;&amp;&gt; &quot;&apos;</string>\r\n\
+        <bool key=\"boolean_true\"><!-- inline -->true</bool>\r\n\
+    </group>\r\n\
+    <group name=\"empty\"/>\r\n\
+</group>\r\n\
+<!-- epilog comment -->\r\n"
+
+/* CDATA sections are declined by the built-in tokenizer and parsed by libxml2 */
+#define XML_CRM_CDATA \
+"<group name=\"crm1\"> \
+    <group name=\"firmware_elector\"> \
+        <int key=\"toto\"><![CDATA[7]]></int> \
+    </group> \
+</group>"
+
+/* *INDENT-ON* */
+
+#endif  /* __TCS_2_TEST_FIXTURES_H__ */
@@ -0,0 +1,132 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "libtcs2/tcs.hpp"
+
+#include "test_fixtures.h"
+
+using namespace tcs::literals;
+
+/* own folders: this test can run alongside tcs2_test */
+#define XML_ROOT_FOLDER "/tmp/tcs_hpp"
+#define XML_HW_FOLDER XML_ROOT_FOLDER "/hw"
+#define XML_OVERLAY_FOLDER XML_ROOT_FOLDER "/overlay"
+
+static void write_xml(const char *path, const char *data)
+{
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, data, strlen(data)) == static_cast<ssize_t>(strlen(data)));
+    close(fd);
+}
+
+static void create_xml_files(void)
+{
+    system("rm -fr " XML_ROOT_FOLDER);
+    system("mkdir -p " XML_HW_FOLDER "/config " XML_HW_FOLDER "/crm " XML_HW_FOLDER "/streamline "
+           XML_OVERLAY_FOLDER);
+
+    write_xml(XML_HW_FOLDER "/config/TCS2_test.xml", XML_CONFIG);
+    write_xml(XML_HW_FOLDER "/crm/crm_test.xml", XML_CRM);
+    write_xml(XML_HW_FOLDER "/streamline/streamline_test.xml", XML_STREAMLINE);
+}
+
+static void check_keys(void)
+{
+    constexpr tcs::key timeout = "ping_timeout"_key;
+    static_assert(timeout.hash() == tcs::hash("ping_timeout"), "key hashed at compile time");
+
+    ASSERT(timeout.hash() == tcs_hash("ping_timeout"));
+    ASSERT(!strcmp(timeout.name(), "ping_timeout"));
+}
+
+static void check_getters(void)
+{
+    tcs::context ctx("crm1");
+    ASSERT(ctx);
+
+    ASSERT(ctx.select_group(".hal"));
+    ASSERT(ctx.get<int>("ping_timeout"_key) == 5200);
+    ASSERT(ctx.get<std::string_view>("hello_text"_key) == std::string_view("hello world"));
+    ASSERT(ctx.get<bool>("boolean_true"_key) == false);
+    ASSERT(ctx.get<bool>("boolean_false"_key) == true);
+
+    /* missing keys and bad conversions */
+    ASSERT(!ctx.get<int>("missing"_key));
+    ASSERT(!ctx.get<int>("hello_text"_key));
+    ASSERT(!ctx.get<bool>("ping_timeout"_key));
+    ASSERT(ctx.get<int>("missing"_key).value_or(1000) == 1000);
+
+    ASSERT(ctx.select_group(".firmware_elector"));
+    ASSERT(ctx.get<int>("toto"_key) == 2);
+}
+
+static void check_string_list(void)
+{
+    tcs::context ctx("streamline1");
+    ASSERT(ctx);
+    ASSERT(ctx.select_group("."));
+
+    auto tlvs = ctx.get<tcs::string_list>("tlvs"_key);
+    ASSERT(tlvs && tlvs->size() == 3 && !tlvs->empty());
+
+    std::string joined;
+    for (std::string_view tlv : *tlvs)
+        joined.append(tlv).append(";");
+    ASSERT(joined == "TLV1;TLV2;TLV3;");
+
+    ASSERT((*tlvs)[1] == "TLV2");
+    ASSERT(tlvs->end() - tlvs->begin() == 3);
+    ASSERT(*(tlvs->begin() + 2) == "TLV3");
+    ASSERT(tlvs->begin()[0] == "TLV1");
+
+    ASSERT(!ctx.get<tcs::string_list>("missing"_key));
+}
+
+static void check_move(void)
+{
+    tcs::context ctx("crm1");
+    ASSERT(ctx && ctx.select_group(".hal"));
+    tcs_ctx_t *raw = ctx.get();
+
+    /* the selection and the values follow the C context */
+    tcs::context moved(std::move(ctx));
+    ASSERT(!ctx && !ctx.get());
+    ASSERT(moved.get() == raw);
+    ASSERT(moved.get<int>("ping_timeout"_key) == 5200);
+
+    tcs::context assigned("streamline1");
+    ASSERT(assigned);
+    assigned = std::move(moved);
+    ASSERT(!moved);
+    ASSERT(assigned.get() == raw);
+    ASSERT(assigned.get<std::string_view>("hello_text"_key) == std::string_view("hello world"));
+
+    /* taking ownership of a C context */
+    tcs::context owner(tcs2_init("crm1"));
+    ASSERT(owner && owner.select_group(".firmware_elector"));
+    ASSERT(owner.get<int>("toto"_key) == 2);
+}
+
+int main()
+{
+    setenv("tcs.dbg.host.hw_folder", XML_HW_FOLDER, 1);
+    setenv("tcs.dbg.host.overlay_folder", XML_OVERLAY_FOLDER, 1);
+    setenv("ro.telephony.tcs.sw_folder", XML_OVERLAY_FOLDER, 1);
+    setenv("ro.telephony.tcs.hw_name", "test", 1);
+
+    create_xml_files();
+    check_keys();
+    check_getters();
+    check_string_list();
+    check_move();
+
+    printf("\n\n*** SUCCESS (C++%ld) ***\n", __cplusplus / 100 % 100);
+    return 0;
+}
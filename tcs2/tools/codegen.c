@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host tool generating typed C structs and loaders from a module schema.
+ *
+ * Usage: tcs2_codegen <schema.xml> <out_folder>
+ *
+ * The schema mirrors the layout of the module group. Elements are annotated with:
+ *  - field:    name of the struct member. Key, sanitized, by default
+ *  - required: "true" if the load must fail when the key is not found
+ *  - default:  value used when the key is not found (int, bool and string only)
+ *
+ * Example:
+ *     <schema name="crm">
+ *         <group name="firmware_elector">
+ *             <int key="toto"/>
+ *         </group>
+ *         <group name="hal">
+ *             <int key="ping_timeout" default="1000"/>
+ *             <string key="hello_text" required="true"/>
+ *             <bool key="boolean_true"/>
+ *             <list name="tlvs"/>
+ *         </group>
+ *     </schema>
+ *
+ * generates <out_folder>/crm_config.h, with the crm_config_t struct, and
+ * <out_folder>/crm_config.c with:
+ *     int crm_config_load(tcs_ctx_t *ctx, const char *root, crm_config_t *config);
+ *     void crm_config_free(crm_config_t *config);
+ * The loader relies on tcs2_load(): group and key hashes and member offsets are computed at
+ * build time.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tcs_internal.h"
+
+#define TAG_SCHEMA ((const xmlChar *)"schema")
+#define ATTR_FIELD ((const xmlChar *)"field")
+#define ATTR_REQUIRED ((const xmlChar *)"required")
+#define ATTR_DEFAULT ((const xmlChar *)"default")
+
+typedef struct schema_group {
+    char *path;
+    char ident[32];                // Name of the fields array
+    char path_ident[32];           // Name of the path elements array
+    int nb_fields;
+    int nb_elements;
+} schema_group_t;
+
+static const char *g_schema_file;
+
+static void fail(xmlNodePtr node, const char *reason)
+{
+    fprintf(stderr, "%s:%ld: %s\n", g_schema_file, node ? xmlGetLineNo(node) : 0, reason);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Gets an attribute as a C identifier. Characters that are not valid in an identifier are
+ * replaced by '_'
+ */
+static char *get_ident(xmlNodePtr node, const xmlChar *attr)
+{
+    xmlChar *value = xmlGetProp(node, attr);
+
+    if (!value || (*value == '\0'))
+        fail(node, "missing name");
+
+    char *ident = malloc(xmlStrlen(value) + 2);
+    ASSERT(ident);
+    char *cur = ident;
+    if (isdigit(*value))
+        *cur++ = '_';
+    for (const xmlChar *c = value; *c; c++)
+        *cur++ = (isalnum(*c) || *c == '_') ? *c : '_';
+    *cur = '\0';
+    xmlFree(value);
+
+    return ident;
+}
+
+static char *get_member(xmlNodePtr node)
+{
+    xmlChar *field = xmlGetProp(node, ATTR_FIELD);
+
+    if (field) {
+        xmlFree(field);
+        return get_ident(node, ATTR_FIELD);
+    }
+    return get_ident(node, xmlStrcmp(node->name, TAG_LIST) ? ATTR_KEY : ATTR_NAME);
+}
+
+static bool is_field(xmlNodePtr node)
+{
+    return !xmlStrcmp(node->name, TAG_INT) || !xmlStrcmp(node->name, TAG_BOOL) ||
+           !xmlStrcmp(node->name, TAG_STRING) || !xmlStrcmp(node->name, TAG_LIST);
+}
+
+static void emit_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+    for (; *str; str++) {
+        if ((*str == '"') || (*str == '\\'))
+            fprintf(out, "\\%c", *str);
+        else if (isprint((unsigned char)*str))
+            fputc(*str, out);
+        else
+            fprintf(out, "\\%03o", (unsigned char)*str);
+    }
+    fputc('"', out);
+}
+
+static void emit_struct(FILE *out, xmlNodePtr group, int level)
+{
+    for (xmlNodePtr node = next_node(group->children); node; node = next_node(node)) {
+        if (!xmlStrcmp(node->name, TAG_GROUP)) {
+            if (!next_node(node->children))
+                fail(node, "empty group");
+            char *member = get_ident(node, ATTR_NAME);
+            fprintf(out, "%*sstruct {\n", level, "");
+            emit_struct(out, node, level + 4);
+            fprintf(out, "%*s} %s;\n", level, "", member);
+            free(member);
+        } else if (is_field(node)) {
+            char *member = get_member(node);
+            if (!xmlStrcmp(node->name, TAG_INT))
+                fprintf(out, "%*sint %s;\n", level, "", member);
+            else if (!xmlStrcmp(node->name, TAG_BOOL))
+                fprintf(out, "%*sbool %s;\n", level, "", member);
+            else if (!xmlStrcmp(node->name, TAG_STRING))
+                fprintf(out, "%*schar *%s;\n", level, "", member);
+            else
+                fprintf(out, "%*schar **%s;\n%*sint %s_nb;\n", level, "", member, level, "",
+                        member);
+            free(member);
+        } else {
+            fail(node, "unknown element");
+        }
+    }
+}
+
+static void emit_field(FILE *out, const char *name, const char *member_path, xmlNodePtr node)
+{
+    xmlChar *key = xmlGetProp(node, xmlStrcmp(node->name, TAG_LIST) ? ATTR_KEY : ATTR_NAME);
+    xmlChar *required = xmlGetProp(node, ATTR_REQUIRED);
+    xmlChar *def = xmlGetProp(node, ATTR_DEFAULT);
+    char *member = get_member(node);
+    const char *type;
+    int default_int = 0;
+
+    if (!key)
+        fail(node, "missing key");
+    if (required && xmlStrcmp(required, (const xmlChar *)"true") &&
+        xmlStrcmp(required, (const xmlChar *)"false"))
+        fail(node, "required must be true or false");
+
+    if (!xmlStrcmp(node->name, TAG_INT)) {
+        type = "TCS_FIELD_INT";
+        if (def) {
+            char *end = NULL;
+            errno = 0;
+            default_int = strtol((const char *)def, &end, 0);
+            if (errno || (end == (char *)def) || (*end != '\0'))
+                fail(node, "invalid int default value");
+        }
+    } else if (!xmlStrcmp(node->name, TAG_BOOL)) {
+        type = "TCS_FIELD_BOOL";
+        if (def && xmlStrcmp(def, (const xmlChar *)"true") &&
+            xmlStrcmp(def, (const xmlChar *)"false"))
+            fail(node, "invalid bool default value");
+        default_int = def && !xmlStrcmp(def, (const xmlChar *)"true");
+    } else if (!xmlStrcmp(node->name, TAG_STRING)) {
+        type = "TCS_FIELD_STRING";
+    } else {
+        type = "TCS_FIELD_STRING_ARRAY";
+        if (def)
+            fail(node, "lists have no default value");
+    }
+
+    fprintf(out, "    { ");
+    emit_string(out, (const char *)key);
+    fprintf(out, ", 0x%08xu, %s, offsetof(%s_config_t, %s%s), ", tcs_hash((const char *)key),
+            type, name, member_path, member);
+    if (!xmlStrcmp(node->name, TAG_LIST))
+        fprintf(out, "offsetof(%s_config_t, %s%s_nb), ", name, member_path, member);
+    else
+        fprintf(out, "0, ");
+    fprintf(out, "%s, %s, %d, ", required && !xmlStrcmp(required, (const xmlChar *)"true") ?
+            "true" : "false", def ? "true" : "false", default_int);
+    if (def && !xmlStrcmp(node->name, TAG_STRING))
+        emit_string(out, (const char *)def);
+    else
+        fprintf(out, "NULL");
+    fprintf(out, " },\n");
+
+    free(member);
+    xmlFree(def);
+    xmlFree(required);
+    xmlFree(key);
+}
+
+/**
+ * Emits the elements of a group path with their hashes
+ *
+ * @return number of elements
+ */
+static int emit_path(FILE *out, const char *ident, const char *path)
+{
+    int nb = 0;
+
+    if (!*path)
+        return 0;
+
+    fprintf(out, "static const tcs_path_element_t %s[] = {\n", ident);
+    for (const char *cur = path; cur; nb++) {
+        const char *tmp = strchr(cur, '.');
+        size_t len = tmp ? (size_t)(tmp - cur) : strlen(cur);
+        char element[256];
+        snprintf(element, sizeof(element), "%.*s", (int)len, cur);
+        fprintf(out, "    { ");
+        emit_string(out, element);
+        fprintf(out, ", 0x%08xu },\n", tcs_hash(element));
+        cur = tmp ? tmp + 1 : NULL;
+    }
+    fprintf(out, "};\n\n");
+
+    return nb;
+}
+
+/**
+ * Emits the fields of a group and of its sub-groups. Groups with fields are appended to the
+ * groups array
+ *
+ * @return number of groups
+ */
+static int emit_fields(FILE *out, const char *name, xmlNodePtr group, const char *path,
+                       const char *member_path, schema_group_t **groups, int nb_groups)
+{
+    int nb_fields = 0;
+
+    for (xmlNodePtr node = next_node(group->children); node; node = next_node(node))
+        nb_fields += is_field(node);
+
+    if (nb_fields) {
+        *groups = realloc(*groups, (nb_groups + 1) * sizeof(schema_group_t));
+        ASSERT(*groups);
+        schema_group_t *cur = &(*groups)[nb_groups++];
+        cur->path = strdup(path);
+        ASSERT(cur->path);
+        cur->nb_fields = nb_fields;
+        /* numbered: sanitized group names can collide ("a.b" and "a_b", or "root") */
+        snprintf(cur->ident, sizeof(cur->ident), "g_group%d_fields", nb_groups - 1);
+        snprintf(cur->path_ident, sizeof(cur->path_ident), "g_group%d_path", nb_groups - 1);
+
+        /* sanitized member path, without trailing '.': safe in a comment */
+        if (*member_path)
+            fprintf(out, "/* %.*s */\n", (int)strlen(member_path) - 1, member_path);
+        else
+            fprintf(out, "/* root group */\n");
+        cur->nb_elements = emit_path(out, cur->path_ident, path);
+        fprintf(out, "static const tcs_field_t %s[] = {\n", cur->ident);
+        for (xmlNodePtr node = next_node(group->children); node; node = next_node(node))
+            if (is_field(node))
+                emit_field(out, name, member_path, node);
+        fprintf(out, "};\n\n");
+    }
+
+    for (xmlNodePtr node = next_node(group->children); node; node = next_node(node)) {
+        if (xmlStrcmp(node->name, TAG_GROUP))
+            continue;
+        xmlChar *group_name = xmlGetProp(node, ATTR_NAME);
+        char *member = get_ident(node, ATTR_NAME);
+        char sub_path[256];
+        char sub_member_path[256];
+        snprintf(sub_path, sizeof(sub_path), "%s%s%s", path, *path ? "." : "", group_name);
+        snprintf(sub_member_path, sizeof(sub_member_path), "%s%s.", member_path, member);
+        nb_groups = emit_fields(out, name, node, sub_path, sub_member_path, groups, nb_groups);
+        free(member);
+        xmlFree(group_name);
+    }
+
+    return nb_groups;
+}
+
+static FILE *open_output(const char *out_folder, const char *name, const char *ext)
+{
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/%s_config.%s", out_folder, name, ext);
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "failed to create file (%s)\n", path);
+        exit(EXIT_FAILURE);
+    }
+    const char *schema_name = strrchr(g_schema_file, '/');
+    fprintf(out, "/* Generated by tcs2_codegen from %s. Do not edit */\n\n",
+            schema_name ? schema_name + 1 : g_schema_file);
+
+    return out;
+}
+
+static void generate_header(const char *out_folder, const char *name, xmlNodePtr schema)
+{
+    FILE *out = open_output(out_folder, name, "h");
+    char guard[256];
+
+    snprintf(guard, sizeof(guard), "__%s_CONFIG_H__", name);
+    for (char *c = guard; *c; c++)
+        *c = toupper(*c);
+
+    fprintf(out, "#ifndef %s\n#define %s\n\n", guard, guard);
+    fprintf(out, "#include <stdbool.h>\n\n#include \"libtcs2/tcs.h\"\n\n");
+    fprintf(out, "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n");
+    fprintf(out, "typedef struct %s_config {\n", name);
+    emit_struct(out, schema, 4);
+    fprintf(out, "} %s_config_t;\n\n", name);
+    fprintf(out,
+            "/**\n"
+            " * Loads the %s configuration. The selected group of the context is changed\n"
+            " *\n"
+            " * @param [in]  ctx    Module context\n"
+            " * @param [in]  root   Path of the %s group, e.g. \"%s0\" or \".\"\n"
+            " * @param [out] config Loaded configuration. Must be freed by %s_config_free\n"
+            " *\n"
+            " * @return 0 if successful\n"
+            " * @return -1 if a required key is not found\n"
+            " */\n"
+            "int %s_config_load(tcs_ctx_t *ctx, const char *root, %s_config_t *config);\n\n",
+            name, name, name, name, name, name);
+    fprintf(out, "void %s_config_free(%s_config_t *config);\n\n", name, name);
+    fprintf(out, "#ifdef __cplusplus\n}\n#endif\n#endif  /* %s */\n", guard);
+    fclose(out);
+}
+
+static void generate_source(const char *out_folder, const char *name, xmlNodePtr schema)
+{
+    FILE *out = open_output(out_folder, name, "c");
+    schema_group_t *groups = NULL;
+
+    fprintf(out, "#include <stddef.h>\n#include <string.h>\n\n#include \"%s_config.h\"\n\n",
+            name);
+    int nb_groups = emit_fields(out, name, schema, "", "", &groups, 0);
+
+    fprintf(out, "static const tcs_schema_group_t g_groups[] = {\n");
+    for (int i = 0; i < nb_groups; i++) {
+        fprintf(out, "    { ");
+        emit_string(out, groups[i].path);
+        if (groups[i].nb_elements)
+            fprintf(out, ", %s, %d", groups[i].path_ident, groups[i].nb_elements);
+        else
+            fprintf(out, ", NULL, 0");
+        fprintf(out, ", %s, %d },\n", groups[i].ident, groups[i].nb_fields);
+        free(groups[i].path);
+    }
+    free(groups);
+    fprintf(out, "};\n\n");
+    fprintf(out, "static const tcs_schema_t g_schema = { g_groups, %d };\n\n", nb_groups);
+
+    fprintf(out,
+            "int %s_config_load(tcs_ctx_t *ctx, const char *root, %s_config_t *config)\n"
+            "{\n"
+            "    memset(config, 0, sizeof(*config));\n"
+            "    return tcs2_load(ctx, root, &g_schema, config);\n"
+            "}\n\n"
+            "void %s_config_free(%s_config_t *config)\n"
+            "{\n"
+            "    tcs2_unload(&g_schema, config);\n"
+            "}\n", name, name, name, name);
+    fclose(out);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <schema.xml> <out_folder>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    g_schema_file = argv[1];
+
+    xmlDocPtr doc = xmlReadFile(g_schema_file, NULL, XML_PARSE_NOENT);
+    if (!doc)
+        fail(NULL, "schema not parsed correctly");
+
+    xmlNodePtr schema = xmlDocGetRootElement(doc);
+    if (xmlStrcmp(schema->name, TAG_SCHEMA))
+        fail(schema, "root element must be <schema>");
+    if (!next_node(schema->children))
+        fail(schema, "empty schema");
+
+    char *name = get_ident(schema, ATTR_NAME);
+    generate_header(argv[2], name, schema);
+    generate_source(argv[2], name, schema);
+    printf("generated: %s/%s_config.[ch]\n", argv[2], name);
+
+    free(name);
+    xmlFreeDoc(doc);
+    xmlCleanupParser();
+
+    return EXIT_SUCCESS;
+}
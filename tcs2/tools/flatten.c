@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host tool flattening TCS configurations at build time.
+ *
+ * Usage: tcs2_flatten [-j <jobs>] [-b | -z] <hw_folder> <out_folder> [<catalog_folder>]
+ *
+ * For each platform (config/TCS2_<hw>.xml file of <hw_folder>) and each sw folder (sub-folder of
+ * <catalog_folder>), the configuration and all module groups are merged with their overlays by
+ * libtcs2 itself. The result is written to <out_folder>/<sw_folder>/TCS2_<hw>.xml. If no catalog
+ * is provided, the "default" sw folder is generated without overlay.
+ *
+ * With -b, a bundle (TCS2_<hw>.bundle) is written instead of the XML file: one entry per group,
+ * parsed only when the group is added. With -z, entries of the bundle are compressed.
+ *
+ * <out_folder> must be installed as the "flat" folder of the hw folder on target: the tcs2_flat_xml
+ * module does it when the build runs with tcs_flat=true (@see build.txt). Each combination is
+ * processed by a child process: an overlay error aborts the child and makes the tool fail.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tcs_internal.h"
+
+#define CONFIG_PREFIX "TCS2_"
+#define CONFIG_SUFFIX ".xml"
+
+typedef struct job {
+    char hw_name[128];
+    char sw_folder[128];
+} job_t;
+
+typedef enum format {
+    FORMAT_XML,
+    FORMAT_BUNDLE,
+    FORMAT_COMPRESSED_BUNDLE,
+} format_t;
+
+static format_t g_format = FORMAT_XML;
+
+static int flatten(const char *hw_folder, const char *out_folder, const char *catalog,
+                   const job_t *job)
+{
+    char path[512];
+
+    setenv("tcs.dbg.host.hw_folder", hw_folder, 1);
+    setenv("ro.telephony.tcs.hw_name", job->hw_name, 1);
+    setenv("persist.tcs.disable_flat", "true", 1);
+    if (catalog) {
+        snprintf(path, sizeof(path), "%s/%s", catalog, job->sw_folder);
+        setenv("tcs.dbg.host.overlay_folder", path, 1);
+    } else {
+        unsetenv("tcs.dbg.host.overlay_folder");
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", out_folder, job->sw_folder);
+    if (mkdir(path, 0755) && (errno != EEXIST)) {
+        fprintf(stderr, "failed to create folder (%s)\n", path);
+        return -1;
+    }
+
+    tcs_ctx_t *tcs = tcs2_init(NULL);
+    if (!tcs) {
+        fprintf(stderr, "platform (%s) not initialized\n", job->hw_name);
+        return -1;
+    }
+
+    int ret;
+    if (g_format == FORMAT_XML) {
+        snprintf(path, sizeof(path), "%s/%s/" CONFIG_PREFIX "%s" CONFIG_SUFFIX, out_folder,
+                 job->sw_folder, job->hw_name);
+        ret = tcs_flat_write(tcs, path);
+    } else {
+        snprintf(path, sizeof(path), "%s/%s/" CONFIG_PREFIX "%s" TCS_BUNDLE_SUFFIX, out_folder,
+                 job->sw_folder, job->hw_name);
+        ret = tcs_flat_write_bundle(tcs, path, g_format == FORMAT_COMPRESSED_BUNDLE);
+    }
+    tcs->dispose(tcs);
+
+    return ret;
+}
+
+static int list_platforms(const char *hw_folder, char ***names)
+{
+    char path[256];
+    struct dirent **list = NULL;
+    int nb_names = 0;
+
+    snprintf(path, sizeof(path), "%s/config", hw_folder);
+    int nb = scandir(path, &list, NULL, alphasort);
+    if (nb > 0) {
+        *names = calloc(nb, sizeof(char *));
+        if (!*names)
+            abort();
+    }
+
+    for (int i = 0; i < nb; i++) {
+        const char *name = list[i]->d_name;
+        size_t len = strlen(name);
+        size_t fix = strlen(CONFIG_PREFIX) + strlen(CONFIG_SUFFIX);
+        if ((len > fix) && !strncmp(name, CONFIG_PREFIX, strlen(CONFIG_PREFIX)) &&
+            !strcmp(name + len - strlen(CONFIG_SUFFIX), CONFIG_SUFFIX))
+            (*names)[nb_names++] = strndup(name + strlen(CONFIG_PREFIX), len - fix);
+        free(list[i]);
+    }
+    free(list);
+
+    return nb_names;
+}
+
+static int list_sw_folders(const char *catalog, char ***names)
+{
+    struct dirent **list = NULL;
+    int nb_names = 0;
+
+    if (!catalog) {
+        *names = calloc(1, sizeof(char *));
+        if (!*names)
+            abort();
+        (*names)[nb_names++] = strdup(TCS_FLAT_DEFAULT_SW_FOLDER);
+        return nb_names;
+    }
+
+    int nb = scandir(catalog, &list, NULL, alphasort);
+    if (nb > 0) {
+        *names = calloc(nb, sizeof(char *));
+        if (!*names)
+            abort();
+    }
+
+    for (int i = 0; i < nb; i++) {
+        char path[512];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", catalog, list[i]->d_name);
+        if ((*list[i]->d_name != '.') && !stat(path, &st) && S_ISDIR(st.st_mode))
+            (*names)[nb_names++] = strdup(list[i]->d_name);
+        free(list[i]);
+    }
+    free(list);
+
+    return nb_names;
+}
+
+static int wait_job(const job_t *jobs, const pid_t *pids, int nb_jobs)
+{
+    int status;
+    pid_t pid = wait(&status);
+
+    if (pid < 0)
+        return -1;
+
+    for (int i = 0; i < nb_jobs; i++) {
+        if (pids[i] == pid) {
+            bool ok = WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS);
+            fprintf(ok ? stdout : stderr, "%s: %s/%s\n", ok ? "flattened" : "FAILED",
+                    jobs[i].sw_folder, jobs[i].hw_name);
+            return ok ? 0 : -1;
+        }
+    }
+
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    long max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:bz")) != -1) {
+        if (opt == 'j') {
+            max_jobs = strtol(optarg, NULL, 10);
+        } else if (opt == 'b') {
+            g_format = FORMAT_BUNDLE;
+        } else if (opt == 'z') {
+            g_format = FORMAT_COMPRESSED_BUNDLE;
+        } else {
+            max_jobs = 0;
+            break;
+        }
+    }
+
+    if ((max_jobs <= 0) || (argc - optind < 2) || (argc - optind > 3)) {
+        fprintf(stderr, "usage: %s [-j <jobs>] [-b | -z] <hw_folder> <out_folder> "
+                "[<catalog_folder>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *hw_folder = argv[optind];
+    const char *out_folder = argv[optind + 1];
+    const char *catalog = argc - optind == 3 ? argv[optind + 2] : NULL;
+
+    char **platforms = NULL;
+    char **sw_folders = NULL;
+    int nb_platforms = list_platforms(hw_folder, &platforms);
+    int nb_sw_folders = list_sw_folders(catalog, &sw_folders);
+    if ((nb_platforms <= 0) || (nb_sw_folders <= 0)) {
+        fprintf(stderr, "no platform or sw folder found\n");
+        return EXIT_FAILURE;
+    }
+
+    if (mkdir(out_folder, 0755) && (errno != EEXIST)) {
+        fprintf(stderr, "failed to create folder (%s)\n", out_folder);
+        return EXIT_FAILURE;
+    }
+
+    int nb_jobs = nb_platforms * nb_sw_folders;
+    job_t *jobs = calloc(nb_jobs, sizeof(job_t));
+    pid_t *pids = calloc(nb_jobs, sizeof(pid_t));
+    if (!jobs || !pids)
+        abort();
+
+    /* flush before forking: buffered data would be duplicated in children */
+    fflush(stdout);
+
+    int ret = 0;
+    int running = 0;
+    for (int i = 0; i < nb_jobs; i++) {
+        snprintf(jobs[i].hw_name, sizeof(jobs[i].hw_name), "%s", platforms[i / nb_sw_folders]);
+        snprintf(jobs[i].sw_folder, sizeof(jobs[i].sw_folder), "%s",
+                 sw_folders[i % nb_sw_folders]);
+
+        if (running >= max_jobs) {
+            ret |= wait_job(jobs, pids, i);
+            running--;
+        }
+
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            int err = flatten(hw_folder, out_folder, catalog, &jobs[i]);
+            /* _exit skips the destructors: asynchronous logs are written here */
+            tcs_log_flush();
+            fflush(stdout);
+            _exit(err ? EXIT_FAILURE : EXIT_SUCCESS);
+        } else if (pids[i] < 0) {
+            fprintf(stderr, "fork failure\n");
+            ret = -1;
+            break;
+        }
+        running++;
+    }
+
+    for (; running > 0; running--)
+        ret |= wait_job(jobs, pids, nb_jobs);
+
+    for (int i = 0; i < nb_platforms; i++)
+        free(platforms[i]);
+    for (int i = 0; i < nb_sw_folders; i++)
+        free(sw_folders[i]);
+    free(platforms);
+    free(sw_folders);
+    free(jobs);
+    free(pids);
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) Intel 2016
+ *
+ * TCS has been designed by:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *  - Lionel Ulmer <lionel.ulmer@intel.com>
+ *  - Marc Bellanger <marc.bellanger@intel.com>
+ *
+ * Original TCS contributor is:
+ *  - Cesar De Oliveira <cesar.de.oliveira@intel.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host tool generating overlay manifests.
+ *
+ * Usage: tcs2_manifest <folder> [<folder> ...]
+ *
+ * Folders are walked recursively. A manifest is (re)written in every folder containing files.
+ * Must be run once all overlay files are installed: adding, removing or modifying a file afterwards
+ * makes the manifest of its folder stale. Timestamps are not used: they can be normalized later.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "tcs_internal.h"
+
+static int generate(const char *folder)
+{
+    struct dirent **list = NULL;
+    int nb = scandir(folder, &list, NULL, alphasort);
+
+    if (nb < 0) {
+        fprintf(stderr, "failed to scan folder (%s)\n", folder);
+        return -1;
+    }
+
+    int ret = 0;
+    bool has_files = false;
+    for (int i = 0; i < nb; i++) {
+        char path[256];
+        struct stat st;
+
+        snprintf(path, sizeof(path), "%s/%s", folder, list[i]->d_name);
+        if ((*list[i]->d_name != '.') && !stat(path, &st)) {
+            if (S_ISDIR(st.st_mode))
+                ret |= generate(path);
+            else if (S_ISREG(st.st_mode))
+                has_files = true;
+        }
+        free(list[i]);
+    }
+    free(list);
+
+    if (has_files) {
+        printf("manifest: %s\n", folder);
+        ret |= tcs_manifest_write(folder);
+    }
+
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <folder> [<folder> ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; i++)
+        ret |= generate(argv[i]);
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}